@@ -0,0 +1,92 @@
+//Copyright 2017 Jakob Wyatt
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http ://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+//compares asynchronous training with ordered and dataparallel training on mnist, in convergence and throughput
+//every mode trains the same neuralnet from the same starting weights on sparse inputs, as asynchronous training is meant for,
+//and reports the cost and accuracy on the test set after each epoch, along with the samples trained per second
+//usage: asynchronousbench [epochs] [threads] [batchsize] [learningrate]
+//threads defaults to MATH_THREADS, or one per hardware thread
+
+#include <cstddef>
+#include <cstdlib>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+
+#include "../src/math.h"
+#include "../src/nn.h"
+#include "../src/random.h"
+#include "../src/threads.h"
+#include "mnist.h"
+
+namespace {
+
+const char* modename(nn::parallelism mode) {
+	switch (mode) {
+	case nn::dataparallel:
+		return "dataparallel";
+	case nn::asynchronous:
+		return "asynchronous";
+	default:
+		return "ordered";
+	}
+}
+
+}
+
+int main(int argc, char** argv) {
+	std::size_t epochs = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 3;
+	if (argc > 2) {
+		math::setthreads(std::strtoul(argv[2], nullptr, 10));
+	}
+	nn::data::size_type batchsize = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 10;
+	math::num learningrate = argc > 4 ? std::strtod(argv[4], nullptr) : 0.1;
+
+	if (!bench::checkmnist()) {
+		return 1;
+	}
+	nn::data train = nn::data(nn::data::mnisttrain).sparse();
+	nn::data test(nn::data::mnisttest);
+
+	std::cout << "threads " << math::threads() << ", batchsize " << batchsize << ", learning rate " << learningrate
+		<< ", " << train.size() << " training samples" << std::endl;
+	std::cout << std::left << std::setw(14) << "mode" << std::setw(7) << "epoch" << std::setw(12) << "cost"
+		<< std::setw(10) << "correct" << "samples/s" << std::endl;
+
+	for (nn::parallelism mode : { nn::ordered, nn::dataparallel, nn::asynchronous }) {
+		//the same seed gives every mode the same starting weights and the same shuffles
+		math::seed(2017);
+		nn::weights w1(784, 100);
+		nn::biases b1(100, 1);
+		nn::sigmoid s1(100, 1);
+		nn::weights w2(100, 10);
+		nn::biases b2(10, 1);
+		nn::sigmoid s2(10, 1);
+		nn::nn network({ &w1, &b1, &s1, &w2, &b2, &s2 });
+
+		for (std::size_t epoch = 1; epoch <= epochs; ++epoch) {
+			nn::data shuffled = train.shuffle();
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			network.train(shuffled, learningrate, batchsize, mode);
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			math::num cost = network.cost(test, math::matrix::quadraticcost);
+			nn::data::size_type correct = network.test(test, [](math::constmatrixview correct, math::constmatrixview output, math::matrixview buffer) {
+				return math::matrix::comparemax(correct, output, buffer);
+			});
+			std::cout << std::left << std::setw(14) << modename(mode) << std::setw(7) << epoch << std::setw(12) << std::fixed << std::setprecision(6) << cost
+				<< std::setw(10) << correct << std::setprecision(0) << shuffled.size() / seconds << std::endl;
+		}
+	}
+}
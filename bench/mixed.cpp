@@ -0,0 +1,96 @@
+//Copyright 2017 Jakob Wyatt
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http ://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+//compares mixed precision training with pure double precision training on mnist, in convergence and throughput
+//both train the same double precision neuralnet from the same starting weights, and are evaluated the same way,
+//so the only difference is whether the feedforward and backprop run in single precision
+//reports the cost and accuracy on the test set after each epoch, along with the samples trained per second
+//usage: mixedbench [epochs] [threads] [batchsize] [learningrate]
+//threads defaults to MATH_THREADS, or one per hardware thread
+
+#include <cstddef>
+#include <cstdlib>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+
+#include "../src/math.h"
+#include "../src/nn.h"
+#include "../src/mixed.h"
+#include "../src/random.h"
+#include "../src/threads.h"
+#include "mnist.h"
+
+int main(int argc, char** argv) {
+	std::size_t epochs = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 3;
+	if (argc > 2) {
+		math::setthreads(std::strtoul(argv[2], nullptr, 10));
+	}
+	nn::data::size_type batchsize = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 10;
+	double learningrate = argc > 4 ? std::strtod(argv[4], nullptr) : 0.1;
+
+	if (!bench::checkmnist()) {
+		return 1;
+	}
+	nn::basic_data<double> train(nn::basic_data<double>::mnisttrain);
+	nn::basic_data<float> singletrain(nn::basic_data<float>::mnisttrain);
+	nn::basic_data<double> test(nn::basic_data<double>::mnisttest);
+
+	std::cout << "threads " << math::threads() << ", batchsize " << batchsize << ", learning rate " << learningrate
+		<< ", " << train.size() << " training samples" << std::endl;
+	std::cout << std::left << std::setw(11) << "precision" << std::setw(7) << "epoch" << std::setw(12) << "cost"
+		<< std::setw(10) << "correct" << "samples/s" << std::endl;
+
+	double total[2] = {};
+	for (int mixed = 0; mixed != 2; ++mixed) {
+		//the same seed gives both the same starting weights and the same shuffles, as the trainer draws no random numbers
+		math::seed(2017);
+		nn::basic_weights<double> w1(784, 100);
+		nn::basic_biases<double> b1(100, 1);
+		nn::basic_sigmoid<double> s1(100, 1);
+		nn::basic_weights<double> w2(100, 10);
+		nn::basic_biases<double> b2(10, 1);
+		nn::basic_sigmoid<double> s2(10, 1);
+		nn::basic_nn<double> network({ &w1, &b1, &s1, &w2, &b2, &s2 });
+		//the trainer is only made for the mixed run, as the neuralnet must not be trained elsewhere while it is in use
+		std::unique_ptr<nn::basic_mixedtrainer<double>> trainer(mixed ? new nn::basic_mixedtrainer<double>(network) : nullptr);
+
+		for (std::size_t epoch = 1; epoch <= epochs; ++epoch) {
+			std::chrono::steady_clock::time_point start;
+			if (mixed) {
+				nn::basic_data<float> shuffled = singletrain.shuffle();
+				start = std::chrono::steady_clock::now();
+				trainer->train(shuffled, learningrate, batchsize);
+			} else {
+				nn::basic_data<double> shuffled = train.shuffle();
+				start = std::chrono::steady_clock::now();
+				network.train(shuffled, learningrate, batchsize);
+			}
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			total[mixed] += seconds;
+
+			double cost = network.cost(test, math::basic_matrix<double>::quadraticcost);
+			nn::basic_data<double>::size_type correct = network.test(test, [](math::basic_matrixview<const double> correct, math::basic_matrixview<const double> output, math::basic_matrixview<double> buffer) {
+				return math::basic_matrix<double>::comparemax(correct, output, buffer);
+			});
+			std::cout << std::left << std::setw(11) << (mixed ? "mixed" : "double") << std::setw(7) << epoch << std::setw(12) << std::fixed << std::setprecision(6) << cost
+				<< std::setw(10) << correct << std::setprecision(0) << train.size() / seconds << std::endl;
+		}
+		if (mixed) {
+			std::cout << "mixed: final loss scale " << std::setprecision(0) << trainer->lossscale() << ", " << trainer->skipped() << " updates skipped" << std::endl;
+		}
+	}
+	std::cout << "mixed precision speedup over double: " << std::setprecision(2) << total[0] / total[1] << "x" << std::endl;
+}
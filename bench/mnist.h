@@ -0,0 +1,60 @@
+//Copyright 2017 Jakob Wyatt
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http ://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#ifndef GUARD_BENCH_MNIST_H
+#define GUARD_BENCH_MNIST_H
+
+#include <cstddef>
+#include <string>
+#include <fstream>
+#include <iostream>
+
+//the benchmarks train on mnist, which nn::data loads from ./../data/mnist/
+//the repository only ships the label files, so the images must be downloaded before a benchmark can run
+//a benchmark refuses to run without them, as its numbers are only meaningful on the real dataset
+namespace bench {
+
+//the directory nn::data loads mnist from, relative to the working directory
+const std::string mnistdirectory = "./../data/mnist/";
+
+//an mnist file, and the size it has when decompressed
+struct mnistfile {
+	const char* name;
+	std::streamoff size;
+};
+
+const mnistfile mnistfiles[] = {
+	{ "train-images.idx3-ubyte", 47040016 },
+	{ "train-labels.idx1-ubyte", 60008 },
+	{ "t10k-images.idx3-ubyte", 7840016 },
+	{ "t10k-labels.idx1-ubyte", 10008 },
+};
+
+//returns true if every mnist file is present with its full size
+//otherwise says which file is missing, and where to put the dataset
+inline bool checkmnist() {
+	for (const mnistfile& file : mnistfiles) {
+		std::ifstream stream(mnistdirectory + file.name, std::ios::binary | std::ios::ate);
+		if (!stream.is_open() || stream.tellg() != file.size) {
+			std::cerr << "could not read " << mnistdirectory << file.name << " (" << file.size << " bytes)" << std::endl;
+			std::cerr << "download MNIST to data/mnist, decompressed, and run the benchmark from ./bin/" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+}
+
+#endif
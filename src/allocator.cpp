@@ -0,0 +1,114 @@
+//Copyright 2017 Jakob Wyatt
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http ://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#include "allocator.h"
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+
+namespace math {
+namespace pool {
+
+namespace {
+
+//the smallest size class is one alignment sized block, and each class after it doubles
+const std::size_t smallestclass = 6;
+const std::size_t classes = sizeof(std::size_t) * 8;
+
+//freed blocks are kept in an intrusive list, with the link stored in the block itself
+struct freeblock {
+	freeblock* next;
+};
+
+struct state {
+	std::mutex lock;
+	freeblock* free[classes];
+	std::size_t heapallocations;
+
+	state() : free(), heapallocations(0) {
+
+	}
+};
+
+//this is a function local static so matricies can safely be used during static initialization
+//it is never destroyed, so matricies with static storage duration can still free their memory at exit
+state& pooled() {
+	static state* value = new state;
+	return *value;
+}
+
+//returns the size class that holds blocks of bytes bytes
+std::size_t sizeclass(std::size_t bytes) {
+	std::size_t result = smallestclass;
+	while (result != classes && (static_cast<std::size_t>(1) << result) < bytes) {
+		++result;
+	}
+	return result;
+}
+
+}
+
+void* allocate(std::size_t bytes) {
+	std::size_t index = sizeclass(bytes);
+	if (index >= classes) {
+		throw std::bad_alloc();
+	}
+
+	state& pool = pooled();
+	{
+		std::lock_guard<std::mutex> guard(pool.lock);
+		if (pool.free[index] != nullptr) {
+			freeblock* block = pool.free[index];
+			pool.free[index] = block->next;
+			return block;
+		}
+		++pool.heapallocations;
+	}
+	return ::operator new(static_cast<std::size_t>(1) << index, std::align_val_t(alignment));
+}
+
+void deallocate(void* ptr, std::size_t bytes) {
+	if (ptr == nullptr) {
+		return;
+	}
+
+	std::size_t index = sizeclass(bytes);
+	freeblock* block = static_cast<freeblock*>(ptr);
+	state& pool = pooled();
+	std::lock_guard<std::mutex> guard(pool.lock);
+	block->next = pool.free[index];
+	pool.free[index] = block;
+}
+
+void release() {
+	state& pool = pooled();
+	std::lock_guard<std::mutex> guard(pool.lock);
+	for (std::size_t i = 0; i != classes; ++i) {
+		while (pool.free[i] != nullptr) {
+			freeblock* block = pool.free[i];
+			pool.free[i] = block->next;
+			::operator delete(block, std::align_val_t(alignment));
+		}
+	}
+}
+
+std::size_t heapallocations() {
+	state& pool = pooled();
+	std::lock_guard<std::mutex> guard(pool.lock);
+	return pool.heapallocations;
+}
+
+}
+}
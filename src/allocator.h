@@ -0,0 +1,81 @@
+//Copyright 2017 Jakob Wyatt
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http ://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#ifndef GUARD_ALLOCATOR_H
+#define GUARD_ALLOCATOR_H
+
+#include <cstddef>
+#include <limits>
+#include <new>
+
+//matrix storage is drawn from a pool of aligned blocks
+//blocks are grouped into power of two size classes, and freed blocks are kept for reuse instead of
+//being returned to the heap, so code that keeps allocating matricies of the same sizes stops touching the heap
+namespace math {
+namespace pool {
+
+//alignment of every block, enough for a full avx-512 register or a cache line
+const std::size_t alignment = 64;
+
+//returns a block of at least bytes bytes, aligned to alignment
+//throws std::bad_alloc if the heap is exhausted
+void* allocate(std::size_t bytes);
+//returns a block to the pool, bytes must be the size it was allocated with
+void deallocate(void* ptr, std::size_t bytes);
+//returns every cached block to the heap
+void release();
+//returns the number of blocks the pool has taken from the heap, mainly for testing
+std::size_t heapallocations();
+
+}
+
+//standard allocator that draws from the pool
+template<typename T>
+class alignedallocator {
+public:
+	typedef T value_type;
+
+	alignedallocator() {
+
+	}
+	template<typename U>
+	alignedallocator(const alignedallocator<U>& other) {
+
+	}
+
+	T* allocate(std::size_t size) {
+		if (size > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+			throw std::bad_alloc();
+		}
+		return static_cast<T*>(pool::allocate(size * sizeof(T)));
+	}
+	void deallocate(T* ptr, std::size_t size) {
+		pool::deallocate(ptr, size * sizeof(T));
+	}
+};
+
+//all pool allocators share the same pool, so they are always equal
+template<typename T, typename U>
+bool operator==(const alignedallocator<T>& lhs, const alignedallocator<U>& rhs) {
+	return true;
+}
+
+template<typename T, typename U>
+bool operator!=(const alignedallocator<T>& lhs, const alignedallocator<U>& rhs) {
+	return false;
+}
+
+}
+
+#endif
@@ -0,0 +1,178 @@
+//Copyright 2017 Jakob Wyatt
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http ://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#include "arena.h"
+
+#include <cstddef>
+#include <vector>
+#include <stdexcept>
+#include <algorithm>
+
+#include "math.h"
+#include "allocator.h"
+
+//we will only error-check if the project is in debug mode
+//we use the _DEBUG macro to check for this
+namespace nn {
+
+namespace {
+
+//returns the number of elements that fill a whole number of alignment sized blocks
+template<typename T>
+std::size_t alignedsize(std::size_t size) {
+	std::size_t block = math::pool::alignment / sizeof(T);
+	return (size + block - 1) / block * block;
+}
+
+}
+
+template<typename T>
+basic_arena<T>::basic_arena() : _requests(), _views(), _data(), _allocated(false) {
+
+}
+
+template<typename T>
+typename basic_arena<T>::handle basic_arena<T>::reserve(size_type height, size_type width, size_type first, size_type last) {
+#ifdef _DEBUG
+	if (this->_allocated) {
+		throw std::logic_error("arena is already allocated");
+	}
+	if (first > last) {
+		throw std::invalid_argument("buffer is used after it is freed");
+	}
+#endif
+
+	request current = { height, width, first, last, 0 };
+	this->_requests.push_back(current);
+	return this->_requests.size() - 1;
+}
+
+template<typename T>
+typename basic_arena<T>::handle basic_arena<T>::reserve(const std::vector<buffershape>& shapes, size_type first, size_type last) {
+	handle result = this->_requests.size();
+	for (const buffershape& shape : shapes) {
+		this->reserve(shape.height, shape.width, first, last);
+	}
+	return result;
+}
+
+//the buffers are placed largest first, each at the lowest offset where it misses every placed buffer that is live at the same time
+//this greedy placement is not always optimal, but is close on the chains of buffers a neuralnet asks for
+template<typename T>
+void basic_arena<T>::allocate() {
+#ifdef _DEBUG
+	if (this->_allocated) {
+		throw std::logic_error("arena is already allocated");
+	}
+#endif
+
+	size_type count = this->_requests.size();
+	std::vector<size_type> order(count);
+	for (size_type i = 0; i != count; ++i) {
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](size_type lhs, size_type rhs) {
+		return this->_requests[lhs].height * this->_requests[lhs].width > this->_requests[rhs].height * this->_requests[rhs].width;
+	});
+
+	size_type total = 0;
+	std::vector<size_type> placed;
+	std::vector<size_type> live;
+	placed.reserve(count);
+	live.reserve(count);
+	for (size_type i : order) {
+		request& current = this->_requests[i];
+		size_type size = alignedsize<T>(current.height * current.width);
+
+		//the placed buffers that are live at the same time, in order of offset
+		live.clear();
+		for (size_type j : placed) {
+			const request& other = this->_requests[j];
+			if (other.first <= current.last && current.first <= other.last) {
+				live.push_back(j);
+			}
+		}
+		std::sort(live.begin(), live.end(), [&](size_type lhs, size_type rhs) {
+			return this->_requests[lhs].offset < this->_requests[rhs].offset;
+		});
+
+		//take the first gap that is large enough
+		size_type offset = 0;
+		for (size_type j : live) {
+			const request& other = this->_requests[j];
+			if (offset + size <= other.offset) {
+				break;
+			}
+			offset = std::max(offset, other.offset + alignedsize<T>(other.height * other.width));
+		}
+		current.offset = offset;
+		total = std::max(total, offset + size);
+		placed.push_back(i);
+	}
+
+	this->_data.assign(total, T(0));
+	this->_views.reserve(count);
+	for (const request& current : this->_requests) {
+		this->_views.push_back(view(this->_data.data() + current.offset, current.height, current.width));
+	}
+	this->_allocated = true;
+}
+
+template<typename T>
+typename basic_arena<T>::view basic_arena<T>::operator[](handle element) const {
+#ifdef _DEBUG
+	if (!this->_allocated) {
+		throw std::logic_error("arena is not allocated");
+	}
+	if (element >= this->_views.size()) {
+		throw std::out_of_range("out of range");
+	}
+#endif
+
+	return this->_views[element];
+}
+
+template<typename T>
+typename basic_arena<T>::buffers basic_arena<T>::group(handle first, size_type count) const {
+#ifdef _DEBUG
+	if (!this->_allocated) {
+		throw std::logic_error("arena is not allocated");
+	}
+	if (first + count > this->_views.size()) {
+		throw std::out_of_range("out of range");
+	}
+#endif
+
+	return buffers(this->_views.data() + first, count);
+}
+
+template<typename T>
+typename basic_arena<T>::size_type basic_arena<T>::size() const {
+	return this->_data.size();
+}
+
+template<typename T>
+typename basic_arena<T>::size_type basic_arena<T>::requested() const {
+	size_type total = 0;
+	for (const request& current : this->_requests) {
+		total += alignedsize<T>(current.height * current.width);
+	}
+	return total;
+}
+
+//the library is built for both single and double precision
+template class basic_arena<float>;
+template class basic_arena<double>;
+
+}
@@ -0,0 +1,140 @@
+//Copyright 2017 Jakob Wyatt
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http ://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#ifndef GUARD_ARENA_H
+#define GUARD_ARENA_H
+
+#include <cstddef>
+#include <vector>
+#include <stdexcept>
+
+#include "math.h"
+#include "matrixview.h"
+
+//planned scratch memory for training
+//every buffer is asked for up front, with the steps it is used in, and then all of them are placed in one contiguous arena
+//buffers that are never used in the same step may share memory, so the arena is usually much smaller than the buffers it holds
+namespace nn {
+
+//the size of a buffer asked for by a layer
+struct buffershape {
+	std::size_t height;
+	std::size_t width;
+};
+
+//the buffers handed to a layer, in the order the layer listed their shapes
+//this does not own the buffers, and is only valid while the arena they are in is
+template<typename T>
+class basic_buffers {
+public:
+	typedef math::basic_matrixview<T> view;
+	typedef std::size_t size_type;
+
+	//initializes an empty list of buffers
+	basic_buffers() : _data(nullptr), _size(0) {
+
+	}
+	//initializes a list of buffers given an array of views
+	basic_buffers(const view* data, size_type size) : _data(data), _size(size) {
+
+	}
+
+	//returns the specified buffer
+	view operator[](size_type element) const {
+#ifdef _DEBUG
+		if (element >= this->_size) {
+			throw std::out_of_range("out of range");
+		}
+#endif
+		return this->_data[element];
+	}
+	//returns count buffers, starting at the specified buffer
+	basic_buffers slice(size_type first, size_type count) const {
+#ifdef _DEBUG
+		if (first + count > this->_size) {
+			throw std::out_of_range("slice is out of range");
+		}
+#endif
+		return basic_buffers(this->_data + first, count);
+	}
+
+	//returns the number of buffers
+	size_type size() const { return this->_size; }
+
+private:
+	const view* _data;
+	size_type _size;
+};
+
+//plans the placement of buffers in a single arena, and owns the arena
+//steps are numbered by the caller, and a buffer is live from the first step it is used in to the last, inclusive
+//an arena can be moved, and the buffers it has handed out stay valid, but it cannot be copied
+template<typename T>
+class basic_arena {
+public:
+	typedef math::basic_matrixview<T> view;
+	typedef basic_buffers<T> buffers;
+	typedef std::size_t size_type;
+	//identifies a buffer within an arena
+	typedef std::size_t handle;
+
+	//initializes an arena with no buffers
+	basic_arena();
+	basic_arena(basic_arena&& other) = default;
+	basic_arena& operator=(basic_arena&& other) = default;
+	basic_arena(const basic_arena&) = delete;
+	basic_arena& operator=(const basic_arena&) = delete;
+
+	//asks for a height by width buffer, live from step first to step last
+	handle reserve(size_type height, size_type width, size_type first, size_type last);
+	//asks for a buffer of every shape, all live from step first to step last
+	//the handles are consecutive, and the first is returned
+	handle reserve(const std::vector<buffershape>& shapes, size_type first, size_type last);
+	//places every buffer, and allocates the arena
+	//each buffer starts at a 64 byte boundary, and every element of the arena starts as zero
+	//no more buffers can be asked for afterwards
+	void allocate();
+
+	//returns the specified buffer, once the arena is allocated
+	view operator[](handle element) const;
+	//returns count consecutive buffers, starting at the specified buffer, once the arena is allocated
+	buffers group(handle first, size_type count) const;
+
+	//returns the number of elements in the arena
+	size_type size() const;
+	//returns the number of elements the buffers would need if none of them shared memory
+	size_type requested() const;
+
+private:
+	//a buffer that has been asked for, and where it was placed
+	struct request {
+		size_type height;
+		size_type width;
+		size_type first;
+		size_type last;
+		size_type offset;
+	};
+
+	std::vector<request> _requests;
+	std::vector<view> _views;
+	std::vector<T, math::alignedallocator<T>> _data;
+	bool _allocated;
+};
+
+typedef basic_buffers<math::num> buffers;
+typedef basic_arena<math::num> arena;
+
+}
+
+#endif
@@ -0,0 +1,187 @@
+//Copyright 2017 Jakob Wyatt
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http ://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#ifndef GUARD_EXPRESSION_H
+#define GUARD_EXPRESSION_H
+
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+
+#include "simd.h"
+
+//lazy elementwise matrix arithmetic
+//operators build expression objects instead of matricies, and nothing is computed until
+//an expression is assigned to a matrix, at which point every element is found in a single loop
+//expressions hold references to the matricies they use, so they should not outlive them
+namespace math {
+
+template<typename T>
+class basic_matrix;
+
+//base class of every matrix expression
+//E is the derived class, which provides:
+//	value_type and size_type
+//	height, width and size
+//	element, which returns a single element of the result without bounds checking
+//	evaluate, which writes every element of the result to a contiguous array
+template<typename E>
+class expression {
+public:
+	//returns the expression as its derived type
+	const E& self() const { return static_cast<const E&>(*this); }
+};
+
+//elementwise operations used by binary expressions
+//apply is used inside fused loops, and kernel when both operands are already matricies
+struct addition {
+	template<typename T>
+	static T apply(T lhs, T rhs) { return lhs + rhs; }
+	template<typename T>
+	static void kernel(const T* lhs, const T* rhs, T* out, std::size_t size) { simd::active<T>().add(lhs, rhs, out, size); }
+};
+
+struct subtraction {
+	template<typename T>
+	static T apply(T lhs, T rhs) { return lhs - rhs; }
+	template<typename T>
+	static void kernel(const T* lhs, const T* rhs, T* out, std::size_t size) { simd::active<T>().subtract(lhs, rhs, out, size); }
+};
+
+struct multiplication {
+	template<typename T>
+	static T apply(T lhs, T rhs) { return lhs * rhs; }
+	template<typename T>
+	static void kernel(const T* lhs, const T* rhs, T* out, std::size_t size) { simd::active<T>().hadamard(lhs, rhs, out, size); }
+};
+
+//matricies are held by reference, and smaller expressions by value
+template<typename E>
+struct operand {
+	typedef E type;
+};
+
+template<typename T>
+struct operand<basic_matrix<T>> {
+	typedef const basic_matrix<T>& type;
+};
+
+//elementwise combination of two expressions of the same size
+template<typename L, typename R, typename Op>
+class binaryexpression : public expression<binaryexpression<L, R, Op>> {
+public:
+	typedef typename L::value_type value_type;
+	typedef typename L::size_type size_type;
+	static_assert(std::is_same<value_type, typename R::value_type>::value, "expressions have different scalar types");
+
+	binaryexpression(const L& lhs, const R& rhs) : _lhs(lhs), _rhs(rhs) {
+#ifdef _DEBUG
+		if (lhs.width() != rhs.width() || lhs.height() != rhs.height()) {
+			throw std::invalid_argument("matrix dimensions do not match");
+		}
+#endif
+	}
+
+	size_type height() const { return this->_lhs.height(); }
+	size_type width() const { return this->_lhs.width(); }
+	size_type size() const { return this->_lhs.size(); }
+
+	value_type element(size_type i) const { return Op::apply(this->_lhs.element(i), this->_rhs.element(i)); }
+
+	//out may alias either operand, as each element only reads from its own position
+	void evaluate(value_type* out) const { evaluate(this->_lhs, this->_rhs, out); }
+
+private:
+	typename operand<L>::type _lhs;
+	typename operand<R>::type _rhs;
+
+	template<typename A, typename B>
+	void evaluate(const A& lhs, const B& rhs, value_type* out) const {
+		size_type size = this->size();
+		for (size_type i = 0; i != size; ++i) {
+			out[i] = this->element(i);
+		}
+	}
+
+	//a single operation on two matricies goes straight to the simd kernels
+	void evaluate(const basic_matrix<value_type>& lhs, const basic_matrix<value_type>& rhs, value_type* out) const {
+		Op::kernel(lhs.data(), rhs.data(), out, this->size());
+	}
+};
+
+//an expression multiplied by a scalar
+template<typename E>
+class scaledexpression : public expression<scaledexpression<E>> {
+public:
+	typedef typename E::value_type value_type;
+	typedef typename E::size_type size_type;
+
+	scaledexpression(const E& expr, value_type scalar) : _expr(expr), _scalar(scalar) {
+
+	}
+
+	size_type height() const { return this->_expr.height(); }
+	size_type width() const { return this->_expr.width(); }
+	size_type size() const { return this->_expr.size(); }
+
+	value_type element(size_type i) const { return this->_expr.element(i) * this->_scalar; }
+
+	//out may alias the operand, as each element only reads from its own position
+	void evaluate(value_type* out) const { evaluate(this->_expr, out); }
+
+private:
+	typename operand<E>::type _expr;
+	value_type _scalar;
+
+	template<typename A>
+	void evaluate(const A& expr, value_type* out) const {
+		size_type size = this->size();
+		for (size_type i = 0; i != size; ++i) {
+			out[i] = this->element(i);
+		}
+	}
+
+	//scaling a matrix goes straight to the simd kernels
+	void evaluate(const basic_matrix<value_type>& expr, value_type* out) const {
+		simd::active<value_type>().multiply(expr.data(), this->_scalar, out, this->size());
+	}
+};
+
+//adds two expressions
+template<typename L, typename R>
+binaryexpression<L, R, addition> operator+(const expression<L>& lhs, const expression<R>& rhs) {
+	return binaryexpression<L, R, addition>(lhs.self(), rhs.self());
+}
+
+//subtracts two expressions
+template<typename L, typename R>
+binaryexpression<L, R, subtraction> operator-(const expression<L>& lhs, const expression<R>& rhs) {
+	return binaryexpression<L, R, subtraction>(lhs.self(), rhs.self());
+}
+
+//multiplies an expression by a scalar value
+template<typename E, typename S>
+typename std::enable_if<std::is_arithmetic<S>::value, scaledexpression<E>>::type operator*(const expression<E>& lhs, S scalar) {
+	return scaledexpression<E>(lhs.self(), static_cast<typename E::value_type>(scalar));
+}
+
+//multiplies an expression by a scalar value
+template<typename S, typename E>
+typename std::enable_if<std::is_arithmetic<S>::value, scaledexpression<E>>::type operator*(S scalar, const expression<E>& rhs) {
+	return scaledexpression<E>(rhs.self(), static_cast<typename E::value_type>(scalar));
+}
+
+}
+
+#endif
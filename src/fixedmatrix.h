@@ -0,0 +1,224 @@
+//Copyright 2017 Jakob Wyatt
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http ://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#ifndef GUARD_FIXEDMATRIX_H
+#define GUARD_FIXEDMATRIX_H
+
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <initializer_list>
+#include <algorithm>
+
+#include "math.h"
+
+//matricies whose dimensions are known at compile time
+//the elements are stored inline, so a fixed matrix never touches the heap, and every kernel below is fully unrolled
+//they are meant for small layers, where allocation and loop overhead cost more than the arithmetic
+//a fixed matrix converts to a view of itself, so it also works with the matrix kernels and the layers
+namespace math {
+
+//calls func(i) for every i in the sequence, with no loop left after inlining
+template<typename F, std::size_t... I>
+inline void unroll(F func, std::index_sequence<I...>) {
+	(func(I), ...);
+}
+
+template<std::size_t N, typename F>
+inline void unroll(F func) {
+	unroll(func, std::make_index_sequence<N>());
+}
+
+//row-major matrix with height H and width W
+//this class uses zero-indexing unless otherwise stated
+template<typename T, std::size_t H, std::size_t W>
+class basic_fixedmatrix : public expression<basic_fixedmatrix<T, H, W>> {
+public:
+	static_assert(H != 0 && W != 0, "fixed matricies cannot be empty");
+
+	typedef T value_type;
+	typedef std::size_t size_type;
+	typedef basic_matrixview<T> view;
+	typedef basic_matrixview<const T> constview;
+
+	//initializes a matrix with all elements set to 0
+	basic_fixedmatrix() : _data() {
+
+	}
+	//initializes a matrix given an initializer list, in row-major order
+	basic_fixedmatrix(std::initializer_list<T> initializerlist) : _data() {
+#ifdef _DEBUG
+		if (initializerlist.size() != H * W) {
+			throw std::invalid_argument("initializer list has incompatible size");
+		}
+#endif
+		std::copy(initializerlist.begin(), initializerlist.end(), this->_data);
+	}
+	//initializes a matrix by evaluating an expression
+	template<typename E>
+	basic_fixedmatrix(const expression<E>& expr) {
+		*this = expr;
+	}
+
+	//evaluates an expression into this matrix
+	//the expression may use this matrix
+	template<typename E>
+	basic_fixedmatrix& operator=(const expression<E>& expr) {
+		static_assert(std::is_same<T, typename E::value_type>::value, "expression has a different scalar type");
+#ifdef _DEBUG
+		if (expr.self().height() != H || expr.self().width() != W) {
+			throw std::invalid_argument("expression has incompatible size");
+		}
+#endif
+		expr.self().evaluate(this->_data);
+		return *this;
+	}
+
+	//returns a const reference to the specified element of the matrix
+	const T& operator()(size_type row, size_type column) const {
+#ifdef _DEBUG
+		if (row >= H || column >= W) {
+			throw std::out_of_range("out of range");
+		}
+#endif
+		return this->_data[row * W + column];
+	}
+	//returns a reference to the specified element of the matrix
+	T& operator()(size_type row, size_type column) {
+#ifdef _DEBUG
+		if (row >= H || column >= W) {
+			throw std::out_of_range("out of range");
+		}
+#endif
+		return this->_data[row * W + column];
+	}
+	//returns a const reference to the specified data element
+	const T& operator[](size_type element) const {
+#ifdef _DEBUG
+		if (element >= H * W) {
+			throw std::out_of_range("out of range");
+		}
+#endif
+		return this->_data[element];
+	}
+	//returns a reference to the specified data element
+	T& operator[](size_type element) {
+#ifdef _DEBUG
+		if (element >= H * W) {
+			throw std::out_of_range("out of range");
+		}
+#endif
+		return this->_data[element];
+	}
+
+	//returns a view of the matrix, for use with the matrix kernels and the layers
+	operator view() { return view(this->_data, H, W); }
+	//returns a read-only view of the matrix
+	operator constview() const { return constview(this->_data, H, W); }
+
+	//returns a const pointer to the underlying row-major array
+	const T* data() const { return this->_data; }
+	//returns a pointer to the underlying row-major array
+	T* data() { return this->_data; }
+	//sets every element to zero
+	void zero() { unroll<H * W>([this](size_type i) { this->_data[i] = 0; }); }
+
+	//returns the height of the matrix
+	static constexpr size_type height() { return H; }
+	//returns the width of the matrix
+	static constexpr size_type width() { return W; }
+	//returns the size of the matrix
+	static constexpr size_type size() { return H * W; }
+
+	//returns the specified data element without bounds checking, for use by expressions
+	T element(size_type i) const { return this->_data[i]; }
+	//copies the matrix to a contiguous array, for use by expressions
+	void evaluate(T* out) const { unroll<H * W>([this, out](size_type i) { out[i] = this->_data[i]; }); }
+
+	//the kernels below match the results of the matrix kernels with exact accuracy
+	//buffers may alias an input, except in multiply
+
+	//multiplies two matricies together and writes the result to a buffer
+	//each element is summed in the same order as math::gemm, so the results are identical
+	template<size_type K>
+	static void multiply(const basic_fixedmatrix<T, H, K>& lhs, const basic_fixedmatrix<T, K, W>& rhs, basic_fixedmatrix& buffer) {
+		unroll<H * W>([&](size_type i) {
+			size_type row = i / W;
+			size_type column = i % W;
+			T sum = 0;
+			unroll<K>([&](size_type k) { sum += lhs._data[row * K + k] * rhs._data[k * W + column]; });
+			buffer._data[i] = sum;
+		});
+	}
+	//multiplies a matrix by a scalar and writes the result to a buffer
+	static void multiply(const basic_fixedmatrix& lhs, T scalar, basic_fixedmatrix& buffer) {
+		unroll<H * W>([&](size_type i) { buffer._data[i] = lhs._data[i] * scalar; });
+	}
+	//applies a function to every element in a matrix and writes the result to a buffer
+	template<typename F>
+	static void function(F func, const basic_fixedmatrix& input, basic_fixedmatrix& buffer) {
+		unroll<H * W>([&](size_type i) { buffer._data[i] = func(input._data[i]); });
+	}
+	//adds two matricies together and writes the result to a buffer
+	static void add(const basic_fixedmatrix& lhs, const basic_fixedmatrix& rhs, basic_fixedmatrix& buffer) {
+		unroll<H * W>([&](size_type i) { buffer._data[i] = lhs._data[i] + rhs._data[i]; });
+	}
+	//subtracts two matricies and writes the result to a buffer
+	static void subtract(const basic_fixedmatrix& lhs, const basic_fixedmatrix& rhs, basic_fixedmatrix& buffer) {
+		unroll<H * W>([&](size_type i) { buffer._data[i] = lhs._data[i] - rhs._data[i]; });
+	}
+	//finds the hadamard product of two matricies and writes the result to a buffer
+	static void hadamard(const basic_fixedmatrix& lhs, const basic_fixedmatrix& rhs, basic_fixedmatrix& buffer) {
+		unroll<H * W>([&](size_type i) { buffer._data[i] = lhs._data[i] * rhs._data[i]; });
+	}
+	//applies the sigmoid function to every element in a matrix and writes the result to a buffer
+	static void sigmoid(const basic_fixedmatrix& input, basic_fixedmatrix& buffer) {
+		unroll<H * W>([&](size_type i) { buffer._data[i] = math::sigmoid(input._data[i]); });
+	}
+	//applies the derivative of the sigmoid function to every element in a matrix and writes the result to a buffer
+	static void sigmoidprime(const basic_fixedmatrix& input, basic_fixedmatrix& buffer) {
+		unroll<H * W>([&](size_type i) { buffer._data[i] = math::sigmoidprime(input._data[i]); });
+	}
+	//adds a bias to a matrix and applies the sigmoid function, writing the result to a buffer
+	static void biasedsigmoid(const basic_fixedmatrix& input, const basic_fixedmatrix& bias, basic_fixedmatrix& buffer) {
+		unroll<H * W>([&](size_type i) { buffer._data[i] = math::sigmoid(input._data[i] + bias._data[i]); });
+	}
+
+private:
+	template<typename, size_type, size_type> friend class basic_fixedmatrix;
+
+	alignas(sizeof(T) * H * W >= 64 ? 64 : alignof(T)) T _data[H * W];
+};
+
+//fixed matricies are small, so expressions hold them by reference rather than copying them
+template<typename T, std::size_t H, std::size_t W>
+struct operand<basic_fixedmatrix<T, H, W>> {
+	typedef const basic_fixedmatrix<T, H, W>& type;
+};
+
+//multiplies two fixed matricies together and returns the result, without touching the heap
+template<typename T, std::size_t H, std::size_t K, std::size_t W>
+basic_fixedmatrix<T, H, W> operator*(const basic_fixedmatrix<T, H, K>& lhs, const basic_fixedmatrix<T, K, W>& rhs) {
+	basic_fixedmatrix<T, H, W> result;
+	basic_fixedmatrix<T, H, W>::multiply(lhs, rhs, result);
+	return result;
+}
+
+template<std::size_t H, std::size_t W>
+using fixedmatrix = basic_fixedmatrix<num, H, W>;
+
+}
+
+#endif
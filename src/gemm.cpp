@@ -0,0 +1,303 @@
+//Copyright 2017 Jakob Wyatt
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http ://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#include "gemm.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+#include "math.h"
+#include "simd.h"
+#include "threads.h"
+
+//the blocked multiply follows the usual goto/blis structure:
+//b is packed into kc by nc panels that stay in L2/L3, a is packed into mc by kc blocks that stay in L2,
+//and a register-tiled micro-kernel computes mr by nr tiles of c from the packed data
+namespace math {
+
+namespace {
+
+//register tile height of the micro-kernel
+//the width, nr, is a multiple of gemmcolumns that depends on the instruction set, so it is read from the kernel table
+const std::size_t mr = simd::gemmrows;
+//cache block dimensions, mc is a multiple of mr and nc is a multiple of every nr
+const std::size_t kc = 256;
+const std::size_t mc = 96;
+const std::size_t nc = 1024;
+//below this many multiply-adds the cost of packing outweighs the benefit
+const std::size_t smallproblem = 16 * 16 * 16;
+//below this many multiply-adds the cost of waking the thread pool outweighs the benefit
+const std::size_t parallelproblem = 64 * 64 * 64;
+//smallest slices of c handed to a thread, in rows or columns
+const std::size_t rowgrain = 4 * mr;
+const std::size_t columngrain = 4 * simd::gemmcolumns;
+
+//copies an mb by kb block of op(a) into row panels of height mr
+//within a panel, the mr elements of each column are contiguous
+//rows past the edge of the block are padded with zeros
+//a transposed operand is read along its stored rows, so both cases stream through memory
+template<typename T>
+void packa(bool trans, std::size_t mb, std::size_t kb, const T* a, std::size_t lda, T* buffer) {
+	for (std::size_t ir = 0; ir < mb; ir += mr) {
+		std::size_t rows = std::min(mr, mb - ir);
+		if (trans) {
+			const T* panel = a + ir;
+			for (std::size_t p = 0; p != kb; ++p) {
+				const T* column = panel + p * lda;
+				for (std::size_t i = 0; i != rows; ++i) {
+					buffer[p * mr + i] = column[i];
+				}
+			}
+		} else {
+			const T* panel = a + ir * lda;
+			for (std::size_t i = 0; i != rows; ++i) {
+				const T* row = panel + i * lda;
+				for (std::size_t p = 0; p != kb; ++p) {
+					buffer[p * mr + i] = row[p];
+				}
+			}
+		}
+		for (std::size_t p = 0; p != kb; ++p) {
+			for (std::size_t i = rows; i != mr; ++i) {
+				buffer[p * mr + i] = 0;
+			}
+		}
+		buffer += mr * kb;
+	}
+}
+
+//copies a kb by nb block of op(b) into column panels of width nr
+//within a panel, the nr elements of each row are contiguous
+//columns past the edge of the block are padded with zeros
+template<typename T>
+void packb(bool trans, std::size_t nr, std::size_t kb, std::size_t nb, const T* b, std::size_t ldb, T* buffer) {
+	for (std::size_t jr = 0; jr < nb; jr += nr) {
+		std::size_t columns = std::min(nr, nb - jr);
+		if (trans) {
+			const T* panel = b + jr * ldb;
+			for (std::size_t j = 0; j != columns; ++j) {
+				const T* column = panel + j * ldb;
+				for (std::size_t p = 0; p != kb; ++p) {
+					buffer[p * nr + j] = column[p];
+				}
+			}
+		} else {
+			const T* panel = b + jr;
+			for (std::size_t p = 0; p != kb; ++p) {
+				const T* row = panel + p * ldb;
+				for (std::size_t j = 0; j != columns; ++j) {
+					buffer[p * nr + j] = row[j];
+				}
+			}
+		}
+		for (std::size_t p = 0; p != kb; ++p) {
+			for (std::size_t j = columns; j != nr; ++j) {
+				buffer[p * nr + j] = 0;
+			}
+		}
+		buffer += nr * kb;
+	}
+}
+
+//matrix-vector product, used when c has a single column
+//incb is the distance between consecutive elements of the op(b) vector
+//a transposed a is walked row by row in axpy form, so it is read in its natural order
+template<typename T>
+void gemv(bool transa, std::size_t m, std::size_t k, const T* a, std::size_t lda, const T* b, std::size_t incb, T* c, std::size_t ldc, bool accumulate) {
+	if (transa) {
+		for (std::size_t i = 0; !accumulate && i != m; ++i) {
+			c[i * ldc] = 0;
+		}
+		for (std::size_t p = 0; p != k; ++p) {
+			const T* row = a + p * lda;
+			T bp = b[p * incb];
+			for (std::size_t i = 0; i != m; ++i) {
+				c[i * ldc] += row[i] * bp;
+			}
+		}
+	} else {
+		for (std::size_t i = 0; i != m; ++i) {
+			const T* row = a + i * lda;
+			T sum = accumulate ? c[i * ldc] : 0;
+			for (std::size_t p = 0; p != k; ++p) {
+				sum += row[p] * b[p * incb];
+			}
+			c[i * ldc] = sum;
+		}
+	}
+}
+
+//unpacked i-k-j loop for small problems and thin inner dimensions (such as outer products)
+//rows of c are walked contiguously, and each element of c still sees its products in ascending k order
+template<typename T>
+void smallgemm(bool transa, bool transb, std::size_t m, std::size_t n, std::size_t k, const T* a, std::size_t lda, const T* b, std::size_t ldb, T* c, std::size_t ldc, bool accumulate) {
+	//strides of op(a) and op(b) along their rows and columns
+	std::size_t ars = transa ? 1 : lda;
+	std::size_t acs = transa ? lda : 1;
+	std::size_t brs = transb ? 1 : ldb;
+	std::size_t bcs = transb ? ldb : 1;
+
+	for (std::size_t i = 0; i != m; ++i) {
+		T* crow = c + i * ldc;
+		if (!accumulate) {
+			std::fill(crow, crow + n, T(0));
+		}
+		for (std::size_t p = 0; p != k; ++p) {
+			T aip = a[i * ars + p * acs];
+			const T* brow = b + p * brs;
+			for (std::size_t j = 0; j != n; ++j) {
+				crow[j] += aip * brow[j * bcs];
+			}
+		}
+	}
+}
+
+//single threaded multiply
+template<typename T>
+void serialgemm(bool transa, bool transb, std::size_t m, std::size_t n, std::size_t k, const T* a, std::size_t lda, const T* b, std::size_t ldb, T* c, std::size_t ldc, bool accumulate) {
+	if (n == 1) {
+		gemv(transa, m, k, a, lda, b, transb ? 1 : ldb, c, ldc, accumulate);
+		return;
+	}
+	if (m * n * k <= smallproblem || k < mr) {
+		smallgemm(transa, transb, m, n, k, a, lda, b, ldb, c, ldc, accumulate);
+		return;
+	}
+
+	//the micro-kernel comes from the simd kernels, so the tile is held in vector registers
+	const simd::kernels<T>& kernels = simd::active<T>();
+	void (*microkernel)(std::size_t, const T*, const T*, T*, std::size_t, std::size_t, std::size_t, bool) = kernels.gemmtile;
+	std::size_t nr = kernels.gemmwidth;
+
+	//packing buffers are kept per thread so repeated calls do not allocate
+	thread_local std::vector<T> packeda;
+	thread_local std::vector<T> packedb;
+	packeda.resize(mc * kc);
+	packedb.resize(kc * nc);
+
+	//strides of op(a) and op(b) along their rows and columns
+	std::size_t ars = transa ? 1 : lda;
+	std::size_t acs = transa ? lda : 1;
+	std::size_t brs = transb ? 1 : ldb;
+	std::size_t bcs = transb ? ldb : 1;
+
+	for (std::size_t jc = 0; jc < n; jc += nc) {
+		std::size_t nb = std::min(nc, n - jc);
+		for (std::size_t pc = 0; pc < k; pc += kc) {
+			std::size_t kb = std::min(kc, k - pc);
+			packb(transb, nr, kb, nb, b + pc * brs + jc * bcs, ldb, packedb.data());
+			for (std::size_t ic = 0; ic < m; ic += mc) {
+				std::size_t mb = std::min(mc, m - ic);
+				packa(transa, mb, kb, a + ic * ars + pc * acs, lda, packeda.data());
+				for (std::size_t jr = 0; jr < nb; jr += nr) {
+					for (std::size_t ir = 0; ir < mb; ir += mr) {
+						microkernel(kb, packeda.data() + ir * kb, packedb.data() + jr * kb,
+							c + (ic + ir) * ldc + jc + jr, ldc,
+							std::min(mr, mb - ir), std::min(nr, nb - jr), accumulate || pc != 0);
+					}
+				}
+			}
+		}
+	}
+}
+
+}
+
+//c is cut into slices along its larger dimension, and each slice is multiplied on its own thread
+//every element is still computed by one thread in ascending k order, so the result does not depend on the thread count
+template<typename T>
+void gemm(bool transa, bool transb, std::size_t m, std::size_t n, std::size_t k, const T* a, std::size_t lda, const T* b, std::size_t ldb, T* c, std::size_t ldc, bool accumulate) {
+	if (m * n * k < parallelproblem) {
+		serialgemm(transa, transb, m, n, k, a, lda, b, ldb, c, ldc, accumulate);
+		return;
+	}
+
+	std::size_t ars = transa ? 1 : lda;
+	std::size_t bcs = transb ? ldb : 1;
+	if (m >= n) {
+		parallelfor(m, rowgrain, [&](std::size_t begin, std::size_t end) {
+			serialgemm(transa, transb, end - begin, n, k, a + begin * ars, lda, b, ldb, c + begin * ldc, ldc, accumulate);
+		});
+	} else {
+		parallelfor(n, columngrain, [&](std::size_t begin, std::size_t end) {
+			serialgemm(transa, transb, m, end - begin, k, a, lda, b + begin * bcs, ldb, c + begin, ldc, accumulate);
+		});
+	}
+}
+
+template<typename T>
+void referencegemm(bool transa, bool transb, std::size_t m, std::size_t n, std::size_t k, const T* a, std::size_t lda, const T* b, std::size_t ldb, T* c, std::size_t ldc, bool accumulate) {
+	//strides of op(a) and op(b) along their rows and columns
+	std::size_t ars = transa ? 1 : lda;
+	std::size_t acs = transa ? lda : 1;
+	std::size_t brs = transb ? 1 : ldb;
+	std::size_t bcs = transb ? ldb : 1;
+
+	for (std::size_t i = 0; i != m; ++i) {
+		for (std::size_t j = 0; j != n; ++j) {
+			T sum = accumulate ? c[i * ldc + j] : 0;
+			for (std::size_t p = 0; p != k; ++p) {
+				sum += a[i * ars + p * acs] * b[p * brs + j * bcs];
+			}
+			c[i * ldc + j] = sum;
+		}
+	}
+}
+
+template void gemm(bool transa, bool transb, std::size_t m, std::size_t n, std::size_t k, const float* a, std::size_t lda, const float* b, std::size_t ldb, float* c, std::size_t ldc, bool accumulate);
+template void gemm(bool transa, bool transb, std::size_t m, std::size_t n, std::size_t k, const double* a, std::size_t lda, const double* b, std::size_t ldb, double* c, std::size_t ldc, bool accumulate);
+template void referencegemm(bool transa, bool transb, std::size_t m, std::size_t n, std::size_t k, const float* a, std::size_t lda, const float* b, std::size_t ldb, float* c, std::size_t ldc, bool accumulate);
+template void referencegemm(bool transa, bool transb, std::size_t m, std::size_t n, std::size_t k, const double* a, std::size_t lda, const double* b, std::size_t ldb, double* c, std::size_t ldc, bool accumulate);
+
+//the columns of op(b) are copied out, unless b is transposed and they are already its rows,
+//so every tile of c is made of dot products of contiguous arrays, and each array read is shared by the whole tile
+void gemm(bool transb, std::size_t m, std::size_t n, std::size_t k, const std::int8_t* a, std::size_t lda, const std::int8_t* b, std::size_t ldb, std::int32_t* c, std::size_t ldc) {
+	const std::int8_t* columns = b;
+	std::size_t columnstride = ldb;
+	std::vector<std::int8_t> packed;
+	if (!transb) {
+		columnstride = k;
+		if (n != 1 || ldb != 1) {
+			packed.resize(n * k);
+			for (std::size_t p = 0; p != k; ++p) {
+				for (std::size_t j = 0; j != n; ++j) {
+					packed[j * k + p] = b[p * ldb + j];
+				}
+			}
+			columns = packed.data();
+		}
+	}
+
+	//the tile comes from the simd kernels, so the sums are held in vector registers
+	void (*tile)(std::size_t, const std::int8_t*, std::size_t, const std::int8_t*, std::size_t, std::int32_t*, std::size_t, std::size_t, std::size_t) = simd::activeinteger().int8tile;
+
+	std::function<void(std::size_t, std::size_t)> rows = [&](std::size_t begin, std::size_t end) {
+		for (std::size_t i = begin; i < end; i += simd::int8rows) {
+			std::size_t height = std::min(simd::int8rows, end - i);
+			for (std::size_t j = 0; j < n; j += simd::int8columns) {
+				tile(k, a + i * lda, lda, columns + j * columnstride, columnstride, c + i * ldc + j, ldc, height, std::min(simd::int8columns, n - j));
+			}
+		}
+	};
+	if (m * n * k < parallelproblem) {
+		rows(0, m);
+		return;
+	}
+	parallelfor(m, rowgrain, rows);
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+//Copyright 2017 Jakob Wyatt
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http ://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#ifndef GUARD_GEMM_H
+#define GUARD_GEMM_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "math.h"
+
+namespace math {
+
+//general matrix multiply on raw row-major storage: c = op(a) * op(b)
+//op(x) is x, or x transposed if the matching trans flag is set
+//op(a) is m by k, op(b) is k by n and c is m by n
+//lda, ldb and ldc are the distances between the starts of consecutive stored rows of each operand
+//every element of c is accumulated in ascending k order, starting from zero,
+//so the result is bit-for-bit identical to a naive dot product
+//if accumulate is set, c += op(a) * op(b) instead, with every element starting from its value in c
+template<typename T>
+void gemm(bool transa, bool transb, std::size_t m, std::size_t n, std::size_t k, const T* a, std::size_t lda, const T* b, std::size_t ldb, T* c, std::size_t ldc, bool accumulate = false);
+//naive multiply with the same arguments as gemm, where each element of c is a dot product walked down a column of op(b)
+//it is far slower than gemm, and is kept as the reference that gemm is checked against bit for bit
+template<typename T>
+void referencegemm(bool transa, bool transb, std::size_t m, std::size_t n, std::size_t k, const T* a, std::size_t lda, const T* b, std::size_t ldb, T* c, std::size_t ldc, bool accumulate = false);
+
+//integer matrix multiply on raw row-major storage, used for quantized inference: c = a * op(b)
+//a is m by k, op(b) is k by n and c is m by n, with the products summed exactly in 32 bits
+//op(b) is b, or b transposed if transb is set, which multiplies a batch of inputs by weights with an output per row without copying them
+//k must be small enough that the sums cannot overflow, which holds for k below 2^17
+void gemm(bool transb, std::size_t m, std::size_t n, std::size_t k, const std::int8_t* a, std::size_t lda, const std::int8_t* b, std::size_t ldb, std::int32_t* c, std::size_t ldc);
+
+}
+
+#endif
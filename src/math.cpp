@@ -22,16 +22,142 @@
 #include <cmath>
 #include <algorithm>
 #include <utility>
+#include <atomic>
+
+#include "gemm.h"
+#include "simd.h"
+#include "threads.h"
 
 //we will only error-check if the project is in debug mode
 //we use the _DEBUG macro to check for this
 namespace math {
 
-matrix::matrix() : _data(0), _width(0) {
+namespace {
+
+//elementwise work is limited by memory bandwidth, so it is only split across threads when it is large
+const std::size_t parallelelements = 1 << 16;
+//smallest number of elements handed to a thread
+const std::size_t elementgrain = 1 << 14;
+
+//calls a kernel that works on contiguous arrays, such as the simd kernels, on views
+//the views are handed over in one call when they are contiguous, and a row at a time otherwise
+//large views are split across threads
+template<typename T, typename K>
+void rowwise(basic_matrixview<const T> input, basic_matrixview<T> out, K kernel) {
+	const T* inputptr = input.data();
+	T* outptr = out.data();
+	if (input.contiguous() && out.contiguous()) {
+		if (input.size() < parallelelements) {
+			kernel(inputptr, outptr, input.size());
+			return;
+		}
+		parallelfor(input.size(), elementgrain, [&](std::size_t begin, std::size_t end) {
+			kernel(inputptr + begin, outptr + begin, end - begin);
+		});
+		return;
+	}
+
+	std::function<void(std::size_t, std::size_t)> rows = [&](std::size_t begin, std::size_t end) {
+		for (std::size_t i = begin; i != end; ++i) {
+			kernel(inputptr + i * input.stride(), outptr + i * out.stride(), input.width());
+		}
+	};
+	if (input.size() < parallelelements) {
+		rows(0, input.height());
+		return;
+	}
+	parallelfor(input.height(), std::max(elementgrain / input.width(), static_cast<std::size_t>(1)), rows);
+}
+
+template<typename T, typename K>
+void rowwise(basic_matrixview<const T> lhs, basic_matrixview<const T> rhs, basic_matrixview<T> out, K kernel) {
+	const T* lhsptr = lhs.data();
+	const T* rhsptr = rhs.data();
+	T* outptr = out.data();
+	if (lhs.contiguous() && rhs.contiguous() && out.contiguous()) {
+		if (lhs.size() < parallelelements) {
+			kernel(lhsptr, rhsptr, outptr, lhs.size());
+			return;
+		}
+		parallelfor(lhs.size(), elementgrain, [&](std::size_t begin, std::size_t end) {
+			kernel(lhsptr + begin, rhsptr + begin, outptr + begin, end - begin);
+		});
+		return;
+	}
+
+	std::function<void(std::size_t, std::size_t)> rows = [&](std::size_t begin, std::size_t end) {
+		for (std::size_t i = begin; i != end; ++i) {
+			kernel(lhsptr + i * lhs.stride(), rhsptr + i * rhs.stride(), outptr + i * out.stride(), lhs.width());
+		}
+	};
+	if (lhs.size() < parallelelements) {
+		rows(0, lhs.height());
+		return;
+	}
+	parallelfor(lhs.height(), std::max(elementgrain / lhs.width(), static_cast<std::size_t>(1)), rows);
+}
+
+//returns an element of a view, given its offset, or null if the view is empty
+//inplace hands an empty view to its kernel as null, so a kernel can take optional arrays
+template<typename T>
+T* offset(basic_matrixview<T> view, std::size_t element) {
+	return view.size() == 0 ? nullptr : view.data() + element;
+}
+
+//calls a kernel that updates several arrays of the same size in place, such as the optimizer steps, on views of the same shape
+//views after the first may be empty, and are then handed to the kernel as null
+//as in rowwise, contiguous views are handed over in one call, and large views are split across threads
+template<typename T, typename K, typename... V>
+void inplace(K kernel, basic_matrixview<T> first, V... rest) {
+	if (first.contiguous() && ((rest.contiguous() || rest.size() == 0) && ...)) {
+		if (first.size() < parallelelements) {
+			kernel(first.data(), offset(rest, 0)..., first.size());
+			return;
+		}
+		parallelfor(first.size(), elementgrain, [&](std::size_t begin, std::size_t end) {
+			kernel(first.data() + begin, offset(rest, begin)..., end - begin);
+		});
+		return;
+	}
+
+	std::function<void(std::size_t, std::size_t)> rows = [&](std::size_t begin, std::size_t end) {
+		for (std::size_t i = begin; i != end; ++i) {
+			kernel(first.data() + i * first.stride(), offset(rest, i * rest.stride())..., first.width());
+		}
+	};
+	if (first.size() < parallelelements) {
+		rows(0, first.height());
+		return;
+	}
+	parallelfor(first.height(), std::max(elementgrain / first.width(), static_cast<std::size_t>(1)), rows);
+}
+
+//returns the position of the first max element in a view, counting along the rows
+template<typename T>
+std::size_t argmax(basic_matrixview<const T> input) {
+	std::size_t result = 0;
+	const T* best = input.data();
+	for (std::size_t i = 0; i != input.height(); ++i) {
+		const T* row = input.data() + i * input.stride();
+		for (std::size_t j = 0; j != input.width(); ++j) {
+			if (*best < row[j]) {
+				best = row + j;
+				result = i * input.width() + j;
+			}
+		}
+	}
+	return result;
+}
+
+}
+
+template<typename T>
+basic_matrix<T>::basic_matrix() : _data(0), _width(0) {
 
 }
 
-matrix::matrix(matrix::size_type height, matrix::size_type width) : _data(height * width), _width(width) {
+template<typename T>
+basic_matrix<T>::basic_matrix(size_type height, size_type width) : _data(height * width), _width(width) {
 #ifdef _DEBUG
 	if (width <= 0 || height <= 0) {
 		throw std::invalid_argument("empty matrix initialization");
@@ -39,7 +165,8 @@ matrix::matrix(matrix::size_type height, matrix::size_type width) : _data(height
 #endif
 }
 
-matrix::matrix(size_type height, size_type width, std::initializer_list<num> initializerlist) : _data(initializerlist), _width(width) {
+template<typename T>
+basic_matrix<T>::basic_matrix(size_type height, size_type width, std::initializer_list<T> initializerlist) : _data(initializerlist), _width(width) {
 #ifdef _DEBUG
 	if (width <= 0 || height <= 0) {
 		throw std::invalid_argument("empty matrix initialization");
@@ -52,20 +179,22 @@ matrix::matrix(size_type height, size_type width, std::initializer_list<num> ini
 
 //we init to zero's->fill using index instead of empty init->reserve->push_back
 //this is because, under performance tests, the method below is approx 3.5x faster
-matrix::matrix(matrix::size_type height, matrix::size_type width, std::function<num()> func) : matrix(height, width) {
+template<typename T>
+basic_matrix<T>::basic_matrix(size_type height, size_type width, std::function<T()> func) : basic_matrix(height, width) {
 #ifdef _DEBUG
 	if (width <= 0 || height <= 0) {
 		throw std::invalid_argument("empty matrix initialization");
 	}
 #endif
 
-	matrix::size_type size = this->size();
-	for (matrix::size_type i = 0; i != size; ++i) {
+	size_type size = this->size();
+	for (size_type i = 0; i != size; ++i) {
 		this->_data[i] = func();
 	}
 }
 
-matrix::matrix(const std::vector<num>& data, matrix::size_type width) : _data(data), _width(width) {
+template<typename T>
+basic_matrix<T>::basic_matrix(const std::vector<T>& data, size_type width) : _data(data.begin(), data.end()), _width(width) {
 #ifdef _DEBUG
 	if (width <= 0 || data.size() <= 0) {
 		throw std::invalid_argument("empty matrix initialization");
@@ -73,18 +202,20 @@ matrix::matrix(const std::vector<num>& data, matrix::size_type width) : _data(da
 #endif
 }
 
-matrix matrix::onehotmatrix(matrix::size_type height, matrix::size_type width, matrix::size_type row, matrix::size_type column) {
-	matrix result(height, width);
+template<typename T>
+basic_matrix<T> basic_matrix<T>::onehotmatrix(size_type height, size_type width, size_type row, size_type column) {
+	basic_matrix result(height, width);
 	result(row, column) = 1;
 	return result;
 }
 
 //TODO: make different rows line up
-std::ostream& operator<<(std::ostream& cout, const matrix& toprint) {
-	matrix::size_type height = toprint.height();
-	matrix::size_type width = toprint.width();
-	for (matrix::size_type i = 0; i != height; ++i) {
-		for (matrix::size_type j = 0; j != width; ++j) {
+template<typename T>
+std::ostream& operator<<(std::ostream& cout, const basic_matrix<T>& toprint) {
+	typename basic_matrix<T>::size_type height = toprint.height();
+	typename basic_matrix<T>::size_type width = toprint.width();
+	for (typename basic_matrix<T>::size_type i = 0; i != height; ++i) {
+		for (typename basic_matrix<T>::size_type j = 0; j != width; ++j) {
 			cout << toprint(i, j) << " ";
 		}
 		cout << "\n";
@@ -92,7 +223,8 @@ std::ostream& operator<<(std::ostream& cout, const matrix& toprint) {
 	return cout;
 }
 
-const num& matrix::operator()(matrix::size_type row, matrix::size_type column) const {
+template<typename T>
+const T& basic_matrix<T>::operator()(size_type row, size_type column) const {
 #ifdef _DEBUG
 	if (this->width() <= column || this->height() <= row || row < 0 || column < 0) {
 		throw std::out_of_range("out of range");
@@ -102,7 +234,8 @@ const num& matrix::operator()(matrix::size_type row, matrix::size_type column) c
 	return this->_data[this->width() * row + column];
 }
 
-num& matrix::operator()(matrix::size_type row, matrix::size_type column) {
+template<typename T>
+T& basic_matrix<T>::operator()(size_type row, size_type column) {
 #ifdef _DEBUG
 	if (this->width() <= column || this->height() <= row || row < 0 || column < 0) {
 		throw std::out_of_range("out of range");
@@ -112,7 +245,8 @@ num& matrix::operator()(matrix::size_type row, matrix::size_type column) {
 	return this->_data[this->width() * row + column];
 }
 
-const num& matrix::operator[](matrix::size_type element) const {
+template<typename T>
+const T& basic_matrix<T>::operator[](size_type element) const {
 #ifdef _DEBUG
 	if (element < 0 || element >= this->size()) {
 		throw std::out_of_range("out of range");
@@ -122,7 +256,8 @@ const num& matrix::operator[](matrix::size_type element) const {
 	return this->_data[element];
 }
 
-num& matrix::operator[](matrix::size_type element) {
+template<typename T>
+T& basic_matrix<T>::operator[](size_type element) {
 #ifdef _DEBUG
 	if (element < 0 || element >= this->size()) {
 		throw std::out_of_range("out of range");
@@ -132,114 +267,78 @@ num& matrix::operator[](matrix::size_type element) {
 	return this->_data[element];
 }
 
-matrix matrix::operator*(const matrix& rhs) const {
+template<typename T>
+basic_matrix<T> basic_matrix<T>::operator*(const basic_matrix& rhs) const {
 #ifdef _DEBUG
 	if (this->width() != rhs.height()) {
 		throw std::invalid_argument("matrix dimensions are incompatible");
 	}
 #endif
 
-	matrix::size_type lhsheight = this->height();
-	matrix::size_type rhswidth = rhs.width();
-
-	matrix result(lhsheight, rhswidth);
-	for (matrix::size_type i = 0; i != lhsheight; ++i) {
-		for (matrix::size_type j = 0; j != rhswidth; ++j) {
-			result(i, j) = dotproduct(*this, rhs, i, j);
-		}
-	}
+	basic_matrix result(this->height(), rhs.width());
+	gemm(false, false, this->height(), rhs.width(), this->width(), this->data(), this->width(), rhs.data(), rhs.width(), result.data(), result.width());
 
 	return result;
 }
 
-matrix matrix::operator*(math::num scalar) const {
-	matrix result(this->height(), this->width());
-	matrix::size_type size = this->size();
-	for (matrix::size_type i = 0; i != size; ++i) {
-		result[i] = this->operator[](i) * scalar;
-	}
-
-	return result;
+template<typename T>
+basic_matrix<T> basic_matrix<T>::operator()(std::function<T(T)> func) const {
+	return this->template operator()<const std::function<T(T)>&>(func);
 }
 
-matrix operator*(num scalar, const matrix& rhs) {
-	matrix result(rhs.height(), rhs.width());
-	matrix::size_type size = rhs.size();
-	for (matrix::size_type i = 0; i != size; ++i) {
-		result[i] = rhs[i] * scalar;
-	}
 
-	return result;
+template<typename T>
+typename basic_matrix<T>::const_iterator basic_matrix<T>::max() const {
+	return std::max_element(this->begin(), this->end());
 }
 
-matrix matrix::operator()(std::function<num(num)> func) const {
-	matrix result(this->height(), this->width());
-	matrix::size_type size = this->size();
-	for (matrix::size_type i = 0; i != size; ++i) {
-		result[i] = func(this->operator[](i));
-	}
-
-	return result;
+template<typename T>
+typename basic_matrix<T>::iterator basic_matrix<T>::max() {
+	return std::max_element(this->begin(), this->end());
 }
 
-matrix matrix::operator+(const matrix& rhs) const {
-#ifdef _DEBUG
-	if (this->width() != rhs.width() || this->height() != rhs.height()) {
-		throw std::invalid_argument("matrix dimensions do not match");
-	}
-#endif
-
-	matrix result(this->height(), this->width());
-	matrix::size_type size = this->size();
-	for (matrix::size_type i = 0; i != size; ++i) {
-		result[i] = this->operator[](i) + rhs[i];
-	}
-
-	return result;
+template<typename T>
+typename basic_matrix<T>::const_iterator basic_matrix<T>::begin() const {
+	return this->_data.begin();
 }
 
-matrix matrix::operator-(const matrix& rhs) const {
-#ifdef _DEBUG
-	if (this->width() != rhs.width() || this->height() != rhs.height()) {
-		throw std::invalid_argument("matrix dimensions do not match");
-	}
-#endif
-
-	matrix result(this->height(), this->width());
-	matrix::size_type size = this->size();
-	for (matrix::size_type i = 0; i != size; ++i) {
-		result[i] = this->operator[](i) - rhs[i];
-	}
-
-	return result;
+template<typename T>
+typename basic_matrix<T>::iterator basic_matrix<T>::begin() {
+	return this->_data.begin();
 }
 
-
-matrix::const_iterator matrix::max() const {
-	return std::max_element(this->begin(), this->end());
+template<typename T>
+typename basic_matrix<T>::const_iterator basic_matrix<T>::end() const {
+	return this->_data.end();
 }
 
-matrix::iterator matrix::max() {
-	return std::max_element(this->begin(), this->end());
+template<typename T>
+typename basic_matrix<T>::iterator basic_matrix<T>::end() {
+	return this->_data.end();
 }
 
-matrix::const_iterator matrix::begin() const {
-	return this->_data.begin();
+template<typename T>
+const T* basic_matrix<T>::data() const {
+	return this->_data.data();
 }
 
-matrix::iterator matrix::begin() {
-	return this->_data.begin();
+template<typename T>
+T* basic_matrix<T>::data() {
+	return this->_data.data();
 }
 
-matrix::const_iterator matrix::end() const {
-	return this->_data.end();
+template<typename T>
+void basic_matrix<T>::zero() {
+	std::fill(this->_data.begin(), this->_data.end(), T(0));
 }
 
-matrix::iterator matrix::end() {
-	return this->_data.end();
+template<typename T>
+void basic_matrix<T>::evaluate(T* out) const {
+	std::copy(this->_data.begin(), this->_data.end(), out);
 }
 
-void matrix::multiply(const matrix& lhs, const matrix& rhs, matrix& buffer) {
+template<typename T>
+void basic_matrix<T>::multiply(constview lhs, constview rhs, view buffer) {
 #ifdef _DEBUG
 	if (lhs.width() != rhs.height()) {
 		throw std::invalid_argument("matrix dimensions are incompatible");
@@ -247,52 +346,59 @@ void matrix::multiply(const matrix& lhs, const matrix& rhs, matrix& buffer) {
 	if (buffer.height() != lhs.height() || buffer.width() != rhs.width()) {
 		throw std::invalid_argument("buffer matrix has incompatible size");
 	}
-	if (&lhs == &buffer) {
+	if (lhs.data() == buffer.data()) {
 		throw std::invalid_argument("buffer matrix is the same object as the left hand side argument");
 	}
-	if (&rhs == &buffer) {
+	if (rhs.data() == buffer.data()) {
 		throw std::invalid_argument("buffer matrix is the same object as the right hand side argument");
 	}
 #endif
 
-	matrix::size_type lhsheight = lhs.height();
-	matrix::size_type rhswidth = rhs.width();
+	gemm(false, false, lhs.height(), rhs.width(), lhs.width(), lhs.data(), lhs.stride(), rhs.data(), rhs.stride(), buffer.data(), buffer.stride());
+}
 
-	matrix result(lhsheight, rhswidth);
-	for (matrix::size_type i = 0; i != lhsheight; ++i) {
-		for (matrix::size_type j = 0; j != rhswidth; ++j) {
-			buffer(i, j) = dotproduct(lhs, rhs, i, j);
+//each element sums its products in ascending column order, as the dense multiply does,
+//so skipping the zeros gives the same result
+template<typename T>
+void basic_matrix<T>::multiply(constview lhs, sparsevector rhs, view buffer) {
+#ifdef _DEBUG
+	if (lhs.width() != rhs.size()) {
+		throw std::invalid_argument("matrix dimensions are incompatible");
+	}
+	if (buffer.height() != lhs.height() || buffer.width() != 1) {
+		throw std::invalid_argument("buffer matrix has incompatible size");
+	}
+#endif
+
+	const T* values = rhs.values();
+	const size_type* indices = rhs.indices();
+	size_type nonzeros = rhs.nonzeros();
+	for (size_type i = 0; i != lhs.height(); ++i) {
+		const T* row = lhs.data() + i * lhs.stride();
+		T sum = 0;
+		for (size_type j = 0; j != nonzeros; ++j) {
+			sum += row[indices[j]] * values[j];
 		}
+		buffer.data()[i * buffer.stride()] = sum;
 	}
 }
 
-matrix matrix::lefttransposedmultiply(const matrix& lhs, const matrix& rhs) {
+template<typename T>
+basic_matrix<T> basic_matrix<T>::lefttransposedmultiply(constview lhs, constview rhs) {
 #ifdef _DEBUG
 	if (lhs.height() != rhs.height()) {
 		throw std::invalid_argument("matrix dimensions are incompatible");
 	}
 #endif
 
-	matrix::size_type lhsheight = lhs.height();
-	matrix::size_type lhswidth = lhs.width();
-	matrix::size_type rhswidth = rhs.width();
-	num sum = 0;
-
-	matrix result(lhs.width(), rhs.width());
-	for (matrix::size_type i = 0; i != lhswidth; ++i) {
-		for (matrix::size_type j = 0; j != rhswidth; ++j) {
-			for (matrix::size_type k = 0; k != lhsheight; ++k) {
-				sum += lhs(k, i) * rhs(k, j);
-			}
-			result(i, j) = sum;
-			sum = 0;
-		}
-	}
+	basic_matrix result(lhs.width(), rhs.width());
+	gemm(true, false, lhs.width(), rhs.width(), lhs.height(), lhs.data(), lhs.stride(), rhs.data(), rhs.stride(), result.data(), result.width());
 
 	return result;
 }
 
-void matrix::lefttransposedmultiply(const matrix& lhs, const matrix& rhs, matrix& buffer) {
+template<typename T>
+void basic_matrix<T>::lefttransposedmultiply(constview lhs, constview rhs, view buffer) {
 #ifdef _DEBUG
 	if (lhs.height() != rhs.height()) {
 		throw std::invalid_argument("matrix dimensions are incompatible");
@@ -300,57 +406,53 @@ void matrix::lefttransposedmultiply(const matrix& lhs, const matrix& rhs, matrix
 	if (lhs.width() != buffer.height() || rhs.width() != buffer.width()) {
 		throw std::invalid_argument("buffer matrix dimensions are incompatible");
 	}
-	if (&lhs == &buffer) {
+	if (lhs.data() == buffer.data()) {
 		throw std::invalid_argument("buffer matrix is the same object as the left hand side argument");
 	}
-	if (&rhs == &buffer) {
+	if (rhs.data() == buffer.data()) {
 		throw std::invalid_argument("buffer matrix is the same object as the right hand side argument");
 	}
 #endif
 
-	matrix::size_type lhsheight = lhs.height();
-	matrix::size_type lhswidth = lhs.width();
-	matrix::size_type rhswidth = rhs.width();
-	num sum = 0;
+	gemm(true, false, lhs.width(), rhs.width(), lhs.height(), lhs.data(), lhs.stride(), rhs.data(), rhs.stride(), buffer.data(), buffer.stride());
+}
 
-	for (matrix::size_type i = 0; i != lhswidth; ++i) {
-		for (matrix::size_type j = 0; j != rhswidth; ++j) {
-			for (matrix::size_type k = 0; k != lhsheight; ++k) {
-				sum += lhs(k, i) * rhs(k, j);
-			}
-			buffer(i, j) = sum;
-			sum = 0;
-		}
+template<typename T>
+void basic_matrix<T>::lefttransposedmultiplyadd(constview lhs, constview rhs, view buffer) {
+#ifdef _DEBUG
+	if (lhs.height() != rhs.height()) {
+		throw std::invalid_argument("matrix dimensions are incompatible");
+	}
+	if (lhs.width() != buffer.height() || rhs.width() != buffer.width()) {
+		throw std::invalid_argument("buffer matrix dimensions are incompatible");
+	}
+	if (lhs.data() == buffer.data()) {
+		throw std::invalid_argument("buffer matrix is the same object as the left hand side argument");
 	}
+	if (rhs.data() == buffer.data()) {
+		throw std::invalid_argument("buffer matrix is the same object as the right hand side argument");
+	}
+#endif
+
+	gemm(true, false, lhs.width(), rhs.width(), lhs.height(), lhs.data(), lhs.stride(), rhs.data(), rhs.stride(), buffer.data(), buffer.stride(), true);
 }
 
-matrix matrix::righttransposedmultiply(const matrix& lhs, const matrix& rhs) {
+template<typename T>
+basic_matrix<T> basic_matrix<T>::righttransposedmultiply(constview lhs, constview rhs) {
 #ifdef _DEBUG
 	if (lhs.width() != rhs.width()) {
 		throw std::invalid_argument("matrix dimensions are incompatible");
 	}
 #endif
 
-	matrix::size_type lhsheight = lhs.height();
-	matrix::size_type rhsheight = rhs.height();
-	matrix::size_type lhswidth = lhs.width();
-	num sum = 0;
-
-	matrix result(lhsheight, rhsheight);
-	for (matrix::size_type i = 0; i != lhsheight; ++i) {
-		for (matrix::size_type j = 0; j != rhsheight; ++j) {
-			for (matrix::size_type k = 0; k != lhswidth; ++k) {
-				sum += lhs(i, k) * rhs(j, k);
-			}
-			result(i, j) = sum;
-			sum = 0;
-		}
-	}
+	basic_matrix result(lhs.height(), rhs.height());
+	gemm(false, true, lhs.height(), rhs.height(), lhs.width(), lhs.data(), lhs.stride(), rhs.data(), rhs.stride(), result.data(), result.width());
 
 	return result;
 }
 
-void matrix::righttransposedmultiply(const matrix& lhs, const matrix& rhs, matrix& buffer) {
+template<typename T>
+void basic_matrix<T>::righttransposedmultiply(constview lhs, constview rhs, view buffer) {
 #ifdef _DEBUG
 	if (lhs.width() != rhs.width()) {
 		throw std::invalid_argument("matrix dimensions are incompatible");
@@ -358,73 +460,107 @@ void matrix::righttransposedmultiply(const matrix& lhs, const matrix& rhs, matri
 	if (lhs.height() != buffer.height() || rhs.height() != buffer.width()) {
 		throw std::invalid_argument("buffer matrix has incompatible size");
 	}
-	if (&lhs == &buffer) {
+	if (lhs.data() == buffer.data()) {
 		throw std::invalid_argument("buffer matrix is the same object as the left hand side argument");
 	}
-	if (&rhs == &buffer) {
+	if (rhs.data() == buffer.data()) {
 		throw std::invalid_argument("buffer matrix is the same object as the right hand side argument");
 	}
 #endif
 
-	matrix::size_type lhsheight = lhs.height();
-	matrix::size_type rhsheight = rhs.height();
-	matrix::size_type lhswidth = lhs.width();
-	num sum = 0;
+	gemm(false, true, lhs.height(), rhs.height(), lhs.width(), lhs.data(), lhs.stride(), rhs.data(), rhs.stride(), buffer.data(), buffer.stride());
+}
 
-	for (matrix::size_type i = 0; i != lhsheight; ++i) {
-		for (matrix::size_type j = 0; j != rhsheight; ++j) {
-			for (matrix::size_type k = 0; k != lhswidth; ++k) {
-				sum += lhs(i, k) * rhs(j, k);
-			}
-			buffer(i, j) = sum;
-			sum = 0;
+template<typename T>
+void basic_matrix<T>::addouterproduct(constview lhs, constview rhs, view buffer) {
+#ifdef _DEBUG
+	if (lhs.width() != 1 || rhs.width() != 1) {
+		throw std::invalid_argument("arguments are not vectors");
+	}
+	if (lhs.height() != buffer.height() || rhs.height() != buffer.width()) {
+		throw std::invalid_argument("buffer matrix has incompatible size");
+	}
+#endif
+
+	//each row of the buffer gets rhs scaled by one element of lhs, so rhs must be contiguous
+	basic_matrix contiguous;
+	if (!rhs.contiguous()) {
+		contiguous = basic_matrix(rhs.height(), 1);
+		copy(rhs, contiguous);
+		rhs = contiguous;
+	}
+
+	void (*kernel)(const T*, T, T*, std::size_t) = simd::active<T>().multiplyadd;
+	std::function<void(std::size_t, std::size_t)> rows = [&](std::size_t begin, std::size_t end) {
+		for (std::size_t i = begin; i != end; ++i) {
+			kernel(rhs.data(), lhs.data()[i * lhs.stride()], buffer.data() + i * buffer.stride(), buffer.width());
 		}
+	};
+	if (buffer.size() < parallelelements) {
+		rows(0, buffer.height());
+		return;
 	}
+	parallelfor(buffer.height(), std::max(elementgrain / buffer.width(), static_cast<std::size_t>(1)), rows);
 }
 
-void matrix::multiply(const matrix& lhs, num scalar, matrix& buffer) {
+template<typename T>
+void basic_matrix<T>::addouterproduct(constview lhs, sparsevector rhs, view buffer) {
 #ifdef _DEBUG
-	if (lhs.width() != buffer.width() || lhs.height() != buffer.height()) {
+	if (lhs.width() != 1) {
+		throw std::invalid_argument("arguments are not vectors");
+	}
+	if (lhs.height() != buffer.height() || rhs.size() != buffer.width()) {
 		throw std::invalid_argument("buffer matrix has incompatible size");
 	}
 #endif
 
-	matrix::size_type size = lhs.size();
-	for (matrix::size_type i = 0; i != size; ++i) {
-		buffer[i] = lhs[i] * scalar;
+	const T* values = rhs.values();
+	const size_type* indices = rhs.indices();
+	size_type nonzeros = rhs.nonzeros();
+	for (size_type i = 0; i != buffer.height(); ++i) {
+		T scale = lhs.data()[i * lhs.stride()];
+		T* row = buffer.data() + i * buffer.stride();
+		for (size_type j = 0; j != nonzeros; ++j) {
+			row[indices[j]] += scale * values[j];
+		}
 	}
 }
 
-void matrix::function(std::function<num(num)> func, const matrix& input, matrix& buffer) {
+template<typename T>
+void basic_matrix<T>::multiply(constview lhs, T scalar, view buffer) {
 #ifdef _DEBUG
-	if (buffer.height() != input.height() || buffer.width() != input.width()) {
+	if (lhs.width() != buffer.width() || lhs.height() != buffer.height()) {
 		throw std::invalid_argument("buffer matrix has incompatible size");
 	}
 #endif
-	
-	matrix::size_type size = input.size();
-	for (matrix::size_type i = 0; i != size; ++i) {
-		buffer[i] = func(input[i]);
-	}
+
+	const simd::kernels<T>& kernels = simd::active<T>();
+	rowwise(lhs, buffer, [&](const T* input, T* out, size_type size) { kernels.multiply(input, scalar, out, size); });
 }
 
-void matrix::add(const matrix& lhs, const matrix& rhs, matrix& buffer) {
+template<typename T>
+void basic_matrix<T>::function(std::function<T(T)> func, constview input, view buffer) {
+	function<const std::function<T(T)>&>(func, input, buffer);
+}
+
+template<typename T>
+void basic_matrix<T>::copy(constview input, view buffer) {
 #ifdef _DEBUG
-	if (lhs.width() != rhs.width() || lhs.height() != rhs.height()) {
-		throw std::invalid_argument("matrix dimensions do not match");
-	}
-	if (buffer.width() != lhs.width() || buffer.height() != lhs.height()) {
+	if (input.width() != buffer.width() || input.height() != buffer.height()) {
 		throw std::invalid_argument("buffer matrix has incompatible size");
 	}
 #endif
 
-	matrix::size_type size = lhs.size();
-	for (matrix::size_type i = 0; i != size; ++i) {
-		buffer[i] = lhs[i] + rhs[i];
-	}
+	rowwise(input, buffer, [](const T* begin, T* out, size_type size) { std::copy(begin, begin + size, out); });
 }
 
-void matrix::subtract(const matrix& lhs, const matrix& rhs, matrix& buffer) {
+template<typename T>
+void basic_matrix<T>::zero(view buffer) {
+	rowwise(constview(buffer), buffer, [](const T* begin, T* out, size_type size) { std::fill(out, out + size, T(0)); });
+}
+
+template<typename T>
+void basic_matrix<T>::add(constview lhs, constview rhs, view buffer) {
 #ifdef _DEBUG
 	if (lhs.width() != rhs.width() || lhs.height() != rhs.height()) {
 		throw std::invalid_argument("matrix dimensions do not match");
@@ -434,29 +570,25 @@ void matrix::subtract(const matrix& lhs, const matrix& rhs, matrix& buffer) {
 	}
 #endif
 
-	matrix::size_type size = lhs.size();
-	for (matrix::size_type i = 0; i != size; ++i) {
-		buffer[i] = lhs[i] - rhs[i];
-	}
+	rowwise(lhs, rhs, buffer, simd::active<T>().add);
 }
 
-matrix matrix::hadamard(const matrix& lhs, const matrix& rhs) {
+template<typename T>
+void basic_matrix<T>::subtract(constview lhs, constview rhs, view buffer) {
 #ifdef _DEBUG
 	if (lhs.width() != rhs.width() || lhs.height() != rhs.height()) {
 		throw std::invalid_argument("matrix dimensions do not match");
 	}
-#endif
-
-	matrix result(lhs.height(), lhs.width());
-	matrix::size_type size = lhs.size();
-	for (matrix::size_type i = 0; i != size; ++i) {
-		result[i] = lhs[i] * rhs[i];
+	if (buffer.width() != lhs.width() || buffer.height() != lhs.height()) {
+		throw std::invalid_argument("buffer matrix has incompatible size");
 	}
+#endif
 
-	return result;
+	rowwise(lhs, rhs, buffer, simd::active<T>().subtract);
 }
 
-void matrix::hadamard(const matrix& lhs, const matrix& rhs, matrix& buffer) {
+template<typename T>
+void basic_matrix<T>::hadamard(constview lhs, constview rhs, view buffer) {
 #ifdef _DEBUG
 	if (lhs.width() != rhs.width() || lhs.height() != rhs.height()) {
 		throw std::invalid_argument("matrix dimensions do not match");
@@ -466,35 +598,34 @@ void matrix::hadamard(const matrix& lhs, const matrix& rhs, matrix& buffer) {
 	}
 #endif
 
-	matrix::size_type size = lhs.size();
-	for (matrix::size_type i = 0; i != size; ++i) {
-		buffer[i] = lhs[i] * rhs[i];
-	}
+	rowwise(lhs, rhs, buffer, simd::active<T>().hadamard);
 }
 
-bool matrix::comparemax(const matrix& lhs, const matrix& rhs, matrix& buffer) {
+template<typename T>
+bool basic_matrix<T>::comparemax(constview lhs, constview rhs, view buffer) {
 #ifdef _DEBUG
 	if (lhs.height() != rhs.height() || lhs.width() != rhs.width()) {
 		throw std::invalid_argument("matrix sizes do not match");
 	}
 #endif
 
-	return lhs.max() - lhs.begin() == rhs.max() - rhs.begin();
+	return argmax(lhs) == argmax(rhs);
 }
 
-bool matrix::comparebool(const matrix& correct, const matrix& totest, matrix& buffer) {
+template<typename T>
+bool basic_matrix<T>::comparebool(constview correct, constview totest, view buffer) {
 #ifdef _DEBUG
 	if (correct.size() != 1 || totest.size() != 1) {
 		throw std::invalid_argument("arguments must be singular matricies");
 	}
-	if (correct[0] != 0 && correct[0] != 1) {
+	if (correct(0, 0) != 0 && correct(0, 0) != 1) {
 		throw std::invalid_argument("first argument must contain bool value");
 	}
 #endif
 
-	if (correct[0] == 0 && totest[0] < 0.5) {
+	if (correct(0, 0) == 0 && totest(0, 0) < 0.5) {
 		return true;
-	} else if (correct[0] == 1 && totest[0] >= 0.5) {
+	} else if (correct(0, 0) == 1 && totest(0, 0) >= 0.5) {
 		return true;
 	}
 	else {
@@ -502,7 +633,82 @@ bool matrix::comparebool(const matrix& correct, const matrix& totest, matrix& bu
 	}
 }
 
-num matrix::quadraticcost(const math::matrix& y, const math::matrix& aL) {
+template<typename T>
+void basic_matrix<T>::sigmoid(constview input, view buffer, accuracy mode) {
+#ifdef _DEBUG
+	if (buffer.height() != input.height() || buffer.width() != input.width()) {
+		throw std::invalid_argument("buffer matrix has incompatible size");
+	}
+#endif
+
+	if (mode == approximate) {
+		rowwise(input, buffer, simd::active<T>().sigmoid);
+	} else {
+		rowwise(input, buffer, [](const T* begin, T* out, size_type size) {
+			for (size_type i = 0; i != size; ++i) {
+				out[i] = math::sigmoid(begin[i]);
+			}
+		});
+	}
+}
+
+template<typename T>
+void basic_matrix<T>::sigmoidprime(constview input, view buffer, accuracy mode) {
+#ifdef _DEBUG
+	if (buffer.height() != input.height() || buffer.width() != input.width()) {
+		throw std::invalid_argument("buffer matrix has incompatible size");
+	}
+#endif
+
+	if (mode == approximate) {
+		rowwise(input, buffer, simd::active<T>().sigmoidprime);
+	} else {
+		rowwise(input, buffer, [](const T* begin, T* out, size_type size) {
+			for (size_type i = 0; i != size; ++i) {
+				out[i] = math::sigmoidprime(begin[i]);
+			}
+		});
+	}
+}
+
+template<typename T>
+void basic_matrix<T>::biasedsigmoid(constview input, constview bias, view buffer, accuracy mode) {
+#ifdef _DEBUG
+	if (input.width() != bias.width() || input.height() != bias.height()) {
+		throw std::invalid_argument("matrix dimensions do not match");
+	}
+	if (buffer.height() != input.height() || buffer.width() != input.width()) {
+		throw std::invalid_argument("buffer matrix has incompatible size");
+	}
+#endif
+
+	if (mode == approximate) {
+		rowwise(input, bias, buffer, simd::active<T>().biasedsigmoid);
+	} else {
+		rowwise(input, bias, buffer, [](const T* begin, const T* biases, T* out, size_type size) {
+			for (size_type i = 0; i != size; ++i) {
+				out[i] = math::sigmoid(begin[i] + biases[i]);
+			}
+		});
+	}
+}
+
+template<typename T>
+void basic_matrix<T>::sigmoidgradient(constview errorin, constview output, view buffer) {
+#ifdef _DEBUG
+	if (errorin.width() != output.width() || errorin.height() != output.height()) {
+		throw std::invalid_argument("matrix dimensions do not match");
+	}
+	if (buffer.height() != errorin.height() || buffer.width() != errorin.width()) {
+		throw std::invalid_argument("buffer matrix has incompatible size");
+	}
+#endif
+
+	rowwise(errorin, output, buffer, simd::active<T>().sigmoidgradient);
+}
+
+template<typename T>
+T basic_matrix<T>::quadraticcost(constview y, constview aL) {
 #ifdef _DEBUG
 	if (y.height() != aL.height()) {
 		throw std::invalid_argument("vectors are incompatible");
@@ -512,64 +718,128 @@ num matrix::quadraticcost(const math::matrix& y, const math::matrix& aL) {
 	}
 #endif
 
-	matrix::size_type size = y.size();
-	num squaresum = 0;
-	for (matrix::size_type i = 0; i != size; ++i) {
-		squaresum += std::pow(y[i] - aL[i], 2);
+	T (*squareddistance)(const T*, const T*, std::size_t) = simd::active<T>().squareddistance;
+	if (y.contiguous() && aL.contiguous()) {
+		return squareddistance(y.data(), aL.data(), y.size()) * static_cast<T>(0.5);
 	}
-
-	return squaresum * 0.5;
+	T sum = 0;
+	for (size_type i = 0; i != y.height(); ++i) {
+		sum += squareddistance(y.data() + i * y.stride(), aL.data() + i * aL.stride(), 1);
+	}
+	return sum * static_cast<T>(0.5);
 }
 
-num matrix::dotproduct(const matrix& first, const matrix& second, matrix::size_type row, matrix::size_type column) {
-	num sum = 0;
-	matrix::size_type vectorlength = first.width();
-	for (matrix::size_type k = 0; k != vectorlength; ++k) {
-		sum += first(row, k) * second(k, column);
+template<typename T>
+void basic_matrix<T>::sgdstep(view parameters, view derivatives, T learningrate, floatview copy) {
+#ifdef _DEBUG
+	if (parameters.width() != derivatives.width() || parameters.height() != derivatives.height()) {
+		throw std::invalid_argument("matrix dimensions do not match");
 	}
-	return sum;
-}
+	if (copy.size() != 0 && (parameters.width() != copy.width() || parameters.height() != copy.height())) {
+		throw std::invalid_argument("matrix dimensions do not match");
+	}
+#endif
 
-matrix::size_type matrix::height() const {
-	return this->size()/this->width();
+	const simd::kernels<T>& kernels = simd::active<T>();
+	inplace([&](T* parameters, float* copy, T* derivatives, size_type size) { kernels.sgdstep(parameters, copy, derivatives, learningrate, size); }, parameters, copy, derivatives);
 }
 
-matrix::size_type matrix::width() const {
-	return this->_width;
+template<typename T>
+void basic_matrix<T>::momentumstep(view parameters, view derivatives, view velocity, T learningrate, T momentum, floatview copy) {
+#ifdef _DEBUG
+	if (parameters.width() != derivatives.width() || parameters.height() != derivatives.height() || parameters.width() != velocity.width() || parameters.height() != velocity.height()) {
+		throw std::invalid_argument("matrix dimensions do not match");
+	}
+	if (copy.size() != 0 && (parameters.width() != copy.width() || parameters.height() != copy.height())) {
+		throw std::invalid_argument("matrix dimensions do not match");
+	}
+#endif
+
+	const simd::kernels<T>& kernels = simd::active<T>();
+	inplace([&](T* parameters, float* copy, T* derivatives, T* velocity, size_type size) { kernels.momentumstep(parameters, copy, derivatives, velocity, learningrate, momentum, size); }, parameters, copy, derivatives, velocity);
 }
 
-matrix::size_type matrix::size() const {
-	return this->_data.size();
+template<typename T>
+void basic_matrix<T>::nesterovstep(view parameters, view derivatives, view velocity, T learningrate, T momentum, floatview copy) {
+#ifdef _DEBUG
+	if (parameters.width() != derivatives.width() || parameters.height() != derivatives.height() || parameters.width() != velocity.width() || parameters.height() != velocity.height()) {
+		throw std::invalid_argument("matrix dimensions do not match");
+	}
+	if (copy.size() != 0 && (parameters.width() != copy.width() || parameters.height() != copy.height())) {
+		throw std::invalid_argument("matrix dimensions do not match");
+	}
+#endif
+
+	const simd::kernels<T>& kernels = simd::active<T>();
+	inplace([&](T* parameters, float* copy, T* derivatives, T* velocity, size_type size) { kernels.nesterovstep(parameters, copy, derivatives, velocity, learningrate, momentum, size); }, parameters, copy, derivatives, velocity);
 }
 
-std::default_random_engine default_random_engine() {
-	std::random_device rd;
-	std::default_random_engine re(rd());
-	return re;
+template<typename T>
+void basic_matrix<T>::adamstep(view parameters, view derivatives, view first, view second, T stepsize, T beta1, T beta2, T epsilon, floatview copy) {
+#ifdef _DEBUG
+	if (parameters.width() != derivatives.width() || parameters.height() != derivatives.height() || parameters.width() != first.width() || parameters.height() != first.height() || parameters.width() != second.width() || parameters.height() != second.height()) {
+		throw std::invalid_argument("matrix dimensions do not match");
+	}
+	if (copy.size() != 0 && (parameters.width() != copy.width() || parameters.height() != copy.height())) {
+		throw std::invalid_argument("matrix dimensions do not match");
+	}
+#endif
+
+	const simd::kernels<T>& kernels = simd::active<T>();
+	inplace([&](T* parameters, float* copy, T* derivatives, T* first, T* second, size_type size) { kernels.adamstep(parameters, copy, derivatives, first, second, stepsize, beta1, beta2, epsilon, size); }, parameters, copy, derivatives, first, second);
 }
 
-//TODO: remove use of global static while maintaining efficiency
-//not really a standard dist but this gives us better results for now
-num standarddist() {
-	static std::random_device rd;
-	static std::default_random_engine re(rd());
-	static std::normal_distribution<num> nd(0, 0.6);
-	return nd(re);
+//the threads each check their own part, and only ever clear the shared flag, so the order they finish in does not matter
+template<typename T>
+bool basic_matrix<T>::unscale(floatview input, view buffer, T scale) {
+#ifdef _DEBUG
+	if (input.width() != buffer.width() || input.height() != buffer.height()) {
+		throw std::invalid_argument("matrix dimensions do not match");
+	}
+#endif
+
+	bool (*unscale)(float*, T*, T, std::size_t) = simd::active<T>().unscale;
+	float* inputptr = input.data();
+	T* bufferptr = buffer.data();
+	if (input.contiguous() && buffer.contiguous()) {
+		if (input.size() < parallelelements) {
+			return unscale(inputptr, bufferptr, scale, input.size());
+		}
+		std::atomic<bool> finite(true);
+		parallelfor(input.size(), elementgrain, [&](std::size_t begin, std::size_t end) {
+			if (!unscale(inputptr + begin, bufferptr + begin, scale, end - begin)) {
+				finite.store(false, std::memory_order_relaxed);
+			}
+		});
+		return finite.load(std::memory_order_relaxed);
+	}
+
+	bool finite = true;
+	for (size_type i = 0; i != input.height(); ++i) {
+		finite = unscale(inputptr + i * input.stride(), bufferptr + i * buffer.stride(), scale, input.width()) && finite;
+	}
+	return finite;
 }
 
-bool bernoullidist() {
-	static std::random_device rd;
-	static std::default_random_engine re(rd());
-	static std::bernoulli_distribution bd(0.5);
-	return bd(re);
+template<typename T>
+typename basic_matrix<T>::size_type basic_matrix<T>::height() const {
+	return this->size()/this->width();
 }
 
-num sigmoid(num input) {
-	return (1/(1 + std::exp(-input)));
+template<typename T>
+typename basic_matrix<T>::size_type basic_matrix<T>::width() const {
+	return this->_width;
 }
 
-num sigmoidprime(num input) {
-	return sigmoid(input) * (1 - sigmoid(input));
+template<typename T>
+typename basic_matrix<T>::size_type basic_matrix<T>::size() const {
+	return this->_data.size();
 }
 
+//the library is built for both single and double precision
+template class basic_matrix<float>;
+template class basic_matrix<double>;
+template std::ostream& operator<<(std::ostream& cout, const basic_matrix<float>& toprint);
+template std::ostream& operator<<(std::ostream& cout, const basic_matrix<double>& toprint);
+
 }
\ No newline at end of file
@@ -20,56 +20,87 @@
 #include <functional>
 #include <random>
 #include <utility>
+#include <cmath>
+#include <stdexcept>
+
+#include "allocator.h"
+#include "expression.h"
+#include "matrixview.h"
+#include "sparse.h"
+#include "random.h"
 
 namespace math {
 
-//we typedef double num for flexibility
-//in future, if we want to port to GPU, float instead of double will give us better performance
+//num is the default scalar type used throughout the library
+//the matrix class and the layers are templated on their scalar type, and are built for both float and double
+//float halves the memory bandwidth and doubles the simd width, at the cost of precision
 typedef double num;
 
+//accuracy of the sigmoid kernels
+//exact uses std::exp, and matches math::sigmoid bit-for-bit
+//approximate uses a vectorized polynomial exp, and is several times faster
+//the absolute error of both sigmoid and sigmoidprime is below 5e-8 for double, and 1e-7 for float
+enum accuracy {
+	exact,
+	approximate,
+};
+
 //row-major matrix class - interface of std::vector
 //this class uses zero-indexing unless otherwise stated
-class matrix {
+//+, -, scalar * and hadamard build lazy expressions (see expression.h), which convert back into a matrix
+template<typename T>
+class basic_matrix : public expression<basic_matrix<T>> {
 public:
-	typedef std::vector<num>::size_type size_type;
-	typedef std::vector<num>::iterator iterator;
-	typedef std::vector<num>::const_iterator const_iterator;
+	typedef T value_type;
+	//storage is 64 byte aligned and drawn from math::pool
+	typedef std::vector<T, alignedallocator<T>> container_type;
+	typedef typename container_type::size_type size_type;
+	typedef typename container_type::iterator iterator;
+	typedef typename container_type::const_iterator const_iterator;
+	typedef basic_matrixview<T> view;
+	typedef basic_matrixview<const T> constview;
+	//single precision view, which mixed precision training keeps a copy of the parameters in
+	typedef basic_matrixview<float> floatview;
+	typedef basic_sparsevector<T> sparsevector;
 
 	//default constructor
-	matrix();
+	basic_matrix();
 	//initializes a matrix with specified dimensions, all elements being set to 0
-	matrix(size_type height, size_type width);
+	basic_matrix(size_type height, size_type width);
 	//initializes a matrix with specified dimensions, and fills this matrix using the given function
-	matrix(size_type height, size_type width, std::function<num()> func);
+	basic_matrix(size_type height, size_type width, std::function<T()> func);
 	//initializes a matrix given a data vector and a width
-	matrix(const std::vector<num>& data, size_type width);
+	basic_matrix(const std::vector<T>& data, size_type width);
 	//initializes a matrix given a height, width, and initializer list
-	matrix(size_type height, size_type width, std::initializer_list<num> initializerlist);
+	basic_matrix(size_type height, size_type width, std::initializer_list<T> initializerlist);
+	//initializes a matrix by evaluating an expression
+	template<typename E>
+	basic_matrix(const expression<E>& expr);
+
+	//evaluates an expression into this matrix, resizing it if needs be
+	//the expression may use this matrix, as long as it has the same size
+	template<typename E>
+	basic_matrix& operator=(const expression<E>& expr);
 
 	//initializes a matrix such that all elements are zero except for one specified element, set to one
-	static matrix onehotmatrix(size_type height, size_type width, size_type row, size_type column);
+	static basic_matrix onehotmatrix(size_type height, size_type width, size_type row, size_type column);
 
-	//prints the matrix to the output stream
-	friend std::ostream& operator<<(std::ostream& cout, const matrix& toprint);
 	//returns a const reference to the specified element of the matrix
-	const num& operator()(size_type row, size_type column) const;
+	const T& operator()(size_type row, size_type column) const;
 	//returns a reference to the specified element of the matrix
-	num& operator()(size_type row, size_type column);
+	T& operator()(size_type row, size_type column);
 	//returns a const reference to the specified data element
-	const num& operator[](size_type element) const;
+	const T& operator[](size_type element) const;
 	//returns a reference to the specified data element
-	num& operator[](size_type element);
+	T& operator[](size_type element);
 	//multiplies two matricies together and returns the result
-	matrix operator*(const matrix& rhs) const;
-	//multiplies the matrix by a scalar value
-	matrix operator*(math::num scalar) const;
-	friend matrix operator*(num scalar, const matrix& rhs);
+	basic_matrix operator*(const basic_matrix& rhs) const;
 	//applies a function to every element in the matrix
-	matrix operator()(std::function<num (num)> func) const;
-	//adds two matricies together and returns the result
-	matrix operator+(const matrix& rhs) const;
-	//subtracts two matricies and returns the result
-	matrix operator-(const matrix& rhs) const;
+	//any callable is accepted, and is inlined into the loop
+	template<typename F>
+	basic_matrix operator()(F func) const;
+	//the std::function overload is kept for compatibility, but costs an indirect call per element
+	basic_matrix operator()(std::function<T(T)> func) const;
 
 	//returns a const iterator to the max element in the matrix
 	const_iterator max() const;
@@ -83,42 +114,100 @@ public:
 	const_iterator end() const;
 	//returns a iterator to one past the last element in the matrix
 	iterator end();
+	//returns a const pointer to the underlying row-major array
+	const T* data() const;
+	//returns a pointer to the underlying row-major array
+	T* data();
+	//sets every element to zero, without reallocating
+	void zero();
+	//returns the specified data element without bounds checking, for use by expressions
+	T element(size_type i) const { return this->_data[i]; }
+	//copies the matrix to a contiguous array, for use by expressions
+	void evaluate(T* out) const;
+
+	//the static functions below take views, so they work on any matrix, block or external buffer without copying
+	//a matrix converts to a view of itself
 
 	//multiplies two matricies together and writes the result to a buffer
-	static void multiply(const matrix& lhs, const matrix& rhs, matrix& buffer);
+	static void multiply(constview lhs, constview rhs, view buffer);
+	//multiplies a matrix by a sparse column vector and writes the result to a buffer
+	//only the columns of lhs that meet a nonzero element are read
+	static void multiply(constview lhs, sparsevector rhs, view buffer);
 
-	//TODO: test other methods of transposed multiply for efficiency
 	//multiplies two matricies together, with the first matrix viewed as transposed
-	static matrix lefttransposedmultiply(const matrix& lhs, const matrix& rhs);
+	static basic_matrix lefttransposedmultiply(constview lhs, constview rhs);
 	//multiplies two matricies together, with the first matrix viewed as transposed. result is written to a buffer
-	static void lefttransposedmultiply(const matrix& lhs, const matrix& rhs, matrix& buffer);
+	static void lefttransposedmultiply(constview lhs, constview rhs, view buffer);
+	//multiplies two matricies together, with the first matrix viewed as transposed, and adds the result to a buffer
+	//each element of the buffer has the products added to it in order along the rows of lhs and rhs
+	static void lefttransposedmultiplyadd(constview lhs, constview rhs, view buffer);
 	//multiplies two matricies together, with the second matrix viewed as transposed
-	static matrix righttransposedmultiply(const matrix& lhs, const matrix& rhs);
+	static basic_matrix righttransposedmultiply(constview lhs, constview rhs);
 	//multiplies two matricies together, with the second matrix viewed as transposed. result is written to a buffer
-	static void righttransposedmultiply(const matrix& lhs, const matrix& rhs, matrix& buffer);
+	static void righttransposedmultiply(constview lhs, constview rhs, view buffer);
 
 	//multiplies a matrix by a scalar and writes the result to a buffer
-	static void multiply(const matrix& lhs, num scalar, matrix& buffer);
+	static void multiply(constview lhs, T scalar, view buffer);
+	//adds the outer product of two column vectors, lhs * rhs transposed, to a buffer
+	//this is the same as a right transposed multiply followed by an add, without the temporary matrix
+	static void addouterproduct(constview lhs, constview rhs, view buffer);
+	//adds the outer product of a column vector and a sparse column vector to a buffer
+	//only the columns of the buffer that meet a nonzero element of rhs are touched
+	static void addouterproduct(constview lhs, sparsevector rhs, view buffer);
 	//applies a function to every element in a matrix and writes the result to a buffer
-	static void function(std::function<num(num)> func, const matrix& input, matrix& buffer);
+	//any callable is accepted, and is inlined into the loop
+	template<typename F>
+	static void function(F func, constview input, view buffer);
+	//the std::function overload is kept for compatibility, but costs an indirect call per element
+	static void function(std::function<T(T)> func, constview input, view buffer);
+	//copies a matrix into a buffer
+	static void copy(constview input, view buffer);
+	//sets every element of a buffer to zero
+	static void zero(view buffer);
 	//adds two matricies together and writes the result to a buffer
-	static void add(const matrix& lhs, const matrix& rhs, matrix& buffer);
+	static void add(constview lhs, constview rhs, view buffer);
 	//subtracts two matricies and writes the result to a buffer
-	static void subtract(const matrix& lhs, const matrix& rhs, matrix& buffer);
+	static void subtract(constview lhs, constview rhs, view buffer);
 	//finds the hadamard product of two matricies
-	static matrix hadamard(const matrix& lhs, const matrix& rhs);
+	template<typename L, typename R>
+	static binaryexpression<L, R, multiplication> hadamard(const expression<L>& lhs, const expression<R>& rhs);
 	//finds the hadamard product of two matricies and writes the result to a buffer
-	static void hadamard(const matrix& lhs, const matrix& rhs, matrix& buffer);
+	static void hadamard(constview lhs, constview rhs, view buffer);
 	//returns true if the max element in lhs has the same position as the max element in rhs
 	//doesnt do anything with buffer
-	static bool comparemax(const matrix& lhs, const matrix& rhs, matrix& buffer);
-	static bool comparemax(const matrix& lhs, const matrix& rhs) { matrix m; return comparemax(lhs, rhs, m);}
+	static bool comparemax(constview lhs, constview rhs, view buffer);
+	static bool comparemax(constview lhs, constview rhs) { return comparemax(lhs, rhs, view());}
 	//takes single element matricies for bool comparision
 	//first argument must be either 0 or 1
-	static bool comparebool(const matrix& correct, const matrix& totest, matrix& buffer);
-	static bool comparebool(const matrix& correct, const matrix& totest) {matrix m; return comparebool(correct, totest, m);};
+	static bool comparebool(constview correct, constview totest, view buffer);
+	static bool comparebool(constview correct, constview totest) { return comparebool(correct, totest, view());};
+	//applies the sigmoid function to every element in a matrix and writes the result to a buffer
+	static void sigmoid(constview input, view buffer, accuracy mode = exact);
+	//applies the derivative of the sigmoid function to every element in a matrix and writes the result to a buffer
+	static void sigmoidprime(constview input, view buffer, accuracy mode = exact);
+	//adds a bias to a matrix and applies the sigmoid function in a single pass, writing the result to a buffer
+	//matches add followed by sigmoid exactly
+	static void biasedsigmoid(constview input, constview bias, view buffer, accuracy mode = exact);
+	//multiplies an error by the derivative of the sigmoid function, given the output of the sigmoid, and writes the result to a buffer
+	//matches hadamard of the error with sigmoidprime of the sigmoid's input exactly, for either accuracy
+	static void sigmoidgradient(constview errorin, constview output, view buffer);
 	//finds the quadratic cost of two vectors
-	static num quadraticcost(const math::matrix& y, const math::matrix& aL);
+	static T quadraticcost(constview y, constview aL);
+	//the optimizer steps below update parameters from their derivatives, then set the derivatives to zero,
+	//reading and writing every buffer once. all the buffers must have the same size
+	//if copy is not empty, the new parameters are also rounded to single precision and written to it, in the same pass
+	//adds the derivatives times -learningrate to the parameters, which matches multiply followed by add exactly
+	static void sgdstep(view parameters, view derivatives, T learningrate, floatview copy = floatview());
+	//scales the velocity by momentum and adds the derivatives times -learningrate, then adds the velocity to the parameters
+	static void momentumstep(view parameters, view derivatives, view velocity, T learningrate, T momentum, floatview copy = floatview());
+	//updates the velocity as momentumstep does, then adds the velocity times momentum and the derivatives times -learningrate to the parameters
+	static void nesterovstep(view parameters, view derivatives, view velocity, T learningrate, T momentum, floatview copy = floatview());
+	//updates the moving averages of the derivatives and their squares,
+	//then adds first * -stepsize / (sqrt(second) + epsilon) to the parameters
+	static void adamstep(view parameters, view derivatives, view first, view second, T stepsize, T beta1, T beta2, T epsilon, floatview copy = floatview());
+	//multiplies a single precision matrix by a scale and writes the result to a buffer, then sets the input to zero, in a single pass
+	//returns false if any element of the buffer is not finite
+	static bool unscale(floatview input, view buffer, T scale);
 
 	//returns the height of the matrix
 	size_type height() const;
@@ -128,25 +217,127 @@ public:
 	size_type size() const;
 
 private:
-	std::vector<num> _data;
+	container_type _data;
 	size_type _width;
-
-	//seperate dotproduct function for matrix multiplication
-	static num dotproduct(const matrix& first, const matrix& second, matrix::size_type row, matrix::size_type column);
 };
 
-//returns a randomly initialized instance of the default random engine
+typedef basic_matrix<num> matrix;
+typedef basic_matrixview<num> matrixview;
+typedef basic_matrixview<const num> constmatrixview;
+typedef basic_sparsevector<num> sparsevector;
+typedef basic_sparsematrix<num> sparsematrix;
+
+//prints the matrix to the output stream
+template<typename T>
+std::ostream& operator<<(std::ostream& cout, const basic_matrix<T>& toprint);
+//prints the result of an expression to the output stream
+template<typename E>
+std::ostream& operator<<(std::ostream& cout, const expression<E>& toprint);
+//multiplies two expressions together as matricies and returns the result
+//the operands are evaluated first, as a matrix product reads each element many times
+template<typename L, typename R>
+basic_matrix<typename L::value_type> operator*(const expression<L>& lhs, const expression<R>& rhs);
+
+//these draw from math::nextseed, so they repeat after math::seed is called (see random.h)
+//returns an instance of the default random engine, seeded from the library seed
 std::default_random_engine default_random_engine();
 //returns a random num from the standard distribution (mean 0, SD 1)
 //(NOT ACTUALLY A STANDARD DISTRIBUTION RIGHT NOW)
+//each thread has its own generator, so this is threadsafe
 num standarddist();
 //returns a 50/50 bool
+//each thread has its own generator, so this is threadsafe
 bool bernoullidist();
 //returns the sigmoid function of a number
-num sigmoid(num input);
+//defined inline so it can be inlined into matrix::function
+template<typename T>
+inline T sigmoid(T input) {
+	return (1/(1 + std::exp(-input)));
+}
+
 //returns the derivative of the sigmoid function
-//if we have performance issues, we could change the form of the equation
-num sigmoidprime(num input);
+//the sigmoid is only evaluated once, as sigmoid'(x) = sigmoid(x) * (1 - sigmoid(x))
+template<typename T>
+inline T sigmoidprime(T input) {
+	T value = sigmoid(input);
+	return value * (1 - value);
+}
+
+//template definitions
+
+template<typename T>
+template<typename E>
+basic_matrix<T>::basic_matrix(const expression<E>& expr) : _data(expr.self().size()), _width(expr.self().width()) {
+	static_assert(std::is_same<T, typename E::value_type>::value, "expression has a different scalar type");
+	expr.self().evaluate(this->data());
+}
+
+template<typename T>
+template<typename E>
+basic_matrix<T>& basic_matrix<T>::operator=(const expression<E>& expr) {
+	static_assert(std::is_same<T, typename E::value_type>::value, "expression has a different scalar type");
+	const E& value = expr.self();
+	if (this->size() != value.size() || this->_width != value.width()) {
+		this->_data.resize(value.size());
+		this->_width = value.width();
+	}
+	value.evaluate(this->data());
+
+	return *this;
+}
+
+template<typename T>
+template<typename L, typename R>
+binaryexpression<L, R, multiplication> basic_matrix<T>::hadamard(const expression<L>& lhs, const expression<R>& rhs) {
+	return binaryexpression<L, R, multiplication>(lhs.self(), rhs.self());
+}
+
+template<typename E>
+std::ostream& operator<<(std::ostream& cout, const expression<E>& toprint) {
+	return cout << basic_matrix<typename E::value_type>(toprint);
+}
+
+template<typename L, typename R>
+basic_matrix<typename L::value_type> operator*(const expression<L>& lhs, const expression<R>& rhs) {
+	basic_matrix<typename L::value_type> left(lhs);
+	basic_matrix<typename R::value_type> right(rhs);
+	return left * right;
+}
+
+template<typename T>
+template<typename F>
+basic_matrix<T> basic_matrix<T>::operator()(F func) const {
+	basic_matrix result(this->height(), this->width());
+	function(func, *this, result);
+
+	return result;
+}
+
+//raw pointers are used so the loop can be vectorized, even when _DEBUG bounds checking is on
+//contiguous views are walked as a single row
+template<typename T>
+template<typename F>
+void basic_matrix<T>::function(F func, constview input, view buffer) {
+#ifdef _DEBUG
+	if (buffer.height() != input.height() || buffer.width() != input.width()) {
+		throw std::invalid_argument("buffer matrix has incompatible size");
+	}
+#endif
+
+	size_type height = input.height();
+	size_type width = input.width();
+	if (input.contiguous() && buffer.contiguous()) {
+		width = input.size();
+		height = width == 0 ? 0 : 1;
+	}
+	for (size_type i = 0; i != height; ++i) {
+		const T* inputptr = input.data() + i * input.stride();
+		T* bufferptr = buffer.data() + i * buffer.stride();
+		for (size_type j = 0; j != width; ++j) {
+			bufferptr[j] = func(inputptr[j]);
+		}
+	}
+}
 
 }
 
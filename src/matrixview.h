@@ -0,0 +1,133 @@
+//Copyright 2017 Jakob Wyatt
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http ://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#ifndef GUARD_MATRIXVIEW_H
+#define GUARD_MATRIXVIEW_H
+
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <algorithm>
+
+#include "expression.h"
+
+namespace math {
+
+template<typename T>
+class basic_matrix;
+
+//non-owning, row-major view of a matrix held somewhere else
+//consecutive rows start stride elements apart, so a view can cover a block of a larger matrix
+//T may be const qualified, giving a read-only view
+//a view is only valid while the memory it points to is, and copying a view never copies the elements
+//this class uses zero-indexing unless otherwise stated
+template<typename T>
+class basic_matrixview : public expression<basic_matrixview<T>> {
+public:
+	typedef typename std::remove_const<T>::type value_type;
+	typedef std::size_t size_type;
+	typedef typename std::conditional<std::is_const<T>::value, const basic_matrix<value_type>, basic_matrix<value_type>>::type matrix_type;
+
+	//initializes an empty view
+	basic_matrixview() : _data(nullptr), _height(0), _width(0), _stride(0) {
+
+	}
+	//initializes a view of contiguous row-major memory
+	basic_matrixview(T* data, size_type height, size_type width) : _data(data), _height(height), _width(width), _stride(width) {
+
+	}
+	//initializes a view of row-major memory, where consecutive rows are stride elements apart
+	basic_matrixview(T* data, size_type height, size_type width, size_type stride) : _data(data), _height(height), _width(width), _stride(stride) {
+#ifdef _DEBUG
+		if (stride < width) {
+			throw std::invalid_argument("stride is smaller than width");
+		}
+#endif
+	}
+	//initializes a view of a whole matrix
+	basic_matrixview(matrix_type& source) : _data(source.data()), _height(source.width() == 0 ? 0 : source.height()), _width(source.width()), _stride(source.width()) {
+
+	}
+	//copying a view copies where it points, never the elements
+	basic_matrixview(const basic_matrixview&) = default;
+	basic_matrixview& operator=(const basic_matrixview&) = default;
+	//a read-only view can be made from any view of the same scalar type
+	template<typename U = T, typename = typename std::enable_if<std::is_const<U>::value>::type>
+	basic_matrixview(const basic_matrixview<value_type>& view) : _data(view.data()), _height(view.height()), _width(view.width()), _stride(view.stride()) {
+
+	}
+
+	//returns a reference to the specified element of the view
+	T& operator()(size_type row, size_type column) const {
+#ifdef _DEBUG
+		if (row >= this->_height || column >= this->_width) {
+			throw std::out_of_range("out of range");
+		}
+#endif
+		return this->_data[row * this->_stride + column];
+	}
+
+	//returns a view of a single row
+	basic_matrixview row(size_type row) const {
+		return this->block(row, 0, 1, this->_width);
+	}
+	//returns a view of a height by width block, with its top left corner at the specified element
+	basic_matrixview block(size_type row, size_type column, size_type height, size_type width) const {
+#ifdef _DEBUG
+		if (row + height > this->_height || column + width > this->_width) {
+			throw std::out_of_range("block is out of range");
+		}
+#endif
+		return basic_matrixview(this->_data + row * this->_stride + column, height, width, this->_stride);
+	}
+
+	//returns true if the rows of the view follow each other in memory
+	bool contiguous() const { return this->_stride == this->_width || this->_height <= 1; }
+
+	//returns a pointer to the first element of the view
+	T* data() const { return this->_data; }
+	//returns the height of the view
+	size_type height() const { return this->_height; }
+	//returns the width of the view
+	size_type width() const { return this->_width; }
+	//returns the size of the view
+	size_type size() const { return this->_height * this->_width; }
+	//returns the distance between the starts of consecutive rows
+	size_type stride() const { return this->_stride; }
+
+	//returns the specified element, counting along the rows, without bounds checking, for use by expressions
+	value_type element(size_type i) const {
+		if (this->contiguous()) {
+			return this->_data[i];
+		}
+		return this->_data[(i / this->_width) * this->_stride + i % this->_width];
+	}
+	//copies the view to a contiguous array, for use by expressions
+	void evaluate(value_type* out) const {
+		for (size_type i = 0; i != this->_height; ++i) {
+			const T* row = this->_data + i * this->_stride;
+			std::copy(row, row + this->_width, out + i * this->_width);
+		}
+	}
+
+private:
+	T* _data;
+	size_type _height;
+	size_type _width;
+	size_type _stride;
+};
+
+}
+
+#endif
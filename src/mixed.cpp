@@ -0,0 +1,203 @@
+//Copyright 2017 Jakob Wyatt
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http ://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#include "mixed.h"
+
+#include <stdexcept>
+#include <vector>
+#include <memory>
+#include <cmath>
+#include <algorithm>
+
+#include "math.h"
+#include "arena.h"
+#include "optimizer.h"
+#include "nn.h"
+
+namespace nn {
+
+namespace {
+
+//rounds a view into a single precision view of the same shape
+template<typename T>
+void narrow(math::basic_matrixview<const T> input, math::basic_matrixview<float> output) {
+#ifdef _DEBUG
+	if (input.width() != output.width() || input.height() != output.height()) {
+		throw std::invalid_argument("buffer matrix has incompatible size");
+	}
+#endif
+
+	for (std::size_t i = 0; i != input.height(); ++i) {
+		const T* in = input.data() + i * input.stride();
+		float* out = output.data() + i * output.stride();
+		for (std::size_t j = 0; j != input.width(); ++j) {
+			out[j] = static_cast<float>(in[j]);
+		}
+	}
+}
+
+}
+
+//the copy is filled by synchronize, so its layers are built without drawing random numbers
+template<typename T>
+basic_mixedtrainer<T>::basic_mixedtrainer(nn& network, float lossscale, size_type growthinterval) : _master(network), _compute(copy(network)), _lossscale(lossscale),
+	_growthinterval(growthinterval), _growth(0), _skipped(0) {
+	//pair every parameter with its copy, and with its minibatch buffer, which the layers list in the same order as their parameters
+	size_type nnsize = network.size();
+	for (size_type i = 0; i != nnsize; ++i) {
+		basic_layer<T>* master = this->_master._data[i].get();
+		basic_layer<float>* compute = this->_compute._data[i].get();
+		if (basic_weights<T>* weights = dynamic_cast<basic_weights<T>*>(master)) {
+			this->_parameters.push_back({ &weights->_data, &static_cast<basic_weights<float>*>(compute)->_data, i, 0 });
+		} else if (basic_biases<T>* biases = dynamic_cast<basic_biases<T>*>(master)) {
+			this->_parameters.push_back({ &biases->_data, &static_cast<basic_biases<float>*>(compute)->_data, i, 0 });
+		} else if (basic_dense<T>* dense = dynamic_cast<basic_dense<T>*>(master)) {
+			this->_parameters.push_back({ &dense->_weights, &static_cast<basic_dense<float>*>(compute)->_weights, i, 0 });
+			this->_parameters.push_back({ &dense->_biases, &static_cast<basic_dense<float>*>(compute)->_biases, i, 1 });
+		}
+	}
+	this->synchronize();
+
+	//the derivatives live for the whole of training, so none of them share memory
+	std::vector<std::vector<buffershape>> shapes = this->_master.minibatchshapes();
+	std::vector<typename basic_arena<T>::handle> handles;
+	for (const std::vector<buffershape>& layer : shapes) {
+		handles.push_back(this->_memory.reserve(layer, 0, 0));
+	}
+	this->_memory.allocate();
+	for (size_type i = 0; i != nnsize; ++i) {
+		this->_derivatives.push_back(this->_memory.group(handles[i], shapes[i].size()));
+	}
+}
+
+template<typename T>
+void basic_mixedtrainer<T>::train(const data& learningdata, T learningrate, typename data::size_type batchsize, parallelism mode, size_type checkpoint) {
+	basic_sgd<T> optimizer(learningrate);
+	this->train(learningdata, optimizer, batchsize, mode, checkpoint);
+}
+
+template<typename T>
+void basic_mixedtrainer<T>::train(const data& learningdata, basic_optimizer<T>& optimizer, typename data::size_type batchsize, parallelism mode, size_type checkpoint) {
+#ifdef _DEBUG
+	size_type nnsize = this->_compute.size();
+	if (this->_compute[0].inputheight() != learningdata.inputheight() || this->_compute[0].inputwidth() != learningdata.inputwidth()) {
+		throw std::invalid_argument("input data is incompatible");
+	}
+	if (this->_compute[nnsize - 1].outputheight() != learningdata.outputheight() || this->_compute[nnsize - 1].outputwidth() != learningdata.outputwidth()) {
+		throw std::invalid_argument("output data is incompatible");
+	}
+#endif
+	//an update can be skipped, which asynchronous training has no way to do, so this is checked in every build
+	if (mode == asynchronous) {
+		throw std::invalid_argument("asynchronous training is not supported");
+	}
+
+	const std::vector<basic_buffers<T>>& moments = optimizer.bind(this->_master.minibatchshapes());
+	this->_compute.trainsynchronous(learningdata, batchsize, mode, checkpoint, this->_lossscale, [&](const std::vector<basic_buffers<float>>& minibatch) {
+		return this->update(minibatch, optimizer, moments);
+	});
+}
+
+template<typename T>
+float basic_mixedtrainer<T>::lossscale() const {
+	return this->_lossscale;
+}
+
+template<typename T>
+typename basic_mixedtrainer<T>::size_type basic_mixedtrainer<T>::skipped() const {
+	return this->_skipped;
+}
+
+template<typename T>
+const typename basic_mixedtrainer<T>::computenn& basic_mixedtrainer<T>::compute() const {
+	return this->_compute;
+}
+
+template<typename T>
+std::vector<std::unique_ptr<basic_layer<float>>> basic_mixedtrainer<T>::copy(const nn& network) {
+	std::vector<std::unique_ptr<basic_layer<float>>> result;
+	size_type nnsize = network.size();
+	for (size_type i = 0; i != nnsize; ++i) {
+		const basic_layer<T>* layer = network._data[i].get();
+		if (const basic_weights<T>* weights = dynamic_cast<const basic_weights<T>*>(layer)) {
+			result.push_back(std::unique_ptr<basic_layer<float>>(new basic_weights<float>(weights->inputheight(), weights->outputheight(), []() { return 0.0f; })));
+		} else if (const basic_biases<T>* biases = dynamic_cast<const basic_biases<T>*>(layer)) {
+			result.push_back(std::unique_ptr<basic_layer<float>>(new basic_biases<float>(biases->inputheight(), biases->inputwidth())));
+		} else if (const basic_sigmoid<T>* sigmoid = dynamic_cast<const basic_sigmoid<T>*>(layer)) {
+			result.push_back(std::unique_ptr<basic_layer<float>>(new basic_sigmoid<float>(sigmoid->inputheight(), sigmoid->inputwidth(), sigmoid->_mode)));
+		} else if (const basic_dense<T>* dense = dynamic_cast<const basic_dense<T>*>(layer)) {
+			result.push_back(std::unique_ptr<basic_layer<float>>(new basic_dense<float>(dense->inputheight(), dense->outputheight(), []() { return 0.0f; }, dense->_mode)));
+		} else {
+			throw std::invalid_argument("layer has no single precision copy");
+		}
+	}
+	return result;
+}
+
+template<typename T>
+void basic_mixedtrainer<T>::synchronize() {
+	for (const parameter& current : this->_parameters) {
+		narrow<T>(*current.master, *current.copy);
+	}
+}
+
+//the derivatives are divided by the loss scale on the way to full precision, which is exact, as the scale is a power of two
+//the same pass checks that they are finite, and clears the minibatch buffers for the next minibatch
+template<typename T>
+float basic_mixedtrainer<T>::update(const std::vector<basic_buffers<float>>& minibatch, basic_optimizer<T>& optimizer, const std::vector<basic_buffers<T>>& moments) {
+	size_type nnsize = minibatch.size();
+	T unscale = 1 / static_cast<T>(this->_lossscale);
+	bool finite = true;
+	for (size_type i = 0; i != nnsize; ++i) {
+		for (size_type j = 0; j != minibatch[i].size(); ++j) {
+			finite = math::basic_matrix<T>::unscale(minibatch[i][j], this->_derivatives[i][j], unscale) && finite;
+		}
+	}
+
+	//an overflow means the scale is too large, so the update is dropped and the next minibatch uses half the scale
+	//the scale is never halved below one, as then the derivatives overflow single precision without it
+	if (!finite) {
+		for (size_type i = 0; i != nnsize; ++i) {
+			for (size_type j = 0; j != this->_derivatives[i].size(); ++j) {
+				math::basic_matrix<T>::zero(this->_derivatives[i][j]);
+			}
+		}
+		++this->_skipped;
+		this->_growth = 0;
+		this->_lossscale = std::max(this->_lossscale / 2, 1.0f);
+		return this->_lossscale;
+	}
+
+	//the parameters are stepped here rather than by their layers, so each step can round them into the copy as it goes,
+	//which gives the same updates as nn::update without another pass over the parameters
+	optimizer.advance();
+	size_type count = optimizer.moments();
+	for (const parameter& current : this->_parameters) {
+		optimizer.step(*current.master, this->_derivatives[current.layer][current.buffer], moments[current.layer].slice(current.buffer * count, count), *current.copy);
+	}
+	//the scale is never doubled past the largest float, as an infinite scale could never be halved again
+	if (++this->_growth == this->_growthinterval) {
+		this->_growth = 0;
+		if (std::isfinite(this->_lossscale * 2)) {
+			this->_lossscale *= 2;
+		}
+	}
+	return this->_lossscale;
+}
+
+//the library is built for both single and double precision master parameters
+template class basic_mixedtrainer<float>;
+template class basic_mixedtrainer<double>;
+
+}
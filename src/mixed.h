@@ -0,0 +1,101 @@
+//Copyright 2017 Jakob Wyatt
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http ://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#ifndef GUARD_MIXED_H
+#define GUARD_MIXED_H
+
+#include <cstddef>
+#include <vector>
+#include <memory>
+
+#include "math.h"
+#include "arena.h"
+#include "optimizer.h"
+#include "nn.h"
+
+//mixed precision training
+//the feedforward and backprop run in single precision on a copy of the neuralnet, which halves the memory they move,
+//while the updates are applied to the neuralnet itself, which keeps the master parameters at full precision
+//the error of the output is multiplied by a loss scale before backprop, so small derivatives do not underflow in single precision,
+//and the derivatives are divided by it again before the update
+namespace nn {
+
+//trains a neuralnet through a single precision copy of it
+//the loss scale is dynamic: an update whose derivatives overflow is skipped and the scale is halved,
+//and the scale is doubled after a number of updates in a row without an overflow
+//the neuralnet must only hold weights, biases, sigmoid and dense layers, must outlive the trainer,
+//and must not be fused or trained elsewhere while the trainer is in use
+template<typename T>
+class basic_mixedtrainer {
+public:
+	typedef basic_nn<T> nn;
+	typedef basic_nn<float> computenn;
+	typedef basic_data<float> data;
+	typedef typename nn::size_type size_type;
+
+	//prepares to train a neuralnet, given the starting loss scale and the number of updates without an overflow before it is doubled
+	//the starting scale should be a power of two, so scaling never rounds
+	basic_mixedtrainer(nn& network, float lossscale = 65536, size_type growthinterval = 2000);
+
+	//trains the neuralnet on single precision data, see nn::train
+	//asynchronous training is not supported, as an update can be skipped, and throws in every build
+	void train(const data& learningdata, T learningrate, typename data::size_type batchsize, parallelism mode = ordered, size_type checkpoint = 0);
+	//trains the neuralnet on single precision data, with the updates of the master parameters made by an optimizer
+	void train(const data& learningdata, basic_optimizer<T>& optimizer, typename data::size_type batchsize, parallelism mode = ordered, size_type checkpoint = 0);
+
+	//returns the current loss scale
+	float lossscale() const;
+	//returns the number of updates skipped because the derivatives overflowed
+	size_type skipped() const;
+	//returns the single precision copy of the neuralnet, which holds the master parameters rounded to single precision
+	const computenn& compute() const;
+
+private:
+	nn& _master;
+	computenn _compute;
+	float _lossscale;
+	size_type _growthinterval;
+	size_type _growth;
+	size_type _skipped;
+
+	//a parameter of the neuralnet, its copy, and the layer and minibatch buffer its derivatives are in
+	struct parameter {
+		math::basic_matrix<T>* master;
+		math::basic_matrix<float>* copy;
+		size_type layer;
+		size_type buffer;
+	};
+
+	//every parameter of the neuralnet
+	std::vector<parameter> _parameters;
+	//the derivatives of the master parameters, divided by the loss scale, with the same layout as the minibatch buffers
+	basic_arena<T> _memory;
+	std::vector<basic_buffers<T>> _derivatives;
+
+	//builds single precision copies of the layers of a neuralnet, without their parameters
+	//throws if a layer has no single precision copy
+	static std::vector<std::unique_ptr<basic_layer<float>>> copy(const nn& network);
+	//rounds the master parameters into the copy
+	void synchronize();
+	//checks the derivatives of a minibatch, and applies them to the master parameters if none of them overflowed,
+	//rounding the new parameters into the copy as they are stepped
+	//returns the loss scale of the next minibatch
+	float update(const std::vector<basic_buffers<float>>& minibatch, basic_optimizer<T>& optimizer, const std::vector<basic_buffers<T>>& moments);
+};
+
+typedef basic_mixedtrainer<math::num> mixedtrainer;
+
+}
+
+#endif
@@ -22,29 +22,51 @@
 #include <memory>
 #include <functional>
 #include <algorithm>
+#include <numeric>
+#include <atomic>
 
 #include "math.h"
+#include "threads.h"
+#include "session.h"
 
 //we will only error-check if the project is in debug mode
 //we use the _DEBUG macro to check for this
 namespace nn {
 
-data::data(int flag) : _data(0) {
+namespace {
+
+//standard deviation of the initial weights, which matches math::standarddist
+const double initialdeviation = 0.6;
+
+//number of samples evaluated at once by test and cost
+//the chunks do not depend on the thread count, so neither do the sums over them
+const std::size_t evaluationchunk = 256;
+
+//returns a view of a row of a minibatch, shaped like a single sample
+template<typename V>
+V samplerow(V batch, std::size_t row, std::size_t height, std::size_t width) {
+	return V(batch.data() + row * batch.stride(), height, width);
+}
+
+}
+
+template<typename T>
+basic_data<T>::basic_data(int flag) : _samples(), _sparse(), _order(0) {
 	switch (flag) {
 	case mnisttest:
 	{
-		_data = mnisttestload();
+		_samples = mnisttestload();
 		break;
 	}
 	case mnisttrain:
 	{
-		_data = mnisttrainload();
+		_samples = mnisttrainload();
 		break;
 	}
 
 	case XOR:
 	{
-		_data = generateXOR();
+		_samples = generateXOR();
 		break;
 	}
 
@@ -55,54 +77,97 @@ data::data(int flag) : _data(0) {
 	}
 	
 	}
+
+	_order.resize(_samples->inputs.height());
+	std::iota(_order.begin(), _order.end(), 0);
 }
 
-data::data(std::vector<std::pair<math::matrix, math::matrix>> data) : _data(data) {
+template<typename T>
+basic_data<T>::basic_data(std::shared_ptr<const samples> data, std::shared_ptr<const sparsematrix> sparse, std::vector<typename matrix::size_type> order) : _samples(data), _sparse(sparse), _order(order) {
 //empty function
 //no need to error check as function is private
 }
 
-data::size_type data::size() const {
-	return this->_data.size();
+template<typename T>
+typename basic_data<T>::size_type basic_data<T>::size() const {
+	return this->_order.size();
 }
 
-math::matrix::size_type data::inputheight() const {
-	return this->_data[0].first.height();
+template<typename T>
+typename basic_data<T>::matrix::size_type basic_data<T>::inputheight() const {
+	return this->_samples->inputheight;
 }
 
-math::matrix::size_type data::inputwidth() const {
-	return this->_data[0].first.width();
+template<typename T>
+typename basic_data<T>::matrix::size_type basic_data<T>::inputwidth() const {
+	return this->_samples->inputwidth;
 }
 
-math::matrix::size_type data::outputheight() const {
-	return this->_data[0].second.height();
+template<typename T>
+typename basic_data<T>::matrix::size_type basic_data<T>::outputheight() const {
+	return this->_samples->outputheight;
 }
 
-math::matrix::size_type data::outputwidth() const {
-	return this->_data[0].second.width();
+template<typename T>
+typename basic_data<T>::matrix::size_type basic_data<T>::outputwidth() const {
+	return this->_samples->outputwidth;
 }
 
-data data::shuffle() const {
-	data result(*this);
-	std::shuffle(result._data.begin(), result._data.end(), math::default_random_engine());
+template<typename T>
+basic_data<T> basic_data<T>::shuffle() const {
+	basic_data result(*this);
+	std::shuffle(result._order.begin(), result._order.end(), math::default_random_engine());
 	return result;
 }
 
-data data::trim(size_type size) const {
-	return data(std::vector<std::pair<math::matrix, math::matrix>>(this->_data.begin(), this->_data.begin() + size));
+template<typename T>
+basic_data<T> basic_data<T>::trim(size_type size) const {
+	return basic_data(this->_samples, this->_sparse, std::vector<typename matrix::size_type>(this->_order.begin(), this->_order.begin() + size));
+}
+
+template<typename T>
+basic_data<T> basic_data<T>::sparse() const {
+	if (this->issparse()) {
+		return *this;
+	}
+	return basic_data(this->_samples, std::make_shared<const sparsematrix>(this->_samples->inputs), this->_order);
+}
+
+template<typename T>
+bool basic_data<T>::issparse() const {
+	return this->_sparse != nullptr;
 }
 
-const std::pair<math::matrix, math::matrix>& data::operator[](data::size_type element) const {
+template<typename T>
+std::pair<typename basic_data<T>::constview, typename basic_data<T>::constview> basic_data<T>::operator[](size_type element) const {
 #ifdef _DEBUG
 	if (element < 0 || element >= this->size()) {
 		throw std::out_of_range("out of range");
 	}
 #endif
 
-	return this->_data[element];
+	const samples& data = *this->_samples;
+	typename matrix::size_type row = this->_order[element];
+	return std::make_pair(constview(data.inputs.data() + row * data.inputs.width(), data.inputheight, data.inputwidth),
+		constview(data.outputs.data() + row * data.outputs.width(), data.outputheight, data.outputwidth));
 }
 
-std::vector<std::pair<math::matrix, math::matrix>> data::mnisttestload() {
+template<typename T>
+typename basic_data<T>::sparsevector basic_data<T>::sparseinput(size_type element) const {
+#ifdef _DEBUG
+	if (element >= this->size()) {
+		throw std::out_of_range("out of range");
+	}
+	if (!this->issparse()) {
+		throw std::logic_error("dataset does not hold sparse inputs");
+	}
+#endif
+
+	return this->_sparse->row(this->_order[element]);
+}
+
+template<typename T>
+std::shared_ptr<const typename basic_data<T>::samples> basic_data<T>::mnisttestload() {
 	std::ifstream images("./../data/mnist/t10k-images.idx3-ubyte", std::ios::binary);
 	std::ifstream labels("./../data/mnist/t10k-labels.idx1-ubyte", std::ios::binary);
 
@@ -115,21 +180,27 @@ std::vector<std::pair<math::matrix, math::matrix>> data::mnisttestload() {
 	std::vector<unsigned char> imagesvec((std::istreambuf_iterator<char>(images)), std::istreambuf_iterator<char>());
 	std::vector<unsigned char> labelsvec((std::istreambuf_iterator<char>(labels)), std::istreambuf_iterator<char>());
 
-	std::vector<std::pair<math::matrix, math::matrix>> result(10000);
-	std::vector<math::num> image(784);
-
-	for (std::vector<std::pair<math::matrix, math::matrix>>::size_type i = 0; i != 10000; ++i) {
-		result[i].second = math::matrix::onehotmatrix(10, 1, static_cast<math::matrix::size_type>(labelsvec[i + 8]), 0);
-		for (std::vector<math::num>::size_type j = 0; j != 784; ++j) {
-			image[j] = static_cast<math::num>(imagesvec[784 * i + 16 + j]) / 256;
+	//images are loaded straight into their rows, and labels are one-hot
+	std::shared_ptr<samples> result = std::make_shared<samples>();
+	result->inputs = matrix(10000, 784);
+	result->outputs = matrix(10000, 10);
+	result->inputheight = 784;
+	result->inputwidth = 1;
+	result->outputheight = 10;
+	result->outputwidth = 1;
+
+	for (typename matrix::size_type i = 0; i != 10000; ++i) {
+		result->outputs(i, static_cast<typename matrix::size_type>(labelsvec[i + 8])) = 1;
+		for (typename matrix::size_type j = 0; j != 784; ++j) {
+			result->inputs(i, j) = static_cast<T>(imagesvec[784 * i + 16 + j]) / 256;
 		}
-		result[i].first = math::matrix(image, 1);
 	}
 
 	return result;
 }
 
-std::vector<std::pair<math::matrix, math::matrix>> data::mnisttrainload() {
+template<typename T>
+std::shared_ptr<const typename basic_data<T>::samples> basic_data<T>::mnisttrainload() {
 	std::ifstream images("./../data/mnist/train-images.idx3-ubyte", std::ios::binary);
 	std::ifstream labels("./../data/mnist/train-labels.idx1-ubyte", std::ios::binary);
 
@@ -142,36 +213,120 @@ std::vector<std::pair<math::matrix, math::matrix>> data::mnisttrainload() {
 	std::vector<unsigned char> imagesvec((std::istreambuf_iterator<char>(images)), std::istreambuf_iterator<char>());
 	std::vector<unsigned char> labelsvec((std::istreambuf_iterator<char>(labels)), std::istreambuf_iterator<char>());
 
-	std::vector<std::pair<math::matrix, math::matrix>> result(60000);
-	std::vector<math::num> image(784);
-
-	for (std::vector<std::pair<math::matrix, math::matrix>>::size_type i = 0; i != 60000; ++i) {
-		result[i].second = math::matrix::onehotmatrix(10, 1, static_cast<math::matrix::size_type>(labelsvec[i + 8]), 0);
-		for (std::vector<math::num>::size_type j = 0; j != 784; ++j) {
-			image[j] = static_cast<math::num>(imagesvec[784 * i + 16 + j]) / 256;
+	//images are loaded straight into their rows, and labels are one-hot
+	std::shared_ptr<samples> result = std::make_shared<samples>();
+	result->inputs = matrix(60000, 784);
+	result->outputs = matrix(60000, 10);
+	result->inputheight = 784;
+	result->inputwidth = 1;
+	result->outputheight = 10;
+	result->outputwidth = 1;
+
+	for (typename matrix::size_type i = 0; i != 60000; ++i) {
+		result->outputs(i, static_cast<typename matrix::size_type>(labelsvec[i + 8])) = 1;
+		for (typename matrix::size_type j = 0; j != 784; ++j) {
+			result->inputs(i, j) = static_cast<T>(imagesvec[784 * i + 16 + j]) / 256;
 		}
-		result[i].first = math::matrix(image, 1);
 	}
 
 	return result;
 }
 
-nn::nn(std::initializer_list<layer*> layers) : _data(0) {
-	std::initializer_list<layer*>::const_iterator end = layers.end();
-	for (std::initializer_list<layer*>::const_iterator i = layers.begin(); i != end; ++i) {
+template<typename T>
+void basic_layer<T>::sparsefeedforward(sparsevector input, view output, buffers iteration, buffers minibatch) const {
+	matrix dense(this->inputheight(), this->inputwidth());
+	input.expand(dense);
+	this->feedforward(dense, output, iteration, minibatch);
+}
+
+template<typename T>
+void basic_layer<T>::sparsebackprop(sparsevector input, constview errorin, view errorout, buffers iteration, buffers minibatch) const {
+	this->backprop(errorin, errorout, iteration, minibatch);
+}
+
+template<typename T>
+std::vector<buffershape> basic_layer<T>::batchshapes(size_type batchsize) const {
+	std::vector<buffershape> iteration = this->iterationshapes();
+	std::vector<buffershape> result;
+	for (size_type i = 0; i != batchsize; ++i) {
+		result.insert(result.end(), iteration.begin(), iteration.end());
+	}
+	return result;
+}
+
+template<typename T>
+void basic_layer<T>::batchevaluate(constview input, view output) const {
+#ifdef _DEBUG
+	if (this->inputheight() * this->inputwidth() != input.width()) {
+		throw std::invalid_argument("input matrix is incompatible");
+	}
+	if (this->outputheight() * this->outputwidth() != output.width() || output.height() != input.height()) {
+		throw std::invalid_argument("output matrix is incompatible");
+	}
+#endif
+
+	size_type batchsize = input.height();
+	for (size_type i = 0; i != batchsize; ++i) {
+		this->evaluate(samplerow(input, i, this->inputheight(), this->inputwidth()), samplerow(output, i, this->outputheight(), this->outputwidth()));
+	}
+}
+
+//the batch buffers hold the iteration buffers of each sample in turn
+template<typename T>
+void basic_layer<T>::batchfeedforward(constview input, view output, buffers batch, buffers minibatch) const {
+	size_type batchsize = input.height();
+
+#ifdef _DEBUG
+	if (this->inputheight() * this->inputwidth() != input.width() || batchsize == 0 || batch.size() % batchsize != 0) {
+		throw std::invalid_argument("input matrix is incompatible");
+	}
+	if (this->outputheight() * this->outputwidth() != output.width() || output.height() != batchsize) {
+		throw std::invalid_argument("output matrix is incompatible");
+	}
+#endif
+
+	size_type count = batch.size() / batchsize;
+	for (size_type i = 0; i != batchsize; ++i) {
+		this->feedforward(samplerow(input, i, this->inputheight(), this->inputwidth()), samplerow(output, i, this->outputheight(), this->outputwidth()), batch.slice(i * count, count), minibatch);
+	}
+}
+
+template<typename T>
+void basic_layer<T>::batchbackprop(constview errorin, view errorout, buffers batch, buffers minibatch) const {
+	size_type batchsize = errorin.height();
+
+#ifdef _DEBUG
+	if (this->inputheight() * this->inputwidth() != errorout.width() || errorout.height() != batchsize) {
+		throw std::invalid_argument("errorout has incompatible size");
+	}
+	if (this->outputheight() * this->outputwidth() != errorin.width() || batchsize == 0 || batch.size() % batchsize != 0) {
+		throw std::invalid_argument("errorin has incompatible size");
+	}
+#endif
+
+	size_type count = batch.size() / batchsize;
+	for (size_type i = 0; i != batchsize; ++i) {
+		this->backprop(samplerow(errorin, i, this->outputheight(), this->outputwidth()), samplerow(errorout, i, this->inputheight(), this->inputwidth()), batch.slice(i * count, count), minibatch);
+	}
+}
+
+template<typename T>
+basic_nn<T>::basic_nn(std::initializer_list<layer*> layers) : _data(0) {
+	typename std::initializer_list<layer*>::const_iterator end = layers.end();
+	for (typename std::initializer_list<layer*>::const_iterator i = layers.begin(); i != end; ++i) {
 		_data.push_back(std::move((*i)->clone()));
 	}
 
 #ifdef _DEBUG
-	std::vector<std::unique_ptr<layer>>::size_type size = _data.size();
+	typename std::vector<std::unique_ptr<layer>>::size_type size = _data.size();
 	if (size == 0) {
 		throw std::invalid_argument("no layers were given");
 	}
-	for (std::vector<std::unique_ptr<layer>>::size_type i = 0; i != size - 1; ++i) {
-		layer::size_type currentoutputwidth = _data[i]->outputwidth();
-		layer::size_type nextinputwidth = _data[i + 1]->inputwidth();
-		layer::size_type currentoutputheight = _data[i]->outputheight();
-		layer::size_type nextinputheight = _data[i + 1]->inputheight();
+	for (typename std::vector<std::unique_ptr<layer>>::size_type i = 0; i != size - 1; ++i) {
+		typename layer::size_type currentoutputwidth = _data[i]->outputwidth();
+		typename layer::size_type nextinputwidth = _data[i + 1]->inputwidth();
+		typename layer::size_type currentoutputheight = _data[i]->outputheight();
+		typename layer::size_type nextinputheight = _data[i + 1]->inputheight();
 		if (currentoutputwidth != nextinputwidth || currentoutputheight != nextinputheight) {
 			throw std::invalid_argument("layer sizes do not match");
 		}
@@ -179,40 +334,52 @@ nn::nn(std::initializer_list<layer*> layers) : _data(0) {
 #endif
 }
 
-std::vector<std::pair<math::matrix, math::matrix>> data::generateXOR() {
-	std::vector<std::pair<math::matrix, math::matrix>> result(5000);
-	
-	for (data::size_type i = 0; i != 5000; ++i) {
-		result[i].first = math::matrix(2, 1, math::bernoullidist);
+template<typename T>
+basic_nn<T>::basic_nn(std::vector<std::unique_ptr<layer>> layers) : _data(std::move(layers)) {
 
+}
+
+template<typename T>
+std::shared_ptr<const typename basic_data<T>::samples> basic_data<T>::generateXOR() {
+	std::shared_ptr<samples> result = std::make_shared<samples>();
+	result->inputs = matrix(5000, 2);
+	math::bernoullifill<T>(result->inputs, static_cast<T>(0.5), math::nextseed());
+	result->outputs = matrix(5000, 1);
+	result->inputheight = 2;
+	result->inputwidth = 1;
+	result->outputheight = 1;
+	result->outputwidth = 1;
+	
+	for (typename matrix::size_type i = 0; i != 5000; ++i) {
 		//evaluate logical XOR
-		if (result[i].first[0] == 1) {
-			if (result[i].first[1] == 1) {
-				result[i].second = math::matrix(1, 1, { 0 });
-			}
-			else {
-				result[i].second = math::matrix(1, 1, { 1 });
-			}
-		}
-		else {
-			if (result[i].first[1] == 1) {
-				result[i].second = math::matrix(1, 1, { 1 });
-			}
-			else {
-				result[i].second = math::matrix(1, 1, { 0 });
-			}
+		if (result->inputs(i, 0) != result->inputs(i, 1)) {
+			result->outputs(i, 0) = 1;
 		}
 	}
 
 	return result;
 }
 
-nn::size_type nn::size() const {
+template<typename T>
+typename basic_nn<T>::size_type basic_nn<T>::size() const {
 	return this->_data.size();
 }
 
+template<typename T>
+const basic_layer<T>& basic_nn<T>::operator[](size_type element) const {
+#ifdef _DEBUG
+	if (element >= this->size()) {
+		throw std::out_of_range("out of range");
+	}
+#endif
+
+	return *this->_data[element];
+}
+
 //preallocation is not used, as in this function, the output is only evaluated once
-math::matrix nn::evaluate(const math::matrix& input) const {
+//callers that evaluate repeatedly should use a session instead
+template<typename T>
+math::basic_matrix<T> basic_nn<T>::evaluate(const matrix& input) const {
 #ifdef _DEBUG
 	if (input.width() != this->_data[0]->inputwidth() || input.height() != this->_data[0]->inputheight()) {
 		throw std::invalid_argument("input size is incompatible");
@@ -220,7 +387,7 @@ math::matrix nn::evaluate(const math::matrix& input) const {
 #endif
 
 	size_type size = this->size();
-	math::matrix result(input);
+	matrix result(input);
 	for (size_type i = 0; i != size; ++i) {
 		result = this->_data[i]->evaluate(result);
 	}
@@ -228,11 +395,52 @@ math::matrix nn::evaluate(const math::matrix& input) const {
 	return result;
 }
 
-void nn::train(const data& learningdata, math::num learningrate, data::size_type batchsize) {
-	data::size_type batchnum = learningdata.size()/batchsize;
-	nn::size_type nnsize = this->size();
-
+template<typename T>
+void basic_nn<T>::batchevaluate(constview inputs, view outputs) const {
+	basic_session<T> evaluator(*this, std::max<typename matrix::size_type>(inputs.height(), 1));
+	evaluator.batchevaluate(inputs, outputs);
+}
+
+//holds the buffers of every layer, and the buffers passed between the layers, for one shard of a minibatch
+//shards of sparse datasets are trained a sample at a time, so they use iteration buffers and buffers the size of a sample,
+//and other shards use batch buffers and buffers with a row per sample
+//all of them are views into a single arena
+template<typename T>
+struct basic_nn<T>::workspace {
+	typename data::size_type samples;
+	basic_arena<T> memory;
+	//the minibatch buffers, and the iteration or batch buffers, of each layer
+	std::vector<basic_buffers<T>> minibatch;
+	std::vector<basic_buffers<T>> state;
+	//the packed inputs and correct outputs of the shard
+	view input;
+	view correct;
+	//the output of each layer, and the error passed into each layer by backprop
+	//the error into the last layer is the difference between its output and the correct output
+	std::vector<view> outputs;
+	std::vector<view> errors;
+	//the error out of the first layer, which is not used
+	view inputerror;
+	//the error of the output is multiplied by this before backprop, so small derivatives do not underflow at a lower precision
+	T lossscale;
+	//the number of layers in each segment, and the first layer of the last segment
+	//the layers before the last segment are run again during backprop, writing their outputs to their own buffers
+	size_type checkpoint;
+	size_type lastsegment;
+	std::vector<view> recomputed;
+};
+
+//training with a learning rate is plain gradient descent
+template<typename T>
+void basic_nn<T>::train(const data& learningdata, T learningrate, typename data::size_type batchsize, parallelism mode, size_type checkpoint) {
+	basic_sgd<T> optimizer(learningrate);
+	this->train(learningdata, optimizer, batchsize, mode, checkpoint);
+}
+
+template<typename T>
+void basic_nn<T>::train(const data& learningdata, basic_optimizer<T>& optimizer, typename data::size_type batchsize, parallelism mode, size_type checkpoint) {
 #ifdef _DEBUG
+	size_type nnsize = this->size();
 	if (this->_data[0]->inputheight() != learningdata.inputheight() || this->_data[0]->inputwidth() != learningdata.inputwidth()) {
 		throw std::invalid_argument("input data is incompatible");
 	}
@@ -241,51 +449,206 @@ void nn::train(const data& learningdata, math::num learningrate, data::size_type
 	}
 #endif
 
-	//get our minibatch pointers
-	std::vector<void*> minibatchptr(this->allocateminibatch());
-	//get our iteration pointers
-	std::vector<void*> iterationptr(this->allocateiteration());
-		
-	//preallocate buffers
-	math::matrix resultbuffer(this->_data[nnsize - 1]->outputheight(), this->_data[nnsize - 1]->outputwidth());
-	math::matrix inputerrorbuffer(this->_data[0]->inputheight(), this->_data[0]->inputwidth());
-	std::vector<math::matrix> buffervec;
-	for (nn::size_type i = 0; i != nnsize; ++i) {
-		math::matrix buffer(this->_data[i]->outputheight(), this->_data[i]->outputwidth());
-		buffervec.push_back(buffer);
+	//the optimizer keeps its moments for the minibatch buffers of every layer
+	const std::vector<basic_buffers<T>>& moments = optimizer.bind(this->minibatchshapes());
+
+	if (mode == asynchronous) {
+		this->trainasynchronous(learningdata, optimizer, moments, batchsize, checkpoint);
+		return;
+	}
+
+	this->trainsynchronous(learningdata, batchsize, mode, checkpoint, 1, [&](const std::vector<basic_buffers<T>>& minibatch) {
+		this->update(minibatch, optimizer, moments);
+		return T(1);
+	});
+}
+
+//a minibatch is split into shards of nearly equal size, with the spare samples going to the first shards
+//each shard is trained on its own workspace, so the shards can run on different threads at once
+template<typename T>
+void basic_nn<T>::trainsynchronous(const data& learningdata, typename data::size_type batchsize, parallelism mode, size_type checkpoint, T lossscale, std::function<T(const std::vector<basic_buffers<T>>& minibatch)> update) {
+	typename data::size_type batchnum = learningdata.size()/batchsize;
+	typename data::size_type shards = 1;
+	if (mode == dataparallel) {
+		shards = std::min(static_cast<typename data::size_type>(math::threads()), batchsize);
+	}
+
+	//allocate a workspace for every shard
+	std::vector<typename data::size_type> firstsample;
+	std::vector<workspace> workspaces;
+	for (typename data::size_type i = 0; i != shards; ++i) {
+		firstsample.push_back(i * (batchsize / shards) + std::min(i, batchsize % shards));
+		workspaces.push_back(this->allocateworkspace(learningdata, batchsize / shards + (i < batchsize % shards ? 1 : 0), checkpoint));
 	}
 
 	//iterate across our batches
-	for (data::size_type i = 0; i != batchnum; ++i) {
-		//iterate over a minibatch
-		for (data::size_type j = 0; j != batchsize; ++j) {
+	for (typename data::size_type i = 0; i != batchnum; ++i) {
+		math::parallelfor(shards, 1, [&](std::size_t begin, std::size_t end) {
+			for (std::size_t j = begin; j != end; ++j) {
+				workspaces[j].lossscale = lossscale;
+				this->trainshard(learningdata, i * batchsize + firstsample[j], workspaces[j]);
+			}
+		});
+		this->reduce(workspaces);
+		lossscale = update(workspaces[0].minibatch);
+	}
+}
+
+//the minibatches are handed out with an atomic counter, so no thread waits for another
+//every thread updates the shared parameters with its own derivatives, so the layers must only touch their own minibatch memory in update
+//the moments of the optimizer are shared in the same way, and are updated without synchronisation, like the parameters
+template<typename T>
+void basic_nn<T>::trainasynchronous(const data& learningdata, basic_optimizer<T>& optimizer, const std::vector<basic_buffers<T>>& moments, typename data::size_type batchsize, size_type checkpoint) {
+	typename data::size_type batchnum = learningdata.size()/batchsize;
+	typename data::size_type workers = std::min(static_cast<typename data::size_type>(math::threads()), batchnum);
+
+	//allocate a workspace for every thread
+	std::vector<workspace> workspaces;
+	for (typename data::size_type i = 0; i != workers; ++i) {
+		workspaces.push_back(this->allocateworkspace(learningdata, batchsize, checkpoint));
+	}
+
+	std::atomic<typename data::size_type> next(0);
+	math::parallelfor(workers, 1, [&](std::size_t begin, std::size_t end) {
+		for (std::size_t i = begin; i != end; ++i) {
+			for (typename data::size_type j = next++; j < batchnum; j = next++) {
+				this->trainshard(learningdata, j * batchsize, workspaces[i]);
+				this->update(workspaces[i].minibatch, optimizer, moments);
+			}
+		}
+	});
+}
+
+//every sample is a row of the shard matricies, so each layer sees its samples in the same order as it would one at a time
+template<typename T>
+void basic_nn<T>::trainshard(const data& learningdata, typename data::size_type first, workspace& work) const {
+	size_type nnsize = this->size();
+	std::vector<view>& outputs = work.outputs;
+	std::vector<view>& errors = work.errors;
+
+	if (learningdata.issparse()) {
+		for (typename data::size_type j = 0; j != work.samples; ++j) {
 			//feedforward
-			this->_data[0]->feedforward(learningdata[i * batchsize + j].first, buffervec[0], iterationptr[0], minibatchptr[0]);
-			for (nn::size_type k = 1; k != nnsize; ++k) {
-				this->_data[k]->feedforward(buffervec[k - 1], buffervec[k], iterationptr[k], minibatchptr[k]);
+			typename data::sparsevector input = learningdata.sparseinput(first + j);
+			this->_data[0]->sparsefeedforward(input, outputs[0], work.state[0], work.minibatch[0]);
+			for (size_type k = 1; k != nnsize; ++k) {
+				this->_data[k]->feedforward(outputs[k - 1], outputs[k], work.state[k], work.minibatch[k]);
 			}
 			//calculate difference between output and desired (aL - y)
-			math::matrix::subtract(buffervec[nnsize - 1], learningdata[i * batchsize + j].second, resultbuffer);
+			matrix::subtract(outputs[nnsize - 1], learningdata[first + j].second, errors[nnsize - 1]);
+			if (work.lossscale != 1) {
+				matrix::multiply(errors[nnsize - 1], work.lossscale, errors[nnsize - 1]);
+			}
 			//backpropagate the error
-			this->_data[nnsize - 1]->backprop(resultbuffer, buffervec[nnsize - 1], iterationptr[nnsize - 1], minibatchptr[nnsize - 1]);
-			for (nn::size_type k = nnsize - 2; k != 0; --k) {
-				this->_data[k]->backprop(buffervec[k], buffervec[k - 1], iterationptr[k], minibatchptr[k]);
+			//the error out of a layer has the size of that layer's input, which is the previous layer's output
+			for (size_type k = nnsize - 1; k != 0; --k) {
+				this->_data[k]->backprop(errors[k], errors[k - 1], work.state[k], work.minibatch[k]);
 			}
-			this->_data[0]->backprop(buffervec[0], inputerrorbuffer, iterationptr[0], minibatchptr[0]);
+			this->_data[0]->sparsebackprop(input, errors[0], work.inputerror, work.state[0], work.minibatch[0]);
 		}
-		this->update(minibatchptr, learningrate);
+		return;
 	}
 
-	//deallocate our memory
-	this->deallocateiteration(iterationptr);
-	this->deallocateminibatch(minibatchptr);
+	//pack the shard
+	typename matrix::size_type inputheight = learningdata.inputheight();
+	typename matrix::size_type inputwidth = learningdata.inputwidth();
+	typename matrix::size_type outputheight = learningdata.outputheight();
+	typename matrix::size_type outputwidth = learningdata.outputwidth();
+	for (typename data::size_type j = 0; j != work.samples; ++j) {
+		std::pair<constview, constview> sample = learningdata[first + j];
+		matrix::copy(sample.first, samplerow(work.input, j, inputheight, inputwidth));
+		matrix::copy(sample.second, samplerow(work.correct, j, outputheight, outputwidth));
+	}
+	//feedforward, only filling the buffers of the layers in the last segment
+	for (size_type k = 0; k != nnsize; ++k) {
+		constview input = k == 0 ? constview(work.input) : constview(outputs[k - 1]);
+		if (k < work.lastsegment) {
+			this->_data[k]->batchevaluate(input, outputs[k]);
+		} else {
+			this->_data[k]->batchfeedforward(input, outputs[k], work.state[k], work.minibatch[k]);
+		}
+	}
+	//calculate difference between output and desired (aL - y)
+	matrix::subtract(outputs[nnsize - 1], work.correct, errors[nnsize - 1]);
+	if (work.lossscale != 1) {
+		matrix::multiply(errors[nnsize - 1], work.lossscale, errors[nnsize - 1]);
+	}
+	//backpropagate the error through the last segment, then through each segment before it once it has been run again
+	//the error out of a layer has the size of that layer's input, which is the previous layer's output
+	size_type end = nnsize;
+	for (size_type begin = work.lastsegment; ; begin -= work.checkpoint) {
+		if (end != nnsize) {
+			for (size_type k = begin; k != end; ++k) {
+				constview input = k == 0 ? constview(work.input) : k == begin ? constview(outputs[k - 1]) : constview(work.recomputed[k - 1]);
+				this->_data[k]->batchfeedforward(input, work.recomputed[k], work.state[k], work.minibatch[k]);
+			}
+		}
+		for (size_type k = end; k != begin; --k) {
+			this->_data[k - 1]->batchbackprop(errors[k - 1], k == 1 ? work.inputerror : errors[k - 2], work.state[k - 1], work.minibatch[k - 1]);
+		}
+		if (begin == 0) {
+			break;
+		}
+		end = begin;
+	}
 }
 
-data::size_type nn::test(const data& input, std::function<bool(const math::matrix&, const math::matrix&, math::matrix&)> compare) const {
-	nn::size_type nnsize = this->size();
-	data::size_type datasize = input.size();
+//each level of the tree merges pairs of workspaces a stride apart, and the pairs of a level are merged in parallel
+//the pairs only depend on the number of workspaces, so the sums are done in the same order on every run
+template<typename T>
+void basic_nn<T>::reduce(std::vector<workspace>& workspaces) const {
+	size_type nnsize = this->size();
+	size_type count = workspaces.size();
+	for (size_type stride = 1; stride < count; stride *= 2) {
+		size_type pairs = (count - stride - 1) / (2 * stride) + 1;
+		math::parallelfor(pairs, 1, [&](std::size_t begin, std::size_t end) {
+			for (std::size_t i = begin; i != end; ++i) {
+				workspace& target = workspaces[i * 2 * stride];
+				workspace& source = workspaces[i * 2 * stride + stride];
+				for (size_type k = 0; k != nnsize; ++k) {
+					this->_data[k]->mergeminibatch(target.minibatch[k], source.minibatch[k]);
+				}
+			}
+		});
+	}
+}
+
+//each thread packs the inputs of a chunk into rows, and runs them through its own session
+//the last chunk may be short, so only the rows it fills are evaluated
+template<typename T>
+void basic_nn<T>::evaluatechunks(const data& input, std::function<void(size_type, typename data::size_type, constview, view)> visit) const {
+	typename data::size_type datasize = input.size();
+	typename data::size_type chunks = (datasize + evaluationchunk - 1) / evaluationchunk;
+	typename matrix::size_type inputheight = input.inputheight();
+	typename matrix::size_type inputwidth = input.inputwidth();
+	typename matrix::size_type outputheight = input.outputheight();
+	typename matrix::size_type outputwidth = input.outputwidth();
+
+	math::parallelfor(chunks, 1, [&](std::size_t begin, std::size_t end) {
+		//preallocate buffers
+		basic_session<T> evaluator(*this, evaluationchunk);
+		matrix inputs(evaluationchunk, inputheight * inputwidth);
+		matrix outputs(evaluationchunk, outputheight * outputwidth);
+		matrix resultbuffer(outputheight, outputwidth);
+
+		for (std::size_t i = begin; i != end; ++i) {
+			typename data::size_type first = i * evaluationchunk;
+			typename data::size_type rows = std::min<typename data::size_type>(evaluationchunk, datasize - first);
+			for (typename data::size_type j = 0; j != rows; ++j) {
+				matrix::copy(input[first + j].first, samplerow(view(inputs), j, inputheight, inputwidth));
+			}
+			evaluator.batchevaluate(constview(inputs).block(0, 0, rows, inputs.width()), view(outputs).block(0, 0, rows, outputs.width()));
+			for (typename data::size_type j = 0; j != rows; ++j) {
+				visit(i, first + j, samplerow(constview(outputs), j, outputheight, outputwidth), resultbuffer);
+			}
+		}
+	});
+}
 
+template<typename T>
+typename basic_data<T>::size_type basic_nn<T>::test(const data& input, std::function<bool(constview, constview, view)> compare) const {
 #ifdef _DEBUG
+	size_type nnsize = this->size();
 	if (this->_data[0]->inputheight() != input.inputheight() || this->_data[0]->inputwidth() != input.inputwidth()) {
 		throw std::invalid_argument("input data is incompatible");
 	}
@@ -294,33 +657,27 @@ data::size_type nn::test(const data& input, std::function<bool(const math::matri
 	}
 #endif
 
-	//preallocate buffers
-	data::size_type numcorrect = 0;
-	std::vector<math::matrix> buffervec;
-	math::matrix resultbuffer(this->_data[nnsize - 1]->outputheight(), this->_data[nnsize - 1]->outputwidth());
-	for (nn::size_type i = 0; i != nnsize; ++i) {
-		math::matrix buffer(this->_data[i]->outputheight(), this->_data[i]->outputwidth());
-		buffervec.push_back(buffer);
-	}
-
-	for (data::size_type i = 0; i != datasize; ++i) {
-		this->_data[0]->evaluate(input[i].first, buffervec[0]);
-		for (nn::size_type j = 1; j != nnsize; ++j) {
-			this->_data[j]->evaluate(buffervec[j - 1], buffervec[j]);
+	//each chunk counts its own samples, so no two threads write to the same count
+	std::vector<typename data::size_type> chunkcorrect((input.size() + evaluationchunk - 1) / evaluationchunk, 0);
+	this->evaluatechunks(input, [&](size_type chunk, typename data::size_type sample, constview output, view buffer) {
+		if (compare(input[sample].second, output, buffer)) {
+			++chunkcorrect[chunk];
 		}
-		if (compare(input[i].second, buffervec[nnsize - 1], resultbuffer)) {
-			++numcorrect;
-		}
-	}
+	});
 
+	typename data::size_type numcorrect = 0;
+	for (typename data::size_type count : chunkcorrect) {
+		numcorrect += count;
+	}
 	return numcorrect;
 }
 
-math::num nn::cost(const data& input, std::function<math::num(const math::matrix& correct, const math::matrix& output)> cost) {
-	nn::size_type nnsize = this->size();
-	data::size_type datasize = input.size();
+template<typename T>
+T basic_nn<T>::cost(const data& input, std::function<T(constview correct, constview output)> cost) {
+	typename data::size_type datasize = input.size();
 
 #ifdef _DEBUG
+	size_type nnsize = this->size();
 	if (this->_data[0]->inputheight() != input.inputheight() || this->_data[0]->inputwidth() != input.inputwidth()) {
 		throw std::invalid_argument("input data is incompatible");
 	}
@@ -329,89 +686,167 @@ math::num nn::cost(const data& input, std::function<math::num(const math::matrix
 	}
 #endif
 
-	//preallocate buffers
-	math::num costsum = 0;
-	std::vector<math::matrix> buffervec;
-	for (nn::size_type i = 0; i != nnsize; ++i) {
-		math::matrix buffer(this->_data[i]->outputheight(), this->_data[i]->outputwidth());
-		buffervec.push_back(buffer);
-	}
+	//the samples of a chunk are visited in order by one thread, so each chunk sum is always added up the same way
+	std::vector<T> chunkcost((datasize + evaluationchunk - 1) / evaluationchunk, 0);
+	this->evaluatechunks(input, [&](size_type chunk, typename data::size_type sample, constview output, view) {
+		chunkcost[chunk] += cost(input[sample].second, output);
+	});
 
-	for (data::size_type i = 0; i != datasize; ++i) {
-		this->_data[0]->evaluate(input[i].first, buffervec[0]);
-		for (nn::size_type j = 1; j != nnsize; ++j) {
-			this->_data[j]->evaluate(buffervec[j - 1], buffervec[j]);
-		}
-		costsum += cost(input[i].second, buffervec[nnsize - 1]);
+	T costsum = 0;
+	for (T sum : chunkcost) {
+		costsum += sum;
 	}
 
 	//reconsider this cost value, as it could be too small for a ML algorithm to pick up
 	return costsum / datasize;
 }
 
-void nn::update(const std::vector<void*>& minibatch, math::num learningrate) {
-	nn::size_type nnsize = this->size();
-
-#ifdef _DEBUG
-	if (nnsize != minibatch.size()) {
-		throw std::invalid_argument("vec of minibatch ptr has incompatible size");
-	}
-#endif
-
-	for (nn::size_type i = 0; i != nnsize; ++i) {
-		this->_data[i]->update(minibatch[i], learningrate);
-	}
-}
-
-std::vector<void*> nn::allocateminibatch() const {
-	std::vector<void*> minibatchptr;
-	nn::size_type nnsize = this->size();
-	for (nn::size_type i = 0; i != nnsize; ++i) {
-		minibatchptr.push_back(this->_data[i]->allocateminibatch());
+template<typename T>
+void basic_nn<T>::fuse() {
+	std::vector<std::unique_ptr<layer>> result;
+	size_type nnsize = this->size();
+	size_type i = 0;
+	while (i != nnsize) {
+		if (nnsize - i >= 3) {
+			const basic_weights<T>* weights = dynamic_cast<const basic_weights<T>*>(this->_data[i].get());
+			const basic_biases<T>* biases = dynamic_cast<const basic_biases<T>*>(this->_data[i + 1].get());
+			const basic_sigmoid<T>* sigmoid = dynamic_cast<const basic_sigmoid<T>*>(this->_data[i + 2].get());
+			if (weights != nullptr && biases != nullptr && sigmoid != nullptr) {
+				result.push_back(std::unique_ptr<layer>(new basic_dense<T>(*weights, *biases, *sigmoid)));
+				i += 3;
+				continue;
+			}
+		}
+		result.push_back(std::move(this->_data[i]));
+		++i;
 	}
-
-	return minibatchptr;
+	this->_data = std::move(result);
 }
 
-void nn::deallocateminibatch(const std::vector<void*>& minibatchptr) const {
-	nn::size_type nnsize = this->size();
+template<typename T>
+void basic_nn<T>::update(const std::vector<basic_buffers<T>>& minibatch, basic_optimizer<T>& optimizer, const std::vector<basic_buffers<T>>& moments) {
+	size_type nnsize = this->size();
 
 #ifdef _DEBUG
-	if (nnsize != minibatchptr.size()) {
-		throw std::invalid_argument("vec of minibatch ptr has incompatible size");
+	if (nnsize != minibatch.size() || nnsize != moments.size()) {
+		throw std::invalid_argument("vec of minibatch buffers has incompatible size");
 	}
 #endif
 
-	for (nn::size_type i = 0; i != nnsize; ++i) {
-		this->_data[i]->deallocateminibatch(minibatchptr[i]);
+	optimizer.advance();
+	for (size_type i = 0; i != nnsize; ++i) {
+		this->_data[i]->update(minibatch[i], optimizer, moments[i]);
 	}
 }
 
-std::vector<void*> nn::allocateiteration() const {
-	std::vector<void*> iterationptr;
-	nn::size_type nnsize = this->size();
-	for (nn::size_type i = 0; i != nnsize; ++i) {
-		iterationptr.push_back(this->_data[i]->allocateiteration());
+template<typename T>
+std::vector<std::vector<buffershape>> basic_nn<T>::minibatchshapes() const {
+	std::vector<std::vector<buffershape>> result;
+	for (const std::unique_ptr<layer>& current : this->_data) {
+		result.push_back(current->minibatchshapes());
 	}
-
-	return iterationptr;
+	return result;
 }
 
-void nn::deallocateiteration(const std::vector<void*>& iterationptr) const {
-	nn::size_type nnsize = this->size();
-
-#ifdef _DEBUG
-	if (nnsize != iterationptr.size()) {
-		throw std::invalid_argument("vec of iteration ptr has incompatible size");
+//a shard runs in steps: packing the inputs is step 0, the feedforward of layer k is step 1 + k,
+//and finding the error of the output is step n + 1
+//the steps after that backprop the last segment, then run each segment before it again and backprop it, a layer per step
+//without a checkpoint there is one segment, so the backprop of layer k is step 2n + 1 - k
+//each buffer is only live for the steps that use it, so the arena can give the same memory to buffers that are never live together,
+//such as the outputs of layers far apart, an output and an error, or the buffers of layers in different segments
+template<typename T>
+typename basic_nn<T>::workspace basic_nn<T>::allocateworkspace(const data& learningdata, typename data::size_type samples, size_type checkpoint) const {
+	size_type nnsize = this->size();
+	bool sparse = learningdata.issparse();
+	typename data::size_type rows = sparse ? 1 : samples;
+
+	workspace work;
+	work.samples = samples;
+	work.lossscale = 1;
+	work.checkpoint = checkpoint == 0 || checkpoint > nnsize || sparse ? nnsize : checkpoint;
+	work.lastsegment = (nnsize - 1) / work.checkpoint * work.checkpoint;
+
+	//find the step each layer is run again in, and the step it is backpropped in
+	std::vector<size_type> rerun(nnsize, 0);
+	std::vector<size_type> back(nnsize, 0);
+	size_type step = nnsize + 2;
+	size_type end = nnsize;
+	for (size_type begin = work.lastsegment; ; begin -= work.checkpoint) {
+		if (end != nnsize) {
+			for (size_type k = begin; k != end; ++k) {
+				rerun[k] = step++;
+			}
+		}
+		for (size_type k = end; k != begin; --k) {
+			back[k - 1] = step++;
+		}
+		if (begin == 0) {
+			break;
+		}
+		end = begin;
+	}
+	size_type last = back[0];
+
+	//the shape of the output of each layer, a sample at a time or with a row per sample
+	std::vector<buffershape> shapes;
+	shapes.push_back(sparse ? buffershape{ learningdata.inputheight(), learningdata.inputwidth() } : buffershape{ rows, learningdata.inputheight() * learningdata.inputwidth() });
+	for (size_type k = 0; k != nnsize; ++k) {
+		const layer& current = *this->_data[k];
+		shapes.push_back(sparse ? buffershape{ current.outputheight(), current.outputwidth() } : buffershape{ rows, current.outputheight() * current.outputwidth() });
 	}
-#endif
 
-	for (nn::size_type i = 0; i != nnsize; ++i) {
-		this->_data[i]->deallocateiteration(iterationptr[i]);
+	//ask for every buffer
+	std::vector<typename basic_arena<T>::handle> minibatch, state, outputs, errors, recomputed;
+	std::vector<size_type> minibatchcount, statecount;
+	minibatch.reserve(nnsize);
+	state.reserve(nnsize);
+	outputs.reserve(nnsize);
+	errors.reserve(nnsize);
+	recomputed.reserve(nnsize);
+	minibatchcount.reserve(nnsize);
+	statecount.reserve(nnsize);
+	work.minibatch.reserve(nnsize);
+	work.state.reserve(nnsize);
+	work.outputs.reserve(nnsize);
+	work.errors.reserve(nnsize);
+	work.recomputed.reserve(nnsize);
+	for (size_type k = 0; k != nnsize; ++k) {
+		//the layers before the last segment only need their buffers from when they are run again,
+		//and the output of the last layer in each of those segments is kept until the next segment is run again
+		bool rerunning = k < work.lastsegment;
+		bool kept = k + 1 < work.lastsegment && (k + 1) % work.checkpoint == 0;
+		std::vector<buffershape> layerminibatch = this->_data[k]->minibatchshapes();
+		std::vector<buffershape> layerstate = sparse ? this->_data[k]->iterationshapes() : this->_data[k]->batchshapes(samples);
+		minibatch.push_back(work.memory.reserve(layerminibatch, 0, last));
+		minibatchcount.push_back(layerminibatch.size());
+		state.push_back(work.memory.reserve(layerstate, rerunning ? rerun[k] : 1 + k, back[k]));
+		statecount.push_back(layerstate.size());
+		outputs.push_back(work.memory.reserve(shapes[k + 1].height, shapes[k + 1].width, 1 + k, kept ? rerun[k + 1] : 2 + k));
+		errors.push_back(work.memory.reserve(shapes[k + 1].height, shapes[k + 1].width, k + 1 == nnsize ? nnsize + 1 : back[k + 1], back[k]));
+		recomputed.push_back(work.memory.reserve(rerunning ? shapes[k + 1].height : 0, shapes[k + 1].width, rerun[k], (k + 1) % work.checkpoint == 0 ? rerun[k] : rerun[k] + 1));
+	}
+	typename basic_arena<T>::handle input = work.memory.reserve(sparse ? 0 : shapes[0].height, shapes[0].width, 0, work.lastsegment == 0 ? 1 : rerun[0]);
+	typename basic_arena<T>::handle correct = work.memory.reserve(sparse ? 0 : shapes[nnsize].height, shapes[nnsize].width, 0, nnsize + 1);
+	typename basic_arena<T>::handle inputerror = work.memory.reserve(shapes[0].height, shapes[0].width, last, last);
+
+	//place them
+	work.memory.allocate();
+	for (size_type k = 0; k != nnsize; ++k) {
+		work.minibatch.push_back(work.memory.group(minibatch[k], minibatchcount[k]));
+		work.state.push_back(work.memory.group(state[k], statecount[k]));
+		work.outputs.push_back(work.memory[outputs[k]]);
+		work.errors.push_back(work.memory[errors[k]]);
+		work.recomputed.push_back(work.memory[recomputed[k]]);
 	}
+	work.input = work.memory[input];
+	work.correct = work.memory[correct];
+	work.inputerror = work.memory[inputerror];
+
+	return work;
 }
 
-sigmoid::sigmoid(size_type height, size_type width) : _height(height), _width(width) {
+template<typename T>
+basic_sigmoid<T>::basic_sigmoid(size_type height, size_type width, math::accuracy mode) : _height(height), _width(width), _mode(mode) {
 #ifdef _DEBUG
 	if (height <= 0 || width <= 0) {
 		throw std::invalid_argument("empty layer initialization");
@@ -419,58 +854,68 @@ sigmoid::sigmoid(size_type height, size_type width) : _height(height), _width(wi
 #endif
 }
 
-sigmoid::size_type sigmoid::inputwidth() const {
+template<typename T>
+typename basic_sigmoid<T>::size_type basic_sigmoid<T>::inputwidth() const {
 	return this->_width;
 }
 
-sigmoid::size_type sigmoid::inputheight() const {
+template<typename T>
+typename basic_sigmoid<T>::size_type basic_sigmoid<T>::inputheight() const {
 	return this->_height;
 }
 
-sigmoid::size_type sigmoid::outputwidth() const {
+template<typename T>
+typename basic_sigmoid<T>::size_type basic_sigmoid<T>::outputwidth() const {
 	return this->_width;
 }
 
-sigmoid::size_type sigmoid::outputheight() const {
+template<typename T>
+typename basic_sigmoid<T>::size_type basic_sigmoid<T>::outputheight() const {
 	return this->_height;
 }
 
-math::matrix sigmoid::evaluate(const math::matrix& input) const {
+template<typename T>
+math::basic_matrix<T> basic_sigmoid<T>::evaluate(const matrix& input) const {
 #ifdef _DEBUG
 	if (this->inputheight() != input.height() || this->inputwidth() != input.width()) {
 		throw std::invalid_argument("input matrix is incompatible");
 	}
 #endif
 
-	return input(math::sigmoid);
+	matrix result(input.height(), input.width());
+	matrix::sigmoid(input, result, this->_mode);
+	return result;
 }
 
-std::unique_ptr<layer> sigmoid::clone() const {
-	std::unique_ptr<layer> ptr(new sigmoid(*this));
+template<typename T>
+std::unique_ptr<basic_layer<T>> basic_sigmoid<T>::clone() const {
+	std::unique_ptr<layer> ptr(new basic_sigmoid(*this));
 	return std::move(ptr);
 }
 
-void* sigmoid::allocateminibatch() const {
-	return nullptr;
+template<typename T>
+std::vector<buffershape> basic_sigmoid<T>::minibatchshapes() const {
+	return std::vector<buffershape>();
 }
 
-void sigmoid::deallocateminibatch(void* minibatchptr) const {
-	//empty virtual function
+//holds the input of the layer
+template<typename T>
+std::vector<buffershape> basic_sigmoid<T>::iterationshapes() const {
+	return std::vector<buffershape>{ { this->inputheight(), this->inputwidth() } };
 }
 
-void* sigmoid::allocateiteration() const {
-	return new math::matrix(this->inputheight(), this->inputwidth());
-}
-
-void sigmoid::deallocateiteration(void* iterationptr) const {
-	delete static_cast<math::matrix*>(iterationptr);
+template<typename T>
+void basic_sigmoid<T>::update(buffers minibatch, const basic_optimizer<T>& optimizer, buffers moments) {
+	//empty virtual function
 }
 
-void sigmoid::update(void* minibatchptr, math::num learningrate) {
+template<typename T>
+void basic_sigmoid<T>::mergeminibatch(buffers minibatch, buffers other) const {
 	//empty virtual function
 }
 
-void sigmoid::feedforward(const math::matrix& input, math::matrix& output, void* iterationptr, void* minibatchptr) const {
+template<typename T>
+void basic_sigmoid<T>::feedforward(constview input, view output, buffers iteration, buffers minibatch) const {
 #ifdef _DEBUG
 	if (this->inputheight() != input.height() || this->inputwidth() != input.width()) {
 		throw std::invalid_argument("input matrix is incompatible");
@@ -480,12 +925,12 @@ void sigmoid::feedforward(const math::matrix& input, math::matrix& output, void*
 	}
 #endif
 
-	math::matrix* itptr = static_cast<math::matrix*>(iterationptr);
-	*itptr = input;
-	math::matrix::function(math::sigmoid, input, output);
+	matrix::copy(input, iteration[0]);
+	matrix::sigmoid(input, output, this->_mode);
 }
 
-void sigmoid::backprop(const math::matrix& errorin, math::matrix& errorout, void* iterationptr, void* minibatchptr) const {
+template<typename T>
+void basic_sigmoid<T>::backprop(constview errorin, view errorout, buffers iteration, buffers minibatch) const {
 #ifdef _DEBUG
 	if (this->inputheight() != errorout.height() || this->inputwidth() != errorout.width()) {
 		throw std::invalid_argument("error out has incompatible size");
@@ -495,12 +940,53 @@ void sigmoid::backprop(const math::matrix& errorin, math::matrix& errorout, void
 	}
 #endif
 
-	math::matrix* itptr = static_cast<math::matrix*>(iterationptr);
-	math::matrix::function(math::sigmoidprime, *itptr, *itptr);
-	math::matrix::hadamard(errorin, *itptr, errorout);
+	view input = iteration[0];
+	matrix::sigmoidprime(input, input, this->_mode);
+	matrix::hadamard(errorin, input, errorout);
+}
+
+//holds the input of every sample, one per row
+template<typename T>
+std::vector<buffershape> basic_sigmoid<T>::batchshapes(size_type batchsize) const {
+	return std::vector<buffershape>{ { batchsize, this->inputheight() * this->inputwidth() } };
+}
+
+template<typename T>
+void basic_sigmoid<T>::batchfeedforward(constview input, view output, buffers batch, buffers minibatch) const {
+	view inputs = batch[0];
+
+#ifdef _DEBUG
+	if (inputs.width() != input.width() || inputs.height() != input.height()) {
+		throw std::invalid_argument("input matrix is incompatible");
+	}
+	if (output.width() != input.width() || output.height() != input.height()) {
+		throw std::invalid_argument("output matrix is incompatible");
+	}
+#endif
+
+	matrix::copy(input, inputs);
+	matrix::sigmoid(input, output, this->_mode);
+}
+
+template<typename T>
+void basic_sigmoid<T>::batchbackprop(constview errorin, view errorout, buffers batch, buffers minibatch) const {
+	view inputs = batch[0];
+
+#ifdef _DEBUG
+	if (inputs.width() != errorout.width() || inputs.height() != errorout.height()) {
+		throw std::invalid_argument("error out has incompatible size");
+	}
+	if (inputs.width() != errorin.width() || inputs.height() != errorin.height()) {
+		throw std::invalid_argument("error in has incompatible size");
+	}
+#endif
+
+	matrix::sigmoidprime(inputs, inputs, this->_mode);
+	matrix::hadamard(errorin, inputs, errorout);
 }
 
-void sigmoid::evaluate(const math::matrix& input, math::matrix& output) const {
+template<typename T>
+void basic_sigmoid<T>::evaluate(constview input, view output) const {
 #ifdef _DEBUG
 	if (this->inputheight() != input.height() || this->inputwidth() != input.width()) {
 		throw std::invalid_argument("input matrix is incompatible");
@@ -510,10 +996,36 @@ void sigmoid::evaluate(const math::matrix& input, math::matrix& output) const {
 	}
 #endif
 
-	math::matrix::function(math::sigmoid, input, output);
+	matrix::sigmoid(input, output, this->_mode);
+}
+
+template<typename T>
+void basic_sigmoid<T>::batchevaluate(constview input, view output) const {
+#ifdef _DEBUG
+	if (this->inputheight() * this->inputwidth() != input.width()) {
+		throw std::invalid_argument("input matrix is incompatible");
+	}
+	if (output.width() != input.width() || output.height() != input.height()) {
+		throw std::invalid_argument("output matrix is incompatible");
+	}
+#endif
+
+	matrix::sigmoid(input, output, this->_mode);
+}
+
+template<typename T>
+basic_weights<T>::basic_weights(size_type inputheight, size_type outputheight) : _data(outputheight, inputheight) {
+#ifdef _DEBUG
+	if (inputheight <= 0 || outputheight <= 0) {
+		throw std::invalid_argument("empty weights initalization");
+	}
+#endif
+
+	math::normalfill<T>(this->_data, 0, initialdeviation, math::nextseed());
 }
 
-weights::weights(size_type inputheight, size_type outputheight, std::function<math::num()> func) : _data(outputheight, inputheight, func) {
+template<typename T>
+basic_weights<T>::basic_weights(size_type inputheight, size_type outputheight, std::function<T()> func) : _data(outputheight, inputheight, func) {
 #ifdef _DEBUG
 	if (inputheight <= 0 || outputheight <= 0) {
 		throw std::invalid_argument("empty weights initalization");
@@ -521,23 +1033,28 @@ weights::weights(size_type inputheight, size_type outputheight, std::function<ma
 #endif
 }
 
-weights::size_type weights::inputwidth() const {
+template<typename T>
+typename basic_weights<T>::size_type basic_weights<T>::inputwidth() const {
 	return 1;
 }
 
-weights::size_type weights::inputheight() const {
+template<typename T>
+typename basic_weights<T>::size_type basic_weights<T>::inputheight() const {
 	return this->_data.width();
 }
 
-weights::size_type weights::outputwidth() const {
+template<typename T>
+typename basic_weights<T>::size_type basic_weights<T>::outputwidth() const {
 	return 1;
 }
 
-weights::size_type weights::outputheight() const {
+template<typename T>
+typename basic_weights<T>::size_type basic_weights<T>::outputheight() const {
 	return this->_data.height();
 }
 
-math::matrix weights::evaluate(const math::matrix& input) const {
+template<typename T>
+math::basic_matrix<T> basic_weights<T>::evaluate(const matrix& input) const {
 #ifdef _DEBUG 
 	if (this->inputheight() != input.height() || this->inputwidth() != input.width()) {
 		throw std::invalid_argument("input matrix is incompatible");
@@ -547,41 +1064,55 @@ math::matrix weights::evaluate(const math::matrix& input) const {
 	return this->_data * input;
 }
 
-std::unique_ptr<layer> weights::clone() const {
-	std::unique_ptr<layer> ptr(new weights(*this));
+template<typename T>
+std::unique_ptr<basic_layer<T>> basic_weights<T>::clone() const {
+	std::unique_ptr<layer> ptr(new basic_weights(*this));
 	return std::move(ptr);
 }
 
-//the first pair member holds the accumalated derivatives,
-//while the second is a buffer for backprop
-void* weights::allocateminibatch() const {
-	return new std::pair<math::matrix, math::matrix>
-	(math::matrix(this->_data.height(), this->_data.width()),
-	math::matrix(this->_data.height(), this->_data.width()));
+//holds the accumalated derivatives
+template<typename T>
+std::vector<buffershape> basic_weights<T>::minibatchshapes() const {
+	return std::vector<buffershape>{ { this->_data.height(), this->_data.width() } };
 }
 
-void weights::deallocateminibatch(void* minibatchptr) const {
-	delete static_cast<std::pair<math::matrix, math::matrix>*>(minibatchptr);
+//holds the input of the layer
+//a sparse input is passed to sparsebackprop again, so it is not kept
+template<typename T>
+std::vector<buffershape> basic_weights<T>::iterationshapes() const {
+	return std::vector<buffershape>{ { this->inputheight(), 1 } };
 }
 
-void* weights::allocateiteration() const {
-	return new math::matrix(this->inputheight(), 1);
+template<typename T>
+void basic_weights<T>::update(buffers minibatch, const basic_optimizer<T>& optimizer, buffers moments) {
+	optimizer.step(this->_data, minibatch[0], moments, typename matrix::floatview());
 }
 
-void weights::deallocateiteration(void* iterationptr) const {
-	delete static_cast<math::matrix*>(iterationptr);
+template<typename T>
+void basic_weights<T>::mergeminibatch(buffers minibatch, buffers other) const {
+	matrix::add(minibatch[0], other[0], minibatch[0]);
+	matrix::zero(other[0]);
 }
 
-void weights::update(void* minibatchptr, math::num learningrate) {
-	std::pair<math::matrix, math::matrix>* ptr = static_cast<std::pair<math::matrix, math::matrix>*>(minibatchptr);
-	math::matrix::multiply(ptr->first, -learningrate, ptr->first);
-	math::matrix::add(this->_data, ptr->first, this->_data);
-	ptr->first = math::matrix(this->_data.height(), this->_data.width());
+template<typename T>
+void basic_weights<T>::feedforward(constview input, view output, buffers iteration, buffers minibatch) const {
+#ifdef _DEBUG
+	if (this->inputheight() != input.height() || this->inputwidth() != input.width()) {
+		throw std::invalid_argument("input matrix is incompatible");
+	}
+	if (this->outputheight() != output.height() || this->outputwidth() != output.width()) {
+		throw std::invalid_argument("output matrix is incompatible");
+	}
+#endif
+
+	matrix::copy(input, iteration[0]);
+	matrix::multiply(this->_data, input, output);
 }
 
-void weights::feedforward(const math::matrix& input, math::matrix& output, void* iterationptr, void* minibatchptr) const {
+template<typename T>
+void basic_weights<T>::sparsefeedforward(sparsevector input, view output, buffers iteration, buffers minibatch) const {
 #ifdef _DEBUG
-	if (this->inputheight() != input.height() || this->inputwidth() != input.width()) {
+	if (this->inputheight() * this->inputwidth() != input.size()) {
 		throw std::invalid_argument("input matrix is incompatible");
 	}
 	if (this->outputheight() != output.height() || this->outputwidth() != output.width()) {
@@ -589,12 +1120,11 @@ void weights::feedforward(const math::matrix& input, math::matrix& output, void*
 	}
 #endif
 
-	math::matrix* itptr = static_cast<math::matrix*>(iterationptr);
-	*itptr = input;
-	math::matrix::multiply(this->_data, input, output);
+	matrix::multiply(this->_data, input, output);
 }
 
-void weights::backprop(const math::matrix& errorin, math::matrix& errorout, void* iterationptr, void* minibatchptr) const {
+template<typename T>
+void basic_weights<T>::backprop(constview errorin, view errorout, buffers iteration, buffers minibatch) const {
 #ifdef _DEBUG
 	if (this->inputheight() != errorout.height() || this->inputwidth() != errorout.width()) {
 		throw std::invalid_argument("errorout has incompatible size");
@@ -604,19 +1134,78 @@ void weights::backprop(const math::matrix& errorin, math::matrix& errorout, void
 	}
 #endif
 
-	//get our pointers
-	math::matrix* itptr = static_cast<math::matrix*>(iterationptr);
-	std::pair<math::matrix, math::matrix>* batchptr = static_cast<std::pair<math::matrix, math::matrix>*>(minibatchptr);
-	
-	//calculate the derivatives
-	math::matrix::righttransposedmultiply(errorin, *itptr, batchptr->second);
-	math::matrix::add(batchptr->second, batchptr->first, batchptr->first);
+	//accumalate the derivatives
+	matrix::addouterproduct(errorin, iteration[0], minibatch[0]);
 
 	//backprop the error
-	math::matrix::lefttransposedmultiply(this->_data, errorin, errorout);
+	matrix::lefttransposedmultiply(this->_data, errorin, errorout);
 }
 
-void weights::evaluate(const math::matrix& input, math::matrix& output) const {
+template<typename T>
+void basic_weights<T>::sparsebackprop(sparsevector input, constview errorin, view errorout, buffers iteration, buffers minibatch) const {
+#ifdef _DEBUG
+	if (this->inputheight() != errorout.height() || this->inputwidth() != errorout.width()) {
+		throw std::invalid_argument("errorout has incompatible size");
+	}
+	if (this->outputheight() != errorin.height() || this->outputwidth() != errorin.width()) {
+		throw std::invalid_argument("errorin has incompatible size");
+	}
+#endif
+
+	//accumalate the derivatives, only touching the columns of nonzero inputs
+	matrix::addouterproduct(errorin, input, minibatch[0]);
+
+	//backprop the error
+	matrix::lefttransposedmultiply(this->_data, errorin, errorout);
+}
+
+//holds the input of every sample, one per row
+template<typename T>
+std::vector<buffershape> basic_weights<T>::batchshapes(size_type batchsize) const {
+	return std::vector<buffershape>{ { batchsize, this->inputheight() } };
+}
+
+//output = input * weights^T, so every sample is multiplied exactly as feedforward multiplies it
+template<typename T>
+void basic_weights<T>::batchfeedforward(constview input, view output, buffers batch, buffers minibatch) const {
+	view inputs = batch[0];
+
+#ifdef _DEBUG
+	if (inputs.width() != input.width() || inputs.height() != input.height()) {
+		throw std::invalid_argument("input matrix is incompatible");
+	}
+	if (this->outputheight() != output.width() || inputs.height() != output.height()) {
+		throw std::invalid_argument("output matrix is incompatible");
+	}
+#endif
+
+	matrix::copy(input, inputs);
+	matrix::righttransposedmultiply(input, this->_data, output);
+}
+
+//the derivatives are errorin^T * input, a single product whose sums run over the samples in order,
+//which is the same as accumalating one outer product per sample
+template<typename T>
+void basic_weights<T>::batchbackprop(constview errorin, view errorout, buffers batch, buffers minibatch) const {
+	view inputs = batch[0];
+	view derivatives = minibatch[0];
+
+#ifdef _DEBUG
+	if (inputs.width() != errorout.width() || inputs.height() != errorout.height()) {
+		throw std::invalid_argument("errorout has incompatible size");
+	}
+	if (this->outputheight() != errorin.width() || inputs.height() != errorin.height()) {
+		throw std::invalid_argument("errorin has incompatible size");
+	}
+#endif
+
+	//the samples are added to the derivatives in order, so this matches a backprop of each sample
+	matrix::lefttransposedmultiplyadd(errorin, inputs, derivatives);
+	matrix::multiply(errorin, this->_data, errorout);
+}
+
+template<typename T>
+void basic_weights<T>::evaluate(constview input, view output) const {
 #ifdef _DEBUG
 	if (this->inputheight() != input.height() || this->inputwidth() != input.width()) {
 		throw std::invalid_argument("input matrix is incompatible");
@@ -626,10 +1215,26 @@ void weights::evaluate(const math::matrix& input, math::matrix& output) const {
 	}
 #endif
 
-	math::matrix::multiply(this->_data, input, output);
+	matrix::multiply(this->_data, input, output);
+}
+
+//output = input * weights^T, so every sample is multiplied exactly as evaluate multiplies it
+template<typename T>
+void basic_weights<T>::batchevaluate(constview input, view output) const {
+#ifdef _DEBUG
+	if (this->inputheight() != input.width()) {
+		throw std::invalid_argument("input matrix is incompatible");
+	}
+	if (this->outputheight() != output.width() || input.height() != output.height()) {
+		throw std::invalid_argument("output matrix is incompatible");
+	}
+#endif
+
+	matrix::righttransposedmultiply(input, this->_data, output);
 }
 
-biases::biases(size_type height, size_type width) : _data(height, width) {
+template<typename T>
+basic_biases<T>::basic_biases(size_type height, size_type width) : _data(height, width) {
 #ifdef _DEBUG
 	if (height <= 0 || width <= 0) {
 		throw std::invalid_argument("empty biases initalization");
@@ -637,23 +1242,28 @@ biases::biases(size_type height, size_type width) : _data(height, width) {
 #endif
 }
 
-biases::size_type biases::inputwidth() const {
+template<typename T>
+typename basic_biases<T>::size_type basic_biases<T>::inputwidth() const {
 	return this->_data.width();
 }
 
-biases::size_type biases::inputheight() const {
+template<typename T>
+typename basic_biases<T>::size_type basic_biases<T>::inputheight() const {
 	return this->_data.height();
 }
 
-biases::size_type biases::outputwidth() const {
+template<typename T>
+typename basic_biases<T>::size_type basic_biases<T>::outputwidth() const {
 	return this->_data.width();
 }
 
-biases::size_type biases::outputheight() const {
+template<typename T>
+typename basic_biases<T>::size_type basic_biases<T>::outputheight() const {
 	return this->_data.height();
 }
 
-math::matrix biases::evaluate(const math::matrix& input) const {
+template<typename T>
+math::basic_matrix<T> basic_biases<T>::evaluate(const matrix& input) const {
 #ifdef _DEBUG
 	if (input.width() != this->inputwidth() || input.height() != this->inputheight()) {
 		throw std::invalid_argument("input has incompatible size");
@@ -663,35 +1273,36 @@ math::matrix biases::evaluate(const math::matrix& input) const {
 	return input + this->_data;
 }
 
-std::unique_ptr<layer> biases::clone() const {
-	std::unique_ptr<layer> ptr(new biases(*this));
+template<typename T>
+std::unique_ptr<basic_layer<T>> basic_biases<T>::clone() const {
+	std::unique_ptr<layer> ptr(new basic_biases(*this));
 	return std::move(ptr);
 }
 
-void* biases::allocateminibatch() const {
-	return new math::matrix(this->_data.height(), this->_data.width());
+//holds the accumalated derivatives
+template<typename T>
+std::vector<buffershape> basic_biases<T>::minibatchshapes() const {
+	return std::vector<buffershape>{ { this->_data.height(), this->_data.width() } };
 }
 
-void biases::deallocateminibatch(void* minibatchptr) const {
-	delete static_cast<math::matrix*>(minibatchptr);
+template<typename T>
+std::vector<buffershape> basic_biases<T>::iterationshapes() const {
+	return std::vector<buffershape>();
 }
 
-void* biases::allocateiteration() const {
-	return nullptr;
+template<typename T>
+void basic_biases<T>::update(buffers minibatch, const basic_optimizer<T>& optimizer, buffers moments) {
+	optimizer.step(this->_data, minibatch[0], moments, typename matrix::floatview());
 }
 
-void biases::deallocateiteration(void* iterationptr) const {
-	//empty virtual function
+template<typename T>
+void basic_biases<T>::mergeminibatch(buffers minibatch, buffers other) const {
+	matrix::add(minibatch[0], other[0], minibatch[0]);
+	matrix::zero(other[0]);
 }
 
-void biases::update(void* minibatchptr, math::num learningrate) {
-	math::matrix* batchptr = static_cast<math::matrix*>(minibatchptr);
-	math::matrix::multiply(*batchptr, -learningrate, *batchptr);
-	math::matrix::add(*batchptr, this->_data, this->_data);
-	*batchptr = math::matrix(this->_data.height(), this->_data.width());
-}
-
-void biases::feedforward(const math::matrix& input, math::matrix& output, void* iterationptr, void* minibatchptr) const {
+template<typename T>
+void basic_biases<T>::feedforward(constview input, view output, buffers iteration, buffers minibatch) const {
 #ifdef _DEBUG
 	if (this->inputheight() != input.height() || this->inputwidth() != input.width()) {
 		throw std::invalid_argument("input matrix is incompatible");
@@ -701,10 +1312,11 @@ void biases::feedforward(const math::matrix& input, math::matrix& output, void*
 	}
 #endif
 
-	math::matrix::add(input, this->_data, output);
+	matrix::add(input, this->_data, output);
 }
 
-void biases::backprop(const math::matrix& errorin, math::matrix& errorout, void* iterationptr, void* minibatchptr) const {
+template<typename T>
+void basic_biases<T>::backprop(constview errorin, view errorout, buffers iteration, buffers minibatch) const {
 #ifdef _DEBUG
 	if (this->inputheight() != errorout.height() || this->inputwidth() != errorout.width()) {
 		throw std::invalid_argument("error out has incompatible size");
@@ -714,12 +1326,336 @@ void biases::backprop(const math::matrix& errorin, math::matrix& errorout, void*
 	}
 #endif
 
-	math::matrix* batchptr = static_cast<math::matrix*>(minibatchptr);
-	math::matrix::add(*batchptr, errorin, *batchptr);
-	errorout = errorin;
+	matrix::add(minibatch[0], errorin, minibatch[0]);
+	matrix::copy(errorin, errorout);
+}
+
+template<typename T>
+std::vector<buffershape> basic_biases<T>::batchshapes(size_type batchsize) const {
+	return std::vector<buffershape>();
+}
+
+template<typename T>
+void basic_biases<T>::batchfeedforward(constview input, view output, buffers batch, buffers minibatch) const {
+#ifdef _DEBUG
+	if (this->_data.size() != input.width()) {
+		throw std::invalid_argument("input matrix is incompatible");
+	}
+	if (output.width() != input.width() || output.height() != input.height()) {
+		throw std::invalid_argument("output matrix is incompatible");
+	}
+#endif
+
+	constview biases(this->_data.data(), 1, this->_data.size());
+	size_type batchsize = input.height();
+	for (size_type i = 0; i != batchsize; ++i) {
+		matrix::add(input.block(i, 0, 1, input.width()), biases, output.block(i, 0, 1, output.width()));
+	}
+}
+
+//the samples are added to the derivatives one at a time, in the same order as backprop would add them
+template<typename T>
+void basic_biases<T>::batchbackprop(constview errorin, view errorout, buffers batch, buffers minibatch) const {
+#ifdef _DEBUG
+	if (this->_data.size() != errorin.width()) {
+		throw std::invalid_argument("error in has incompatible size");
+	}
+	if (errorout.width() != errorin.width() || errorout.height() != errorin.height()) {
+		throw std::invalid_argument("error out has incompatible size");
+	}
+#endif
+
+	view derivatives(minibatch[0].data(), 1, minibatch[0].size());
+	size_type batchsize = errorin.height();
+	for (size_type i = 0; i != batchsize; ++i) {
+		matrix::add(derivatives, errorin.block(i, 0, 1, errorin.width()), derivatives);
+	}
+	matrix::copy(errorin, errorout);
+}
+
+template<typename T>
+void basic_biases<T>::evaluate(constview input, view output) const {
+#ifdef _DEBUG
+	if (this->inputheight() != input.height() || this->inputwidth() != input.width()) {
+		throw std::invalid_argument("input matrix is incompatible");
+	}
+	if (this->outputheight() != output.height() || this->outputwidth() != output.width()) {
+		throw std::invalid_argument("output matrix is incompatible");
+	}
+#endif
+
+	matrix::add(input, this->_data, output);
+}
+
+template<typename T>
+void basic_biases<T>::batchevaluate(constview input, view output) const {
+#ifdef _DEBUG
+	if (this->_data.size() != input.width()) {
+		throw std::invalid_argument("input matrix is incompatible");
+	}
+	if (output.width() != input.width() || output.height() != input.height()) {
+		throw std::invalid_argument("output matrix is incompatible");
+	}
+#endif
+
+	constview biases(this->_data.data(), 1, this->_data.size());
+	size_type batchsize = input.height();
+	for (size_type i = 0; i != batchsize; ++i) {
+		matrix::add(input.block(i, 0, 1, input.width()), biases, output.block(i, 0, 1, output.width()));
+	}
+}
+
+namespace {
+
+//the buffers of a dense layer
+//the minibatch buffers hold the accumalated derivatives of the weights and biases
+const std::size_t denseweights = 0;
+const std::size_t densebiases = 1;
+//the iteration and batch buffers hold the input and output of the layer, with a row per sample in a batch
+//the output is turned into the error before the sigmoid in place during backprop
+const std::size_t denseinput = 0;
+const std::size_t denseoutput = 1;
+
+}
+
+template<typename T>
+basic_dense<T>::basic_dense(size_type inputheight, size_type outputheight, math::accuracy mode) : _weights(outputheight, inputheight), _biases(outputheight, 1), _mode(mode) {
+#ifdef _DEBUG
+	if (inputheight <= 0 || outputheight <= 0) {
+		throw std::invalid_argument("empty dense initalization");
+	}
+#endif
+
+	math::normalfill<T>(this->_weights, 0, initialdeviation, math::nextseed());
+}
+
+template<typename T>
+basic_dense<T>::basic_dense(size_type inputheight, size_type outputheight, std::function<T()> func, math::accuracy mode) : _weights(outputheight, inputheight, func), _biases(outputheight, 1), _mode(mode) {
+#ifdef _DEBUG
+	if (inputheight <= 0 || outputheight <= 0) {
+		throw std::invalid_argument("empty dense initalization");
+	}
+#endif
+}
+
+template<typename T>
+basic_dense<T>::basic_dense(const basic_weights<T>& weights, const basic_biases<T>& biases, const basic_sigmoid<T>& sigmoid) : _weights(weights._data), _biases(biases._data), _mode(sigmoid._mode) {
+#ifdef _DEBUG
+	if (weights.outputheight() != biases.inputheight() || weights.outputwidth() != biases.inputwidth()) {
+		throw std::invalid_argument("layer sizes do not match");
+	}
+	if (biases.outputheight() != sigmoid.inputheight() || biases.outputwidth() != sigmoid.inputwidth()) {
+		throw std::invalid_argument("layer sizes do not match");
+	}
+#endif
+}
+
+template<typename T>
+typename basic_dense<T>::size_type basic_dense<T>::inputwidth() const {
+	return 1;
+}
+
+template<typename T>
+typename basic_dense<T>::size_type basic_dense<T>::inputheight() const {
+	return this->_weights.width();
+}
+
+template<typename T>
+typename basic_dense<T>::size_type basic_dense<T>::outputwidth() const {
+	return 1;
+}
+
+template<typename T>
+typename basic_dense<T>::size_type basic_dense<T>::outputheight() const {
+	return this->_weights.height();
+}
+
+template<typename T>
+math::basic_matrix<T> basic_dense<T>::evaluate(const matrix& input) const {
+#ifdef _DEBUG
+	if (this->inputheight() != input.height() || this->inputwidth() != input.width()) {
+		throw std::invalid_argument("input matrix is incompatible");
+	}
+#endif
+
+	matrix result(this->outputheight(), this->outputwidth());
+	this->evaluate(input, result);
+	return result;
+}
+
+template<typename T>
+std::unique_ptr<basic_layer<T>> basic_dense<T>::clone() const {
+	std::unique_ptr<layer> ptr(new basic_dense(*this));
+	return std::move(ptr);
+}
+
+template<typename T>
+std::vector<buffershape> basic_dense<T>::minibatchshapes() const {
+	return std::vector<buffershape>{ { this->_weights.height(), this->_weights.width() }, { this->_biases.height(), this->_biases.width() } };
+}
+
+//a sparse input is passed to sparsebackprop again, so only dense inputs are kept
+template<typename T>
+std::vector<buffershape> basic_dense<T>::iterationshapes() const {
+	return std::vector<buffershape>{ { this->inputheight(), this->inputwidth() }, { this->outputheight(), this->outputwidth() } };
+}
+
+//the same steps as the weights and biases layers, so the fused layer trains identically
+template<typename T>
+void basic_dense<T>::update(buffers minibatch, const basic_optimizer<T>& optimizer, buffers moments) {
+	size_type count = optimizer.moments();
+	optimizer.step(this->_weights, minibatch[denseweights], moments.slice(denseweights * count, count), typename matrix::floatview());
+	optimizer.step(this->_biases, minibatch[densebiases], moments.slice(densebiases * count, count), typename matrix::floatview());
+}
+
+template<typename T>
+void basic_dense<T>::mergeminibatch(buffers minibatch, buffers other) const {
+	matrix::add(minibatch[denseweights], other[denseweights], minibatch[denseweights]);
+	matrix::zero(other[denseweights]);
+	matrix::add(minibatch[densebiases], other[densebiases], minibatch[densebiases]);
+	matrix::zero(other[densebiases]);
+}
+
+template<typename T>
+void basic_dense<T>::feedforward(constview input, view output, buffers iteration, buffers minibatch) const {
+#ifdef _DEBUG
+	if (this->inputheight() != input.height() || this->inputwidth() != input.width()) {
+		throw std::invalid_argument("input matrix is incompatible");
+	}
+	if (this->outputheight() != output.height() || this->outputwidth() != output.width()) {
+		throw std::invalid_argument("output matrix is incompatible");
+	}
+#endif
+
+	matrix::copy(input, iteration[denseinput]);
+	matrix::multiply(this->_weights, input, output);
+	matrix::biasedsigmoid(output, this->_biases, output, this->_mode);
+	matrix::copy(output, iteration[denseoutput]);
+}
+
+template<typename T>
+void basic_dense<T>::sparsefeedforward(sparsevector input, view output, buffers iteration, buffers minibatch) const {
+#ifdef _DEBUG
+	if (this->inputheight() * this->inputwidth() != input.size()) {
+		throw std::invalid_argument("input matrix is incompatible");
+	}
+	if (this->outputheight() != output.height() || this->outputwidth() != output.width()) {
+		throw std::invalid_argument("output matrix is incompatible");
+	}
+#endif
+
+	matrix::multiply(this->_weights, input, output);
+	matrix::biasedsigmoid(output, this->_biases, output, this->_mode);
+	matrix::copy(output, iteration[denseoutput]);
+}
+
+template<typename T>
+void basic_dense<T>::backprop(constview errorin, view errorout, buffers iteration, buffers minibatch) const {
+#ifdef _DEBUG
+	if (this->inputheight() != errorout.height() || this->inputwidth() != errorout.width()) {
+		throw std::invalid_argument("errorout has incompatible size");
+	}
+	if (this->outputheight() != errorin.height() || this->outputwidth() != errorin.width()) {
+		throw std::invalid_argument("errorin has incompatible size");
+	}
+#endif
+
+	//find the error before the sigmoid, which is also the derivative of the biases
+	view error = iteration[denseoutput];
+	matrix::sigmoidgradient(errorin, error, error);
+	matrix::add(minibatch[densebiases], error, minibatch[densebiases]);
+
+	//accumalate the derivatives of the weights
+	matrix::addouterproduct(error, iteration[denseinput], minibatch[denseweights]);
+
+	//backprop the error
+	matrix::lefttransposedmultiply(this->_weights, error, errorout);
+}
+
+template<typename T>
+void basic_dense<T>::sparsebackprop(sparsevector input, constview errorin, view errorout, buffers iteration, buffers minibatch) const {
+#ifdef _DEBUG
+	if (this->inputheight() != errorout.height() || this->inputwidth() != errorout.width()) {
+		throw std::invalid_argument("errorout has incompatible size");
+	}
+	if (this->outputheight() != errorin.height() || this->outputwidth() != errorin.width()) {
+		throw std::invalid_argument("errorin has incompatible size");
+	}
+#endif
+
+	//find the error before the sigmoid, which is also the derivative of the biases
+	view error = iteration[denseoutput];
+	matrix::sigmoidgradient(errorin, error, error);
+	matrix::add(minibatch[densebiases], error, minibatch[densebiases]);
+
+	//accumalate the derivatives of the weights, only touching the columns of nonzero inputs
+	matrix::addouterproduct(error, input, minibatch[denseweights]);
+
+	//backprop the error
+	matrix::lefttransposedmultiply(this->_weights, error, errorout);
+}
+
+template<typename T>
+std::vector<buffershape> basic_dense<T>::batchshapes(size_type batchsize) const {
+	return std::vector<buffershape>{ { batchsize, this->inputheight() }, { batchsize, this->outputheight() } };
+}
+
+template<typename T>
+void basic_dense<T>::batchfeedforward(constview input, view output, buffers batch, buffers minibatch) const {
+	view inputs = batch[denseinput];
+	view outputs = batch[denseoutput];
+
+#ifdef _DEBUG
+	if (inputs.width() != input.width() || inputs.height() != input.height()) {
+		throw std::invalid_argument("input matrix is incompatible");
+	}
+	if (outputs.width() != output.width() || outputs.height() != output.height()) {
+		throw std::invalid_argument("output matrix is incompatible");
+	}
+#endif
+
+	matrix::copy(input, inputs);
+	matrix::righttransposedmultiply(input, this->_weights, output);
+	constview biases(this->_biases.data(), 1, this->_biases.size());
+	size_type batchsize = output.height();
+	for (size_type i = 0; i != batchsize; ++i) {
+		view row = output.block(i, 0, 1, output.width());
+		matrix::biasedsigmoid(row, biases, row, this->_mode);
+	}
+	matrix::copy(output, outputs);
 }
 
-void biases::evaluate(const math::matrix& input, math::matrix& output) const {
+template<typename T>
+void basic_dense<T>::batchbackprop(constview errorin, view errorout, buffers batch, buffers minibatch) const {
+	view inputs = batch[denseinput];
+	view errors = batch[denseoutput];
+
+#ifdef _DEBUG
+	if (inputs.width() != errorout.width() || inputs.height() != errorout.height()) {
+		throw std::invalid_argument("errorout has incompatible size");
+	}
+	if (errors.width() != errorin.width() || errors.height() != errorin.height()) {
+		throw std::invalid_argument("errorin has incompatible size");
+	}
+#endif
+
+	//find the error before the sigmoid, and add each sample to the derivatives of the biases in order
+	matrix::sigmoidgradient(errorin, errors, errors);
+	view biases(minibatch[densebiases].data(), 1, minibatch[densebiases].size());
+	size_type batchsize = errors.height();
+	for (size_type i = 0; i != batchsize; ++i) {
+		matrix::add(biases, errors.block(i, 0, 1, errors.width()), biases);
+	}
+
+	//the derivatives of the weights are a single product, added to them one sample after another, as the biases are
+	matrix::lefttransposedmultiplyadd(errors, inputs, minibatch[denseweights]);
+
+	//backprop the error
+	matrix::multiply(errors, this->_weights, errorout);
+}
+
+template<typename T>
+void basic_dense<T>::evaluate(constview input, view output) const {
 #ifdef _DEBUG
 	if (this->inputheight() != input.height() || this->inputwidth() != input.width()) {
 		throw std::invalid_argument("input matrix is incompatible");
@@ -729,7 +1665,44 @@ void biases::evaluate(const math::matrix& input, math::matrix& output) const {
 	}
 #endif
 
-	math::matrix::add(input, this->_data, output);
+	matrix::multiply(this->_weights, input, output);
+	matrix::biasedsigmoid(output, this->_biases, output, this->_mode);
 }
 
+template<typename T>
+void basic_dense<T>::batchevaluate(constview input, view output) const {
+#ifdef _DEBUG
+	if (this->inputheight() != input.width()) {
+		throw std::invalid_argument("input matrix is incompatible");
+	}
+	if (this->outputheight() != output.width() || input.height() != output.height()) {
+		throw std::invalid_argument("output matrix is incompatible");
+	}
+#endif
+
+	matrix::righttransposedmultiply(input, this->_weights, output);
+	constview biases(this->_biases.data(), 1, this->_biases.size());
+	size_type batchsize = output.height();
+	for (size_type i = 0; i != batchsize; ++i) {
+		view row = output.block(i, 0, 1, output.width());
+		matrix::biasedsigmoid(row, biases, row, this->_mode);
+	}
+}
+
+//the library is built for both single and double precision
+template class basic_data<float>;
+template class basic_data<double>;
+template class basic_layer<float>;
+template class basic_layer<double>;
+template class basic_nn<float>;
+template class basic_nn<double>;
+template class basic_sigmoid<float>;
+template class basic_sigmoid<double>;
+template class basic_weights<float>;
+template class basic_weights<double>;
+template class basic_biases<float>;
+template class basic_biases<double>;
+template class basic_dense<float>;
+template class basic_dense<double>;
+
 }
\ No newline at end of file
@@ -21,35 +21,53 @@
 #include <functional>
 
 #include "math.h"
+#include "arena.h"
+#include "optimizer.h"
 
 namespace nn {
 
 //stores the data we will use to train and test our neuralnet
-class data {
+//every sample is a row of one large input matrix and one large output matrix, which are shared between copies,
+//so shuffling or trimming a dataset only copies a list of sample positions
+template<typename T>
+class basic_data {
 public:
-	typedef std::vector<std::pair<math::matrix, math::matrix>>::size_type size_type;
+	typedef math::basic_matrix<T> matrix;
+	typedef typename matrix::constview constview;
+	typedef math::basic_sparsematrix<T> sparsematrix;
+	typedef typename matrix::sparsevector sparsevector;
+	typedef typename std::vector<typename matrix::size_type>::size_type size_type;
 
 	//initializes our data given a flag
-	data(int flag);
+	basic_data(int flag);
 
 	//returns the size of the dataset
 	size_type size() const;
 	//returns the height of the input matrix
-	math::matrix::size_type inputheight() const;
+	typename matrix::size_type inputheight() const;
 	//returns the width of the input matrix
-	math::matrix::size_type inputwidth() const;
+	typename matrix::size_type inputwidth() const;
 	//returns the height of the output matrix
-	math::matrix::size_type outputheight() const;
+	typename matrix::size_type outputheight() const;
 	//returns the width of the output matrix
-	math::matrix::size_type outputwidth() const;
+	typename matrix::size_type outputwidth() const;
 
 	//returns a copy of the dataset that has been randomly shuffled
-	data shuffle() const;
+	basic_data shuffle() const;
 	//returns a trimmed version of the dataset
-	data trim(size_type size) const;
-
-	//returns a const reference to the specified std::pair
-	const std::pair<math::matrix, math::matrix>& operator[](size_type element) const;
+	basic_data trim(size_type size) const;
+	//returns a copy of the dataset that also holds its inputs in compressed sparse rows
+	//training on it lets the first layer skip inputs that are zero, which pays off when most of them are, as in mnist
+	basic_data sparse() const;
+	//returns true if the dataset holds sparse inputs
+	bool issparse() const;
+
+	//returns views of the input and output of the specified sample
+	//the views stay valid as long as any dataset sharing this data does
+	std::pair<constview, constview> operator[](size_type element) const;
+	//returns a sparse view of the input of the specified sample, counting along its rows
+	//the dataset must hold sparse inputs
+	sparsevector sparseinput(size_type element) const;
 
 	//common dataset flags
 	enum datasets {
@@ -60,24 +78,70 @@ public:
 	};
 
 private:
-	std::vector<std::pair<math::matrix, math::matrix>> _data;
+	//the samples of a dataset, one per row, along with the shapes they are viewed as
+	struct samples {
+		matrix inputs;
+		matrix outputs;
+		typename matrix::size_type inputheight;
+		typename matrix::size_type inputwidth;
+		typename matrix::size_type outputheight;
+		typename matrix::size_type outputwidth;
+	};
+
+	std::shared_ptr<const samples> _samples;
+	//the inputs of _samples in sparse form, or null if they have not been built
+	std::shared_ptr<const sparsematrix> _sparse;
+	//the rows of _samples that make up this dataset, in order
+	std::vector<typename matrix::size_type> _order;
 
-	//initializes a dataset given a vector of matrix pairs
-	data(std::vector<std::pair<math::matrix, math::matrix>> data);
+	//initializes a dataset given shared samples, their sparse inputs, and the rows to use
+	basic_data(std::shared_ptr<const samples> data, std::shared_ptr<const sparsematrix> sparse, std::vector<typename matrix::size_type> order);
 
 	//returns the mnist test data
-	static std::vector<std::pair<math::matrix, math::matrix>> mnisttestload();
+	static std::shared_ptr<const samples> mnisttestload();
 	//returns the mnist training data
-	static std::vector<std::pair<math::matrix, math::matrix>> mnisttrainload();
+	static std::shared_ptr<const samples> mnisttrainload();
 	//returns a randomly generated set of XOR's
-	static std::vector<std::pair<math::matrix, math::matrix>> generateXOR();
+	static std::shared_ptr<const samples> generateXOR();
 };
 
+//how training splits the work of a minibatch across threads
+enum parallelism {
+	//each minibatch is trained as a whole, and only large matrix products are split across threads
+	//the updates are the same as training a sample at a time
+	ordered,
+	//each minibatch is split into a shard per thread, and every shard is trained at once on its own memory
+	//the derivatives of the shards are then summed with a tree reduction, so the updates can differ from ordered
+	//in the last bits, but are the same on every run with the same number of threads
+	dataparallel,
+	//each thread trains whole minibatches, and applies its updates to the neuralnet as soon as they are found,
+	//without waiting for the other threads or taking a lock, as in hogwild (Niu et al, 2011)
+	//the parameters are written without synchronisation, so updates can overwrite each other and results change from run to run
+	//this suits large layers, where threads rarely touch the same parameters at once
+	asynchronous,
+};
+
+template<typename T>
+class basic_nn;
+template<typename T>
+class basic_dense;
+template<typename T>
+class basic_quantizednn;
+template<typename T>
+class basic_mixedtrainer;
+
 //abstract base layer class
-class layer {
+template<typename T>
+class basic_layer {
 public:
-	typedef math::matrix::size_type size_type;
-	friend class nn;
+	typedef math::basic_matrix<T> matrix;
+	typedef typename matrix::view view;
+	typedef typename matrix::constview constview;
+	typedef typename matrix::sparsevector sparsevector;
+	typedef typename matrix::size_type size_type;
+	typedef basic_buffers<T> buffers;
+	template<typename> friend class basic_nn;
+	template<typename> friend class basic_quantizednn;
 
 	//returns the input width of the layer
 	virtual size_type inputwidth() const = 0;
@@ -89,75 +153,158 @@ public:
 	virtual size_type outputheight() const = 0;
 
 	//evaluates the output of a layer
-	virtual math::matrix evaluate(const math::matrix& input) const = 0;
+	virtual matrix evaluate(const matrix& input) const = 0;
+	//evaluates the output of a layer, and writes that output to a buffer
+	//this does not allocate, so with fixed size matricies a layer can be evaluated without touching the heap
+	virtual void evaluate(constview input, view output) const = 0;
+	//evaluates the output of a layer for many samples at once, and writes that output to a buffer
+	//each sample is a row of the input and output, holding the elements of the sample counted along its rows
+	//every sample gives the same output as evaluate. by default each sample is passed to evaluate in turn
+	virtual void batchevaluate(constview input, view output) const;
+
+	virtual ~basic_layer() {}
 
 protected:
 	//returns a pointer to a dynamically allocated copy of the object
-	virtual std::unique_ptr<layer> clone() const = 0;
-	//dynamically allocates any memory the layer needs within a minibatch
-	virtual void* allocateminibatch() const = 0;
-	//deallocates this memory
-	virtual void deallocateminibatch(void* minibatchptr) const = 0;
-	//dynamically allocates any memory the layer needs within a training iteration
-	virtual void* allocateiteration() const = 0;
-	//deallocates this memory
-	virtual void deallocateiteration(void* iterationptr) const = 0;
-
-	//updates our neuralnet given a pointer to the data accumalated over the minibatch, and a learning rate
-	virtual void update(void* minibatchptr, math::num learningrate) = 0;
+	virtual std::unique_ptr<basic_layer> clone() const = 0;
+	//lists the buffers the layer keeps for a whole minibatch, such as its accumalated derivatives
+	//they start as zero, and must be left as zero by update and mergeminibatch
+	virtual std::vector<buffershape> minibatchshapes() const = 0;
+	//lists the buffers the layer needs from the feedforward of a sample to its backprop
+	virtual std::vector<buffershape> iterationshapes() const = 0;
+
+	//updates our neuralnet given the buffers accumalated over the minibatch, by passing every parameter to a step of an optimizer,
+	//along with its derivatives and the moments the optimizer keeps for it
+	//the moments of the parameter that the i-th minibatch buffer holds the derivatives of start at i * optimizer.moments()
+	virtual void update(buffers minibatch, const basic_optimizer<T>& optimizer, buffers moments) = 0;
+	//adds the derivatives held in other minibatch buffers to these, and clears the others
+	virtual void mergeminibatch(buffers minibatch, buffers other) const = 0;
 	//evaluates the output of a layer, and prepares for a backprop
-	virtual void feedforward(const math::matrix& input, math::matrix& output, void* iterationptr, void* minibatchptr) const = 0;
+	virtual void feedforward(constview input, view output, buffers iteration, buffers minibatch) const = 0;
+	//evaluates the output of a layer given a sparse input, and prepares for a sparsebackprop
+	//by default the input is expanded, and passed to feedforward. layers that can skip the zeros override this
+	virtual void sparsefeedforward(sparsevector input, view output, buffers iteration, buffers minibatch) const;
 	//backpropagates the error through our network, and prepares for an update
-	virtual void backprop(const math::matrix& errorin, math::matrix& errorout, void* iterationptr, void* minibatchptr) const = 0;
-	//evaluates the output of a layer, and writes that output to a buffer
-	virtual void evaluate(const math::matrix& input, math::matrix& output) const = 0;
+	virtual void backprop(constview errorin, view errorout, buffers iteration, buffers minibatch) const = 0;
+	//backpropagates the error of a sample that was fed forward with sparsefeedforward, given the same sparse input again
+	//by default this calls backprop. layers that override sparsefeedforward use the input here instead of keeping it
+	virtual void sparsebackprop(sparsevector input, constview errorin, view errorout, buffers iteration, buffers minibatch) const;
+
+	//lists the buffers the layer needs from the batchfeedforward of a minibatch to its batchbackprop
+	//by default this is the iteration buffers of every sample, one sample after another
+	virtual std::vector<buffershape> batchshapes(size_type batchsize) const;
+	//evaluates the output of a layer for every sample of a minibatch, and prepares for a backprop
+	//each sample is a row of the input and output, holding the elements of the sample counted along its rows
+	//by default each sample is passed to feedforward in turn. layers that can use matrix-matrix products override this
+	virtual void batchfeedforward(constview input, view output, buffers batch, buffers minibatch) const;
+	//backpropagates the error of every sample of a minibatch through our network, and prepares for an update
+	//it is called once between updates, and must accumulate the same derivatives as calling backprop on each sample in order
+	virtual void batchbackprop(constview errorin, view errorout, buffers batch, buffers minibatch) const;
 };
 
 //neuralnet class: interface for our layer classes
-class nn {
+template<typename T>
+class basic_nn {
 public:
-	typedef std::vector<std::unique_ptr<layer>>::size_type size_type;
+	typedef math::basic_matrix<T> matrix;
+	typedef typename matrix::view view;
+	typedef typename matrix::constview constview;
+	typedef basic_layer<T> layer;
+	typedef basic_data<T> data;
+	typedef typename std::vector<std::unique_ptr<layer>>::size_type size_type;
 
 	//initializes a neural network with an initializer list of layers
-	nn(std::initializer_list<layer*> layers);
+	basic_nn(std::initializer_list<layer*> layers);
 
 	//returns the number of layers in the neuralnet
 	size_type size() const;
+	//returns the specified layer
+	//a trained neuralnet can be evaluated one layer at a time into preallocated buffers, such as fixed size matricies
+	const layer& operator[](size_type element) const;
 
 	//evaluates the output of the neuralnet
-	math::matrix evaluate(const math::matrix& input) const;
-	//trains the neuralnet given learning data, learning rate, and a batchsize
+	//this allocates in every layer, so to evaluate many times, use a session, which keeps its buffers between calls
+	matrix evaluate(const matrix& input) const;
+	//evaluates the output of the neuralnet for many samples at once, and writes those outputs to a buffer
+	//each sample is a row of the inputs and outputs, holding the elements of the sample counted along its rows
+	//the buffers between the layers are allocated on every call, so to evaluate many batches, use a session
+	void batchevaluate(constview inputs, view outputs) const;
+	//trains the neuralnet given learning data, learning rate, a batchsize, and how the minibatches are split across threads
+	//each minibatch is packed into one matrix with a sample per row, so the layers run matrix-matrix products
+	//datasets holding sparse inputs are still trained a sample at a time, so the first layer can skip the zeros
+	//a nonzero checkpoint splits the layers into segments of that many layers, and only keeps the input of each segment through the feedforward,
+	//running the segment again during backprop to refill the buffers of its layers, which trades about one more feedforward for less memory
+	//the last segment is never run again, and sparse datasets ignore the checkpoint, as their buffers only hold one sample
+	//the updates are the same with or without a checkpoint
 	//is threadsafe
-	void train(const data& learningdata, math::num learningrate, data::size_type batchsize);
+	void train(const data& learningdata, T learningrate, typename data::size_type batchsize, parallelism mode = ordered, size_type checkpoint = 0);
+	//trains the neuralnet as above, with the updates made by an optimizer, such as momentum or adam, instead of a learning rate
+	//the optimizer keeps its moments between calls, so it should be passed to every call that trains this neuralnet
+	void train(const data& learningdata, basic_optimizer<T>& optimizer, typename data::size_type batchsize, parallelism mode = ordered, size_type checkpoint = 0);
 	//returns the number of successfully evaluated matricies from a data set
 	//the second argument is a function that takes the real output and the nn output
 	//and returns true if the output is deemed "correct",
 	//as well as a buffer the size of the output matrix that can be written into if needs be
-	data::size_type test(const data& input, std::function<bool(const math::matrix& correct, const math::matrix& output, math::matrix& buffer)> compare) const;
+	//the samples are evaluated in chunks, with a sample per row, and the chunks are split across threads
+	//compare is called from many threads at once, so it must be threadsafe
+	typename data::size_type test(const data& input, std::function<bool(constview correct, constview output, view buffer)> compare) const;
 	//returns the average cost over a dataset
-	math::num cost(const data& input, std::function<math::num(const math::matrix& correct, const math::matrix& output)> cost);
+	//the costs are summed within each chunk, then across the chunks in order, so the result does not depend on the thread count
+	//cost is called from many threads at once, so it must be threadsafe
+	T cost(const data& input, std::function<T(constview correct, constview output)> cost);
+
+	//replaces every weights, biases and sigmoid layer in a row with a single dense layer
+	//the neuralnet gives the same results afterwards, but trains and evaluates faster
+	void fuse();
 
 private:
+	template<typename> friend class basic_mixedtrainer;
+
 	std::vector<std::unique_ptr<layer>> _data;
 
-	//updates all the layers in a neuralnet
-	void update(const std::vector<void*>& minibatch, math::num learningrate);
-
-	//dynamically allocates any memory the layers need within a minibatch
-	std::vector<void*> allocateminibatch() const;
-	//deallocates this memory
-	void deallocateminibatch(const std::vector<void*>& minibatchptr) const;
-	//dynamically allocates any memory the layers need within a training iteration
-	std::vector<void*> allocateiteration() const;
-	//deallocates this memory
-	void deallocateiteration(const std::vector<void*>& iterationptr) const;
+	//the memory used to train on one shard of a minibatch
+	struct workspace;
+
+	//initializes a neuralnet that takes ownership of a list of layers, whose sizes must already match
+	basic_nn(std::vector<std::unique_ptr<layer>> layers);
+
+	//evaluates every sample of a dataset in chunks, and passes each output to visit along with the number of its chunk
+	//the chunks are spread across threads, and each thread has its own buffers, including one the size of an output for visit to use
+	void evaluatechunks(const data& input, std::function<void(size_type chunk, typename data::size_type sample, constview output, view buffer)> visit) const;
+
+	//feeds a shard of samples forward and backprops them, accumalating their derivatives in a workspace
+	void trainshard(const data& learningdata, typename data::size_type first, workspace& work) const;
+	//sums the derivatives held in every workspace into the first
+	void reduce(std::vector<workspace>& workspaces) const;
+	//trains on a dataset a minibatch at a time, in ordered or dataparallel mode, and passes the summed derivatives of each minibatch to update
+	//the error of the output is multiplied by a loss scale before backprop, and update returns the loss scale for the next minibatch
+	//update must leave the derivatives as zero
+	void trainsynchronous(const data& learningdata, typename data::size_type batchsize, parallelism mode, size_type checkpoint, T lossscale, std::function<T(const std::vector<basic_buffers<T>>& minibatch)> update);
+	//trains on a dataset with each thread taking the next minibatch, and updating as soon as it is done
+	void trainasynchronous(const data& learningdata, basic_optimizer<T>& optimizer, const std::vector<basic_buffers<T>>& moments, typename data::size_type batchsize, size_type checkpoint);
+	//updates all the layers in a neuralnet with an optimizer, given the moments it keeps for each layer
+	void update(const std::vector<basic_buffers<T>>& minibatch, basic_optimizer<T>& optimizer, const std::vector<basic_buffers<T>>& moments);
+	//lists the minibatch buffers of every layer
+	std::vector<std::vector<buffershape>> minibatchshapes() const;
+
+	//plans the memory used to train on a shard of a given number of samples, and allocates it in a single arena
+	workspace allocateworkspace(const data& learningdata, typename data::size_type samples, size_type checkpoint) const;
 };
 
 //this layer applies the sigmoid activation function
-class sigmoid : public layer {
+template<typename T>
+class basic_sigmoid : public basic_layer<T> {
 public:
+	typedef math::basic_matrix<T> matrix;
+	typedef typename matrix::view view;
+	typedef typename matrix::constview constview;
+	typedef basic_layer<T> layer;
+	typedef typename layer::size_type size_type;
+	typedef typename layer::buffers buffers;
+
 	//initializes a sigmoid layer with a height and width
-	sigmoid(size_type height, size_type width);
+	//approximate mode trades a small, bounded error for a much cheaper activation, see math::accuracy
+	basic_sigmoid(size_type height, size_type width, math::accuracy mode = math::exact);
 
 	//returns the input width of the layer
 	virtual size_type inputwidth() const;
@@ -169,40 +316,62 @@ public:
 	virtual size_type outputheight() const;
 
 	//evaluates the output of a layer
-	virtual math::matrix evaluate(const math::matrix& input) const;
+	virtual matrix evaluate(const matrix& input) const;
+	//evaluates the output of a layer, and writes that output to a buffer
+	virtual void evaluate(constview input, view output) const;
+	//evaluates the output of a layer for many samples at once, and writes that output to a buffer
+	virtual void batchevaluate(constview input, view output) const;
 
 protected:
 	//returns a pointer to a dynamically allocated copy of the object
 	virtual std::unique_ptr<layer> clone() const;
-	//dynamically allocates any memory the layer needs within a minibatch
-	virtual void* allocateminibatch() const;
-	//deallocates this memory
-	virtual void deallocateminibatch(void* minibatchptr) const;
-	//dynamically allocates any memory the layer needs within a training iteration
-	virtual void* allocateiteration() const;
-	//deallocates this memory
-	virtual void deallocateiteration(void* iterationptr) const;
-
-	//updates our neuralnet given a pointer to the data accumalated over the minibatch, and a learning rate
-	virtual void update(void* minibatchptr, math::num learningrate);
+	//lists the buffers the layer keeps for a whole minibatch
+	virtual std::vector<buffershape> minibatchshapes() const;
+	//lists the buffers the layer needs from the feedforward of a sample to its backprop
+	virtual std::vector<buffershape> iterationshapes() const;
+
+	//updates our neuralnet given the buffers accumalated over the minibatch, and an optimizer
+	virtual void update(buffers minibatch, const basic_optimizer<T>& optimizer, buffers moments);
+	//adds the derivatives held in other minibatch buffers to these, and clears the others
+	virtual void mergeminibatch(buffers minibatch, buffers other) const;
 	//evaluates the output of a layer, and prepares for a backprop
-	virtual void feedforward(const math::matrix& input, math::matrix& output, void* iterationptr, void* minibatchptr) const;
+	virtual void feedforward(constview input, view output, buffers iteration, buffers minibatch) const;
 	//backpropagates the error through our network, and prepares for an update
-	virtual void backprop(const math::matrix& errorin, math::matrix& errorout, void* iterationptr, void* minibatchptr) const;
-	//evaluates the output of a layer, and writes that output to a buffer
-	virtual void evaluate(const math::matrix& input, math::matrix& output) const;
+	virtual void backprop(constview errorin, view errorout, buffers iteration, buffers minibatch) const;
+	//lists the buffers the layer needs from the batchfeedforward of a minibatch to its batchbackprop
+	virtual std::vector<buffershape> batchshapes(size_type batchsize) const;
+	//evaluates the output of a layer for every sample of a minibatch, and prepares for a backprop
+	virtual void batchfeedforward(constview input, view output, buffers batch, buffers minibatch) const;
+	//backpropagates the error of every sample of a minibatch through our network, and prepares for an update
+	virtual void batchbackprop(constview errorin, view errorout, buffers batch, buffers minibatch) const;
 
 private:
+	template<typename> friend class basic_dense;
+	template<typename> friend class basic_mixedtrainer;
+
 	size_type _height;
 	size_type _width;
+	math::accuracy _mode;
 };
 
 //this layer applies a weights matrix
-class weights : public layer {
+template<typename T>
+class basic_weights : public basic_layer<T> {
 public:
+	typedef math::basic_matrix<T> matrix;
+	typedef typename matrix::view view;
+	typedef typename matrix::constview constview;
+	typedef typename matrix::sparsevector sparsevector;
+	typedef basic_layer<T> layer;
+	typedef typename layer::size_type size_type;
+	typedef typename layer::buffers buffers;
+
+	//initializes a weights layer with an input size and output size
+	//the weights are drawn from the same distribution as math::standarddist, filled in parallel from a seed given by math::nextseed
+	basic_weights(size_type inputheight, size_type outputheight);
 	//initializes a weights layer with an input size, output size, and a function
 	//this function determines how the weights matrix will be filled
-	weights(size_type inputheight, size_type outputheight, std::function<math::num()> func = math::standarddist);
+	basic_weights(size_type inputheight, size_type outputheight, std::function<T()> func);
 
 	//returns the input width of the layer
 	virtual size_type inputwidth() const;
@@ -214,38 +383,60 @@ public:
 	virtual size_type outputheight() const;
 
 	//evaluates the output of a layer
-	virtual math::matrix evaluate(const math::matrix& input) const;
+	virtual matrix evaluate(const matrix& input) const;
+	//evaluates the output of a layer, and writes that output to a buffer
+	virtual void evaluate(constview input, view output) const;
+	//evaluates the output of a layer for many samples at once, and writes that output to a buffer
+	virtual void batchevaluate(constview input, view output) const;
 
 protected:
 	//returns a pointer to a dynamically allocated copy of the object
 	virtual std::unique_ptr<layer> clone() const;
-	//dynamically allocates any memory the layer needs within a minibatch
-	virtual void* allocateminibatch() const;
-	//deallocates this memory
-	virtual void deallocateminibatch(void* minibatchptr) const;
-	//dynamically allocates any memory the layer needs within a training iteration
-	virtual void* allocateiteration() const;
-	//deallocates this memory
-	virtual void deallocateiteration(void* iterationptr) const;
-
-	//updates our neuralnet given a pointer to the data accumalated over the minibatch, and a learning rate
-	virtual void update(void* minibatchptr, math::num learningrate);
+	//lists the buffers the layer keeps for a whole minibatch
+	virtual std::vector<buffershape> minibatchshapes() const;
+	//lists the buffers the layer needs from the feedforward of a sample to its backprop
+	virtual std::vector<buffershape> iterationshapes() const;
+
+	//updates our neuralnet given the buffers accumalated over the minibatch, and an optimizer
+	virtual void update(buffers minibatch, const basic_optimizer<T>& optimizer, buffers moments);
+	//adds the derivatives held in other minibatch buffers to these, and clears the others
+	virtual void mergeminibatch(buffers minibatch, buffers other) const;
 	//evaluates the output of a layer, and prepares for a backprop
-	virtual void feedforward(const math::matrix& input, math::matrix& output, void* iterationptr, void* minibatchptr) const;
+	virtual void feedforward(constview input, view output, buffers iteration, buffers minibatch) const;
+	//evaluates the output of a layer given a sparse input, and prepares for a sparsebackprop that only touches the columns of nonzero inputs
+	virtual void sparsefeedforward(sparsevector input, view output, buffers iteration, buffers minibatch) const;
 	//backpropagates the error through our network, and prepares for an update
-	virtual void backprop(const math::matrix& errorin, math::matrix& errorout, void* iterationptr, void* minibatchptr) const;
-	//evaluates the output of a layer, and writes that output to a buffer
-	virtual void evaluate(const math::matrix& input, math::matrix& output) const;
+	virtual void backprop(constview errorin, view errorout, buffers iteration, buffers minibatch) const;
+	//backpropagates the error of a sample that was fed forward with sparsefeedforward
+	virtual void sparsebackprop(sparsevector input, constview errorin, view errorout, buffers iteration, buffers minibatch) const;
+	//lists the buffers the layer needs from the batchfeedforward of a minibatch to its batchbackprop
+	virtual std::vector<buffershape> batchshapes(size_type batchsize) const;
+	//evaluates the output of a layer for every sample of a minibatch, and prepares for a backprop
+	virtual void batchfeedforward(constview input, view output, buffers batch, buffers minibatch) const;
+	//backpropagates the error of every sample of a minibatch through our network, and prepares for an update
+	virtual void batchbackprop(constview errorin, view errorout, buffers batch, buffers minibatch) const;
 
 private:
-	math::matrix _data;
+	template<typename> friend class basic_dense;
+	template<typename> friend class basic_quantizednn;
+	template<typename> friend class basic_mixedtrainer;
+
+	matrix _data;
 };
 
 //this layer applies a bias matrix
-class biases : public layer {
+template<typename T>
+class basic_biases : public basic_layer<T> {
 public:
+	typedef math::basic_matrix<T> matrix;
+	typedef typename matrix::view view;
+	typedef typename matrix::constview constview;
+	typedef basic_layer<T> layer;
+	typedef typename layer::size_type size_type;
+	typedef typename layer::buffers buffers;
+
 	//initializes a sigmoid layer with a height and width
-	biases(size_type height, size_type width);
+	basic_biases(size_type height, size_type width);
 
 	//returns the input width of the layer
 	virtual size_type inputwidth() const;
@@ -257,33 +448,125 @@ public:
 	virtual size_type outputheight() const;
 
 	//evaluates the output of a layer
-	virtual math::matrix evaluate(const math::matrix& input) const;
+	virtual matrix evaluate(const matrix& input) const;
+	//evaluates the output of a layer, and writes that output to a buffer
+	virtual void evaluate(constview input, view output) const;
+	//evaluates the output of a layer for many samples at once, and writes that output to a buffer
+	virtual void batchevaluate(constview input, view output) const;
 
 protected:
 	//returns a pointer to a dynamically allocated copy of the object
 	virtual std::unique_ptr<layer> clone() const;
-	//dynamically allocates any memory the layer needs within a minibatch
-	virtual void* allocateminibatch() const;
-	//deallocates this memory
-	virtual void deallocateminibatch(void* minibatchptr) const;
-	//dynamically allocates any memory the layer needs within a training iteration
-	virtual void* allocateiteration() const;
-	//deallocates this memory
-	virtual void deallocateiteration(void* iterationptr) const;
-
-	//updates our neuralnet given a pointer to the data accumalated over the minibatch, and a learning rate
-	virtual void update(void* minibatchptr, math::num learningrate);
+	//lists the buffers the layer keeps for a whole minibatch
+	virtual std::vector<buffershape> minibatchshapes() const;
+	//lists the buffers the layer needs from the feedforward of a sample to its backprop
+	virtual std::vector<buffershape> iterationshapes() const;
+
+	//updates our neuralnet given the buffers accumalated over the minibatch, and an optimizer
+	virtual void update(buffers minibatch, const basic_optimizer<T>& optimizer, buffers moments);
+	//adds the derivatives held in other minibatch buffers to these, and clears the others
+	virtual void mergeminibatch(buffers minibatch, buffers other) const;
 	//evaluates the output of a layer, and prepares for a backprop
-	virtual void feedforward(const math::matrix& input, math::matrix& output, void* iterationptr, void* minibatchptr) const;
+	virtual void feedforward(constview input, view output, buffers iteration, buffers minibatch) const;
 	//backpropagates the error through our network, and prepares for an update
-	virtual void backprop(const math::matrix& errorin, math::matrix& errorout, void* iterationptr, void* minibatchptr) const;
+	virtual void backprop(constview errorin, view errorout, buffers iteration, buffers minibatch) const;
+	//lists the buffers the layer needs from the batchfeedforward of a minibatch to its batchbackprop
+	virtual std::vector<buffershape> batchshapes(size_type batchsize) const;
+	//evaluates the output of a layer for every sample of a minibatch, and prepares for a backprop
+	virtual void batchfeedforward(constview input, view output, buffers batch, buffers minibatch) const;
+	//backpropagates the error of every sample of a minibatch through our network, and prepares for an update
+	virtual void batchbackprop(constview errorin, view errorout, buffers batch, buffers minibatch) const;
+
+private:
+	template<typename> friend class basic_dense;
+	template<typename> friend class basic_mixedtrainer;
+
+	matrix _data;
+};
+
+//this layer applies a weights matrix, a bias and the sigmoid function in one step
+//it gives the same results as a weights, biases and sigmoid layer in a row, without the extra passes over memory
+template<typename T>
+class basic_dense : public basic_layer<T> {
+public:
+	typedef math::basic_matrix<T> matrix;
+	typedef typename matrix::view view;
+	typedef typename matrix::constview constview;
+	typedef typename matrix::sparsevector sparsevector;
+	typedef basic_layer<T> layer;
+	typedef typename layer::size_type size_type;
+	typedef typename layer::buffers buffers;
+
+	//initializes a dense layer with an input size, output size, and the accuracy of the sigmoid function
+	//the weights are filled in the same way as the weights layer
+	basic_dense(size_type inputheight, size_type outputheight, math::accuracy mode = math::exact);
+	//initializes a dense layer with an input size, output size, a function that fills the weights matrix,
+	//and the accuracy of the sigmoid function
+	basic_dense(size_type inputheight, size_type outputheight, std::function<T()> func, math::accuracy mode = math::exact);
+	//initializes a dense layer with copies of the parameters of a weights, biases and sigmoid layer
+	basic_dense(const basic_weights<T>& weights, const basic_biases<T>& biases, const basic_sigmoid<T>& sigmoid);
+
+	//returns the input width of the layer
+	virtual size_type inputwidth() const;
+	//returns the input height of the layer
+	virtual size_type inputheight() const;
+	//returns the output width of the layer
+	virtual size_type outputwidth() const;
+	//returns the output height of the layer
+	virtual size_type outputheight() const;
+
+	//evaluates the output of a layer
+	virtual matrix evaluate(const matrix& input) const;
 	//evaluates the output of a layer, and writes that output to a buffer
-	virtual void evaluate(const math::matrix& input, math::matrix& output) const;
+	virtual void evaluate(constview input, view output) const;
+	//evaluates the output of a layer for many samples at once, and writes that output to a buffer
+	virtual void batchevaluate(constview input, view output) const;
+
+protected:
+	//returns a pointer to a dynamically allocated copy of the object
+	virtual std::unique_ptr<layer> clone() const;
+	//lists the buffers the layer keeps for a whole minibatch
+	virtual std::vector<buffershape> minibatchshapes() const;
+	//lists the buffers the layer needs from the feedforward of a sample to its backprop
+	virtual std::vector<buffershape> iterationshapes() const;
+
+	//updates our neuralnet given the buffers accumalated over the minibatch, and an optimizer
+	virtual void update(buffers minibatch, const basic_optimizer<T>& optimizer, buffers moments);
+	//adds the derivatives held in other minibatch buffers to these, and clears the others
+	virtual void mergeminibatch(buffers minibatch, buffers other) const;
+	//evaluates the output of a layer, and prepares for a backprop
+	virtual void feedforward(constview input, view output, buffers iteration, buffers minibatch) const;
+	//evaluates the output of a layer given a sparse input, and prepares for a sparsebackprop that only touches the columns of nonzero inputs
+	virtual void sparsefeedforward(sparsevector input, view output, buffers iteration, buffers minibatch) const;
+	//backpropagates the error through our network, and prepares for an update
+	virtual void backprop(constview errorin, view errorout, buffers iteration, buffers minibatch) const;
+	//backpropagates the error of a sample that was fed forward with sparsefeedforward
+	virtual void sparsebackprop(sparsevector input, constview errorin, view errorout, buffers iteration, buffers minibatch) const;
+	//lists the buffers the layer needs from the batchfeedforward of a minibatch to its batchbackprop
+	virtual std::vector<buffershape> batchshapes(size_type batchsize) const;
+	//evaluates the output of a layer for every sample of a minibatch, and prepares for a backprop
+	virtual void batchfeedforward(constview input, view output, buffers batch, buffers minibatch) const;
+	//backpropagates the error of every sample of a minibatch through our network, and prepares for an update
+	virtual void batchbackprop(constview errorin, view errorout, buffers batch, buffers minibatch) const;
 
 private:
-	math::matrix _data;
+	template<typename> friend class basic_quantizednn;
+	template<typename> friend class basic_mixedtrainer;
+
+	matrix _weights;
+	matrix _biases;
+	math::accuracy _mode;
 };
 
+//the library defaults to math::num precision
+typedef basic_data<math::num> data;
+typedef basic_layer<math::num> layer;
+typedef basic_nn<math::num> nn;
+typedef basic_sigmoid<math::num> sigmoid;
+typedef basic_weights<math::num> weights;
+typedef basic_biases<math::num> biases;
+typedef basic_dense<math::num> dense;
+
 }
 
 #endif
\ No newline at end of file
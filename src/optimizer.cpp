@@ -0,0 +1,150 @@
+//Copyright 2017 Jakob Wyatt
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http ://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#include "optimizer.h"
+
+#include <stdexcept>
+#include <vector>
+#include <cmath>
+
+#include "math.h"
+#include "arena.h"
+
+namespace nn {
+
+template<typename T>
+basic_optimizer<T>::basic_optimizer() : _updates(0), _bound(false) {
+
+}
+
+template<typename T>
+typename basic_optimizer<T>::size_type basic_optimizer<T>::updates() const {
+	return this->_updates.load(std::memory_order_relaxed);
+}
+
+//the moments live for the whole of training, so they are placed in an arena with a single step, and none of them share memory
+template<typename T>
+const std::vector<typename basic_optimizer<T>::buffers>& basic_optimizer<T>::bind(const std::vector<std::vector<buffershape>>& shapes) {
+	if (this->_bound) {
+		bool same = shapes.size() == this->_shapes.size();
+		for (size_type i = 0; same && i != shapes.size(); ++i) {
+			same = shapes[i].size() == this->_shapes[i].size();
+			for (size_type j = 0; same && j != shapes[i].size(); ++j) {
+				same = shapes[i][j].height == this->_shapes[i][j].height && shapes[i][j].width == this->_shapes[i][j].width;
+			}
+		}
+		if (!same) {
+			throw std::invalid_argument("optimizer was used with a different neuralnet");
+		}
+		return this->_layers;
+	}
+
+	size_type count = this->moments();
+	std::vector<typename basic_arena<T>::handle> handles;
+	std::vector<size_type> sizes;
+	handles.reserve(shapes.size());
+	sizes.reserve(shapes.size());
+	for (const std::vector<buffershape>& layer : shapes) {
+		std::vector<buffershape> layermoments;
+		for (const buffershape& shape : layer) {
+			layermoments.insert(layermoments.end(), count, shape);
+		}
+		handles.push_back(this->_moments.reserve(layermoments, 0, 0));
+		sizes.push_back(layermoments.size());
+	}
+	this->_moments.allocate();
+	for (size_type i = 0; i != shapes.size(); ++i) {
+		this->_layers.push_back(this->_moments.group(handles[i], sizes[i]));
+	}
+	this->_shapes = shapes;
+	this->_bound = true;
+	return this->_layers;
+}
+
+template<typename T>
+void basic_optimizer<T>::advance() {
+	this->_updates.fetch_add(1, std::memory_order_relaxed);
+}
+
+template<typename T>
+basic_sgd<T>::basic_sgd(T learningrate) : _learningrate(learningrate) {
+
+}
+
+template<typename T>
+typename basic_sgd<T>::size_type basic_sgd<T>::moments() const {
+	return 0;
+}
+
+template<typename T>
+void basic_sgd<T>::step(view parameters, view derivatives, buffers moments, floatview copy) const {
+	math::basic_matrix<T>::sgdstep(parameters, derivatives, this->_learningrate, copy);
+}
+
+template<typename T>
+basic_momentum<T>::basic_momentum(T learningrate, T momentum) : _learningrate(learningrate), _momentum(momentum) {
+
+}
+
+template<typename T>
+typename basic_momentum<T>::size_type basic_momentum<T>::moments() const {
+	return 1;
+}
+
+template<typename T>
+void basic_momentum<T>::step(view parameters, view derivatives, buffers moments, floatview copy) const {
+	math::basic_matrix<T>::momentumstep(parameters, derivatives, moments[0], this->_learningrate, this->_momentum, copy);
+}
+
+template<typename T>
+basic_nesterov<T>::basic_nesterov(T learningrate, T momentum) : basic_momentum<T>(learningrate, momentum) {
+
+}
+
+template<typename T>
+void basic_nesterov<T>::step(view parameters, view derivatives, buffers moments, floatview copy) const {
+	math::basic_matrix<T>::nesterovstep(parameters, derivatives, moments[0], this->_learningrate, this->_momentum, copy);
+}
+
+template<typename T>
+basic_adam<T>::basic_adam(T learningrate, T beta1, T beta2, T epsilon) : _learningrate(learningrate), _beta1(beta1), _beta2(beta2), _epsilon(epsilon) {
+
+}
+
+template<typename T>
+typename basic_adam<T>::size_type basic_adam<T>::moments() const {
+	return 2;
+}
+
+//during asynchronous training the count can move on while a step is running, which only changes the bias correction slightly
+template<typename T>
+void basic_adam<T>::step(view parameters, view derivatives, buffers moments, floatview copy) const {
+	T count = static_cast<T>(this->updates());
+	T stepsize = this->_learningrate * std::sqrt(1 - std::pow(this->_beta2, count)) / (1 - std::pow(this->_beta1, count));
+	math::basic_matrix<T>::adamstep(parameters, derivatives, moments[0], moments[1], stepsize, this->_beta1, this->_beta2, this->_epsilon, copy);
+}
+
+//the library is built for both single and double precision
+template class basic_optimizer<float>;
+template class basic_optimizer<double>;
+template class basic_sgd<float>;
+template class basic_sgd<double>;
+template class basic_momentum<float>;
+template class basic_momentum<double>;
+template class basic_nesterov<float>;
+template class basic_nesterov<double>;
+template class basic_adam<float>;
+template class basic_adam<double>;
+
+}
@@ -0,0 +1,181 @@
+//Copyright 2017 Jakob Wyatt
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http ://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#ifndef GUARD_OPTIMIZER_H
+#define GUARD_OPTIMIZER_H
+
+#include <cstddef>
+#include <vector>
+#include <atomic>
+
+#include "math.h"
+#include "arena.h"
+
+//optimizers turn the derivatives accumalated over a minibatch into updates of the parameters
+//each step is a single fused pass, which updates the parameters and the moments kept for them, and sets the derivatives to zero
+//mixed precision training also has the step round the new parameters into its single precision copy of them, in the same pass
+namespace nn {
+
+template<typename T>
+class basic_nn;
+template<typename T>
+class basic_mixedtrainer;
+
+//base optimizer class
+//an optimizer keeps its moments for the neuralnet it was first used to train, so every neuralnet needs its own optimizer
+//the moments are kept between calls to train, so training can be continued with the same optimizer
+template<typename T>
+class basic_optimizer {
+public:
+	typedef math::basic_matrix<T> matrix;
+	typedef typename matrix::view view;
+	typedef typename matrix::floatview floatview;
+	typedef basic_buffers<T> buffers;
+	typedef std::size_t size_type;
+	template<typename> friend class basic_nn;
+	template<typename> friend class basic_mixedtrainer;
+
+	//initializes an optimizer with no moments
+	basic_optimizer();
+	basic_optimizer(const basic_optimizer&) = delete;
+	basic_optimizer& operator=(const basic_optimizer&) = delete;
+	virtual ~basic_optimizer() {}
+
+	//returns the number of buffers, each the size of a parameter, kept for every parameter between updates
+	virtual size_type moments() const = 0;
+	//applies the derivatives of a parameter to it, updates the moments of that parameter, and sets the derivatives to zero
+	//if copy is not empty, the new parameters are also rounded to single precision and written to it
+	//is called from many threads at once, on different parameters, and during asynchronous training, on the same parameters
+	virtual void step(view parameters, view derivatives, buffers moments, floatview copy) const = 0;
+
+	//returns the number of updates made so far
+	size_type updates() const;
+
+private:
+	//allocates the moments of every layer the first time it is called, starting as zero, and returns the moments of each layer
+	//shapes holds the minibatch buffers of each layer, and each of them gets moments() buffers of the same shape, one after another
+	//throws if the optimizer was used with a different neuralnet
+	const std::vector<buffers>& bind(const std::vector<std::vector<buffershape>>& shapes);
+	//counts an update of the whole neuralnet, before any of its steps
+	void advance();
+
+	std::atomic<size_type> _updates;
+	basic_arena<T> _moments;
+	std::vector<std::vector<buffershape>> _shapes;
+	std::vector<buffers> _layers;
+	bool _bound;
+};
+
+//stochastic gradient descent, which keeps no moments
+//this gives exactly the same updates as training with a learning rate
+template<typename T>
+class basic_sgd : public basic_optimizer<T> {
+public:
+	typedef basic_optimizer<T> optimizer;
+	typedef typename optimizer::view view;
+	typedef typename optimizer::floatview floatview;
+	typedef typename optimizer::buffers buffers;
+	typedef typename optimizer::size_type size_type;
+
+	//initializes the optimizer with a learning rate
+	basic_sgd(T learningrate);
+
+	//returns the number of buffers kept for every parameter
+	virtual size_type moments() const;
+	//applies the derivatives of a parameter to it, and sets the derivatives to zero
+	virtual void step(view parameters, view derivatives, buffers moments, floatview copy) const;
+
+private:
+	T _learningrate;
+};
+
+//gradient descent with momentum, which keeps a velocity for every parameter
+//the velocity is a decaying sum of the past steps, so the updates speed up along directions the derivatives agree on
+template<typename T>
+class basic_momentum : public basic_optimizer<T> {
+public:
+	typedef basic_optimizer<T> optimizer;
+	typedef typename optimizer::view view;
+	typedef typename optimizer::floatview floatview;
+	typedef typename optimizer::buffers buffers;
+	typedef typename optimizer::size_type size_type;
+
+	//initializes the optimizer with a learning rate, and the fraction of the velocity kept after each update
+	basic_momentum(T learningrate, T momentum = 0.9);
+
+	//returns the number of buffers kept for every parameter
+	virtual size_type moments() const;
+	//applies the derivatives of a parameter to it, updates its velocity, and sets the derivatives to zero
+	virtual void step(view parameters, view derivatives, buffers moments, floatview copy) const;
+
+protected:
+	T _learningrate;
+	T _momentum;
+};
+
+//nesterov accelerated gradient, which steps from where the velocity is about to take the parameters
+//this uses the reformulation of Sutskever et al (2013), so only the velocity is kept and no extra feedforward is needed
+template<typename T>
+class basic_nesterov : public basic_momentum<T> {
+public:
+	typedef basic_optimizer<T> optimizer;
+	typedef typename optimizer::view view;
+	typedef typename optimizer::floatview floatview;
+	typedef typename optimizer::buffers buffers;
+	typedef typename optimizer::size_type size_type;
+
+	//initializes the optimizer with a learning rate, and the fraction of the velocity kept after each update
+	basic_nesterov(T learningrate, T momentum = 0.9);
+
+	//applies the derivatives of a parameter to it, updates its velocity, and sets the derivatives to zero
+	virtual void step(view parameters, view derivatives, buffers moments, floatview copy) const;
+};
+
+//adam (Kingma and Ba, 2014), which keeps moving averages of the derivatives and of their squares,
+//and scales the step of every parameter by them
+//the bias correction is folded into the step size, as in the paper, so it costs nothing per element
+template<typename T>
+class basic_adam : public basic_optimizer<T> {
+public:
+	typedef basic_optimizer<T> optimizer;
+	typedef typename optimizer::view view;
+	typedef typename optimizer::floatview floatview;
+	typedef typename optimizer::buffers buffers;
+	typedef typename optimizer::size_type size_type;
+
+	//initializes the optimizer with a learning rate, the decay rates of the two averages, and a small value that keeps the steps finite
+	basic_adam(T learningrate = 0.001, T beta1 = 0.9, T beta2 = 0.999, T epsilon = 1e-8);
+
+	//returns the number of buffers kept for every parameter
+	virtual size_type moments() const;
+	//applies the derivatives of a parameter to it, updates both averages, and sets the derivatives to zero
+	virtual void step(view parameters, view derivatives, buffers moments, floatview copy) const;
+
+private:
+	T _learningrate;
+	T _beta1;
+	T _beta2;
+	T _epsilon;
+};
+
+//the library defaults to math::num precision
+typedef basic_optimizer<math::num> optimizer;
+typedef basic_sgd<math::num> sgd;
+typedef basic_momentum<math::num> momentum;
+typedef basic_nesterov<math::num> nesterov;
+typedef basic_adam<math::num> adam;
+
+}
+
+#endif
@@ -0,0 +1,431 @@
+//Copyright 2017 Jakob Wyatt
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http ://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#include "quantized.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <memory>
+#include <stdexcept>
+#include <algorithm>
+#include <functional>
+
+#include "math.h"
+#include "gemm.h"
+#include "nn.h"
+#include "session.h"
+#include "threads.h"
+
+//we will only error-check if the project is in debug mode
+//we use the _DEBUG macro to check for this
+namespace nn {
+
+namespace {
+
+//int8 values are kept in [-127, 127], so the range is symmetric around zero
+const int quantizedmax = 127;
+
+//number of samples evaluated at once by test, cost and compare
+//the chunks do not depend on the thread count, so neither do the sums over them
+const std::size_t evaluationchunk = 256;
+
+//returns the scale that maps [-range, range] onto the int8 range
+template<typename T>
+T scalefor(T range) {
+	return range > 0 ? range / quantizedmax : 1;
+}
+
+//rounds a value to the nearest int8, saturating values outside the range
+template<typename T>
+std::int8_t quantize(T value) {
+	T rounded = std::nearbyint(value);
+	rounded = std::min(std::max(rounded, static_cast<T>(-quantizedmax)), static_cast<T>(quantizedmax));
+	return static_cast<std::int8_t>(rounded);
+}
+
+}
+
+template<typename T>
+basic_quantizednn<T>::basic_quantizednn(const nn& network, const data& calibration) : _steps() {
+#ifdef _DEBUG
+	if (network[0].inputheight() != calibration.inputheight() || network[0].inputwidth() != calibration.inputwidth()) {
+		throw std::invalid_argument("calibration data is incompatible");
+	}
+#endif
+
+	//quantize the weights, one scale per row
+	size_type nnsize = network.size();
+	for (size_type i = 0; i != nnsize; ++i) {
+		step current;
+		current.dense = false;
+		current.inputscale = 1;
+		current.rows = 0;
+		current.columns = 0;
+
+		const matrix* weights = nullptr;
+		if (const basic_weights<T>* layer = dynamic_cast<const basic_weights<T>*>(&network[i])) {
+			weights = &layer->_data;
+		} else if (const basic_dense<T>* layer = dynamic_cast<const basic_dense<T>*>(&network[i])) {
+			weights = &layer->_weights;
+			current.dense = true;
+			current.biases = layer->_biases;
+			current.mode = layer->_mode;
+		} else {
+			current.original = network[i].clone();
+		}
+
+		if (weights != nullptr) {
+			current.rows = weights->height();
+			current.columns = weights->width();
+			current.weights.resize(weights->size());
+			current.rowscales.resize(current.rows);
+			for (size_type row = 0; row != current.rows; ++row) {
+				const T* values = weights->data() + row * current.columns;
+				T range = 0;
+				for (size_type column = 0; column != current.columns; ++column) {
+					range = std::max(range, std::abs(values[column]));
+				}
+				T scale = scalefor(range);
+				current.rowscales[row] = scale;
+				for (size_type column = 0; column != current.columns; ++column) {
+					current.weights[row * current.columns + column] = quantize(values[column] / scale);
+				}
+			}
+		}
+		this->_steps.push_back(std::move(current));
+	}
+
+	//measure the range of the input of every quantized step, by running the original neuralnet
+	std::vector<T> ranges(nnsize, 0);
+	std::vector<matrix> outputs;
+	for (size_type i = 0; i != nnsize; ++i) {
+		outputs.push_back(matrix(network[i].outputheight(), network[i].outputwidth()));
+	}
+	for (typename data::size_type i = 0; i != calibration.size(); ++i) {
+		constview input = calibration[i].first;
+		for (size_type j = 0; j != nnsize; ++j) {
+			if (this->_steps[j].original == nullptr) {
+				for (size_type k = 0; k != input.height(); ++k) {
+					for (size_type l = 0; l != input.width(); ++l) {
+						ranges[j] = std::max(ranges[j], std::abs(input(k, l)));
+					}
+				}
+			}
+			network[j].evaluate(input, outputs[j]);
+			input = outputs[j];
+		}
+	}
+
+	for (size_type i = 0; i != nnsize; ++i) {
+		step& current = this->_steps[i];
+		if (current.original == nullptr) {
+			current.inputscale = scalefor(ranges[i]);
+			current.outputscales.resize(current.rows);
+			for (size_type row = 0; row != current.rows; ++row) {
+				current.outputscales[row] = current.rowscales[row] * current.inputscale;
+			}
+		}
+	}
+}
+
+template<typename T>
+typename basic_quantizednn<T>::size_type basic_quantizednn<T>::size() const {
+	return this->_steps.size();
+}
+
+template<typename T>
+math::basic_matrix<T> basic_quantizednn<T>::evaluate(const matrix& input) const {
+#ifdef _DEBUG
+	if (input.size() != this->inputsize()) {
+		throw std::invalid_argument("input matrix is incompatible");
+	}
+#endif
+
+	const step& last = this->_steps.back();
+	buffers& buffer = this->prepare(1);
+	constview output = this->batchevaluate(constview(input.data(), 1, input.size()), buffer);
+	return matrix(constview(output.data(), outputheight(last), outputwidth(last)));
+}
+
+//the inputs and outputs are walked a chunk of rows at a time, and the last chunk may be short
+template<typename T>
+void basic_quantizednn<T>::batchevaluate(constview inputs, view outputs) const {
+#ifdef _DEBUG
+	const step& last = this->_steps.back();
+	if (inputs.width() != this->inputsize()) {
+		throw std::invalid_argument("input matrix is incompatible");
+	}
+	if (outputs.width() != outputheight(last) * outputwidth(last) || outputs.height() != inputs.height()) {
+		throw std::invalid_argument("output matrix is incompatible");
+	}
+#endif
+
+	buffers& buffer = this->prepare(evaluationchunk);
+	size_type samples = inputs.height();
+	for (size_type begin = 0; begin < samples; begin += evaluationchunk) {
+		size_type rows = std::min(evaluationchunk, samples - begin);
+		matrix::copy(this->batchevaluate(inputs.block(begin, 0, rows, inputs.width()), buffer), outputs.block(begin, 0, rows, outputs.width()));
+	}
+}
+
+template<typename T>
+typename basic_data<T>::size_type basic_quantizednn<T>::test(const data& input, std::function<bool(constview, constview, view)> compare) const {
+	//each chunk counts its own samples, so no two threads write to the same count
+	std::vector<typename data::size_type> chunkcorrect((input.size() + evaluationchunk - 1) / evaluationchunk, 0);
+	this->evaluatechunks(input, [&](size_type chunk, typename data::size_type sample, constview output, view buffer) {
+		if (compare(input[sample].second, output, buffer)) {
+			++chunkcorrect[chunk];
+		}
+	});
+
+	typename data::size_type numcorrect = 0;
+	for (typename data::size_type count : chunkcorrect) {
+		numcorrect += count;
+	}
+	return numcorrect;
+}
+
+template<typename T>
+T basic_quantizednn<T>::cost(const data& input, std::function<T(constview, constview)> cost) const {
+	//the samples of a chunk are visited in order by one thread, so each chunk sum is always added up the same way
+	std::vector<T> chunkcost((input.size() + evaluationchunk - 1) / evaluationchunk, 0);
+	this->evaluatechunks(input, [&](size_type chunk, typename data::size_type sample, constview output, view) {
+		chunkcost[chunk] += cost(input[sample].second, output);
+	});
+
+	T costsum = 0;
+	for (T sum : chunkcost) {
+		costsum += sum;
+	}
+	return costsum / input.size();
+}
+
+//both neuralnets evaluate the same chunks of samples in batches
+template<typename T>
+typename basic_quantizednn<T>::report basic_quantizednn<T>::compare(const nn& original, const data& input, std::function<bool(constview, constview, view)> compare) const {
+#ifdef _DEBUG
+	if (original.size() != this->size()) {
+		throw std::invalid_argument("neuralnet was not the source of this quantized neuralnet");
+	}
+#endif
+
+	report result;
+	result.samples = input.size();
+	result.originalcorrect = 0;
+	result.quantizedcorrect = 0;
+	result.maxdifference = 0;
+	result.originalbytes = 0;
+	result.quantizedbytes = this->weightbytes();
+
+	size_type nnsize = original.size();
+	for (size_type i = 0; i != nnsize; ++i) {
+		if (this->_steps[i].original == nullptr) {
+			result.originalbytes += this->_steps[i].weights.size() * sizeof(T);
+		}
+	}
+
+	typename data::size_type datasize = input.size();
+	typename matrix::size_type inputheight = input.inputheight();
+	typename matrix::size_type inputwidth = input.inputwidth();
+	typename matrix::size_type outputheight = input.outputheight();
+	typename matrix::size_type outputwidth = input.outputwidth();
+
+	buffers& buffer = this->prepare(evaluationchunk);
+	view inputs(buffer.inputs.data(), evaluationchunk, inputheight * inputwidth);
+	view resultbuffer(buffer.result.data(), outputheight, outputwidth);
+	basic_session<T> evaluator(original, evaluationchunk);
+	matrix outputs(evaluationchunk, outputheight * outputwidth);
+
+	for (typename data::size_type first = 0; first < datasize; first += evaluationchunk) {
+		typename data::size_type rows = std::min<typename data::size_type>(evaluationchunk, datasize - first);
+		for (typename data::size_type j = 0; j != rows; ++j) {
+			matrix::copy(input[first + j].first, view(inputs.data() + j * inputs.stride(), inputheight, inputwidth));
+		}
+		constview batch = inputs.block(0, 0, rows, inputs.width());
+		evaluator.batchevaluate(batch, view(outputs).block(0, 0, rows, outputs.width()));
+		constview quantized = this->batchevaluate(batch, buffer);
+
+		for (typename data::size_type j = 0; j != rows; ++j) {
+			constview correct = input[first + j].second;
+			constview originalrow(outputs.data() + j * outputs.width(), outputheight, outputwidth);
+			constview quantizedrow(quantized.data() + j * quantized.stride(), outputheight, outputwidth);
+			if (compare(correct, originalrow, resultbuffer)) {
+				++result.originalcorrect;
+			}
+			if (compare(correct, quantizedrow, resultbuffer)) {
+				++result.quantizedcorrect;
+			}
+			for (typename matrix::size_type k = 0; k != outputheight * outputwidth; ++k) {
+				result.maxdifference = std::max(result.maxdifference, std::abs(quantizedrow.data()[k] - originalrow.data()[k]));
+			}
+		}
+	}
+
+	return result;
+}
+
+template<typename T>
+std::size_t basic_quantizednn<T>::weightbytes() const {
+	std::size_t result = 0;
+	for (const step& current : this->_steps) {
+		result += current.weights.size() * sizeof(std::int8_t) + current.outputscales.size() * sizeof(T);
+	}
+	return result;
+}
+
+template<typename T>
+typename basic_quantizednn<T>::buffers& basic_quantizednn<T>::prepare(size_type batchsize) const {
+	//the buffers are shared by every quantized neuralnet the thread evaluates, and resized for each
+	thread_local buffers result;
+
+	size_type largestoutput = 0;
+	size_type largest = 0;
+	for (const step& current : this->_steps) {
+		largestoutput = std::max(largestoutput, outputheight(current) * outputwidth(current));
+		largest = std::max(largest, std::max(current.rows, current.columns));
+	}
+	const step& last = this->_steps.back();
+	result.outputs.resize(2 * batchsize * largestoutput);
+	result.inputs.resize(batchsize * this->inputsize());
+	result.input.resize(batchsize * largest);
+	result.sums.resize(batchsize * largest);
+	result.result.resize(outputheight(last) * outputwidth(last));
+	return result;
+}
+
+template<typename T>
+typename basic_quantizednn<T>::size_type basic_quantizednn<T>::inputsize() const {
+	const step& first = this->_steps.front();
+	if (first.original != nullptr) {
+		return first.original->inputheight() * first.original->inputwidth();
+	}
+	return first.columns;
+}
+
+template<typename T>
+typename basic_quantizednn<T>::size_type basic_quantizednn<T>::outputheight(const step& current) {
+	return current.original != nullptr ? current.original->outputheight() : current.rows;
+}
+
+template<typename T>
+typename basic_quantizednn<T>::size_type basic_quantizednn<T>::outputwidth(const step& current) {
+	return current.original != nullptr ? current.original->outputwidth() : 1;
+}
+
+//the output of each step is a view into one half of the output buffers, and its input is the other half
+template<typename T>
+typename basic_quantizednn<T>::constview basic_quantizednn<T>::batchevaluate(constview inputs, buffers& buffer) const {
+	size_type rows = inputs.height();
+	size_type half = buffer.outputs.size() / 2;
+	size_type nnsize = this->size();
+	for (size_type i = 0; i != nnsize; ++i) {
+		const step& current = this->_steps[i];
+		view output(buffer.outputs.data() + (i % 2) * half, rows, outputheight(current) * outputwidth(current));
+		if (current.original != nullptr) {
+			current.original->batchevaluate(inputs, output);
+		} else {
+			this->batchevaluate(current, inputs, output, buffer);
+		}
+		inputs = output;
+	}
+	return inputs;
+}
+
+//the batch of quantized inputs is multiplied by the transposed weights, so each sample is still a dot product with every row
+template<typename T>
+void basic_quantizednn<T>::batchevaluate(const step& current, constview inputs, view outputs, buffers& buffer) const {
+#ifdef _DEBUG
+	if (inputs.width() != current.columns) {
+		throw std::invalid_argument("input matrix is incompatible");
+	}
+	if (outputs.width() != current.rows || outputs.height() != inputs.height()) {
+		throw std::invalid_argument("output matrix is incompatible");
+	}
+#endif
+
+	size_type samples = inputs.height();
+	T inverse = 1 / current.inputscale;
+	for (size_type i = 0; i != samples; ++i) {
+		const T* row = inputs.data() + i * inputs.stride();
+		std::int8_t* quantized = buffer.input.data() + i * current.columns;
+		for (size_type j = 0; j != current.columns; ++j) {
+			quantized[j] = quantize(row[j] * inverse);
+		}
+	}
+
+	math::gemm(true, samples, current.rows, current.columns, buffer.input.data(), current.columns, current.weights.data(), current.columns, buffer.sums.data(), current.rows);
+
+	constview biases(current.biases.data(), 1, current.rows);
+	for (size_type i = 0; i != samples; ++i) {
+		const std::int32_t* sums = buffer.sums.data() + i * current.rows;
+		T* row = outputs.data() + i * outputs.stride();
+		for (size_type j = 0; j != current.rows; ++j) {
+			row[j] = static_cast<T>(sums[j]) * current.outputscales[j];
+		}
+		if (current.dense) {
+			view output = outputs.block(i, 0, 1, current.rows);
+			matrix::biasedsigmoid(output, biases, output, current.mode);
+		}
+	}
+}
+
+//each thread copies the inputs of a chunk into rows of its buffers, and runs them through the neuralnet at once
+//the last chunk may be short, so only the rows it fills are evaluated
+template<typename T>
+void basic_quantizednn<T>::evaluatechunks(const data& input, std::function<void(size_type, typename data::size_type, constview, view)> visit) const {
+#ifdef _DEBUG
+	const step& last = this->_steps.back();
+	if (input.inputheight() * input.inputwidth() != this->inputsize()) {
+		throw std::invalid_argument("input data is incompatible");
+	}
+	if (input.outputheight() * input.outputwidth() != outputheight(last) * outputwidth(last)) {
+		throw std::invalid_argument("output data is incompatible");
+	}
+#endif
+
+	typename data::size_type datasize = input.size();
+	typename data::size_type chunks = (datasize + evaluationchunk - 1) / evaluationchunk;
+	typename matrix::size_type inputheight = input.inputheight();
+	typename matrix::size_type inputwidth = input.inputwidth();
+	typename matrix::size_type outputheight = input.outputheight();
+	typename matrix::size_type outputwidth = input.outputwidth();
+
+	math::parallelfor(chunks, 1, [&](std::size_t begin, std::size_t end) {
+		buffers& buffer = this->prepare(evaluationchunk);
+		view inputs(buffer.inputs.data(), evaluationchunk, inputheight * inputwidth);
+		view resultbuffer(buffer.result.data(), outputheight, outputwidth);
+
+		for (std::size_t i = begin; i != end; ++i) {
+			typename data::size_type first = i * evaluationchunk;
+			typename data::size_type rows = std::min<typename data::size_type>(evaluationchunk, datasize - first);
+			for (typename data::size_type j = 0; j != rows; ++j) {
+				matrix::copy(input[first + j].first, view(inputs.data() + j * inputs.stride(), inputheight, inputwidth));
+			}
+			constview outputs = this->batchevaluate(constview(inputs).block(0, 0, rows, inputs.width()), buffer);
+			for (typename data::size_type j = 0; j != rows; ++j) {
+				visit(i, first + j, constview(outputs.data() + j * outputs.stride(), outputheight, outputwidth), resultbuffer);
+			}
+		}
+	});
+}
+
+//the library is built for both single and double precision
+template struct basic_quantizationreport<float>;
+template struct basic_quantizationreport<double>;
+template class basic_quantizednn<float>;
+template class basic_quantizednn<double>;
+
+}
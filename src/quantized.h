@@ -0,0 +1,149 @@
+//Copyright 2017 Jakob Wyatt
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http ://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#ifndef GUARD_QUANTIZED_H
+#define GUARD_QUANTIZED_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <functional>
+
+#include "math.h"
+#include "nn.h"
+
+//int8 inference copies of trained neuralnets
+//every weights matrix is stored as int8 with one scale per row, and the input of each weights matrix is
+//quantized to int8 with a single scale, found by calibrating on sample data
+//the products are summed exactly in 32 bit integers, then scaled back to floating point,
+//so biases and activations still run at full precision
+namespace nn {
+
+//the result of comparing a quantized neuralnet against the neuralnet it was built from
+template<typename T>
+struct basic_quantizationreport {
+	//the number of samples compared
+	std::size_t samples;
+	//the number of samples the original neuralnet evaluated correctly
+	std::size_t originalcorrect;
+	//the number of samples the quantized neuralnet evaluated correctly
+	std::size_t quantizedcorrect;
+	//the largest difference between any element of the two outputs
+	T maxdifference;
+	//the memory used by the weights of each neuralnet, in bytes
+	std::size_t originalbytes;
+	std::size_t quantizedbytes;
+};
+
+//evaluation only neuralnet with int8 weights
+template<typename T>
+class basic_quantizednn {
+public:
+	typedef math::basic_matrix<T> matrix;
+	typedef typename matrix::view view;
+	typedef typename matrix::constview constview;
+	typedef basic_layer<T> layer;
+	typedef basic_data<T> data;
+	typedef basic_nn<T> nn;
+	typedef std::size_t size_type;
+	typedef basic_quantizationreport<T> report;
+
+	//quantizes a trained neuralnet
+	//the range of the input of each weights matrix is measured over the calibration data,
+	//which should be a few hundred samples drawn like the data the neuralnet will see
+	basic_quantizednn(const nn& network, const data& calibration);
+
+	//returns the number of layers in the neuralnet
+	size_type size() const;
+
+	//evaluates the output of the neuralnet
+	matrix evaluate(const matrix& input) const;
+	//evaluates the output of the neuralnet for many samples, and writes those outputs to a buffer
+	//each sample is a row of the inputs and outputs, holding the elements of the sample counted along its rows
+	//every step runs on the whole batch at once, and gives the same output as evaluating each sample on its own
+	void batchevaluate(constview inputs, view outputs) const;
+	//returns the number of successfully evaluated matricies from a data set, see nn::test
+	//samples are evaluated in batches, split across threads
+	typename data::size_type test(const data& input, std::function<bool(constview correct, constview output, view buffer)> compare) const;
+	//returns the average cost over a dataset, see nn::cost
+	T cost(const data& input, std::function<T(constview correct, constview output)> cost) const;
+
+	//compares this neuralnet against the neuralnet it was built from over a dataset
+	report compare(const nn& original, const data& input, std::function<bool(constview correct, constview output, view buffer)> compare) const;
+	//returns the memory used by the quantized weights and their scales, in bytes
+	std::size_t weightbytes() const;
+
+private:
+	//a single step of the neuralnet
+	//weights and dense layers become quantized steps, and every other layer is kept as a copy
+	struct step {
+		//the weights, one row per output
+		std::vector<std::int8_t> weights;
+		size_type rows;
+		size_type columns;
+		//the scale of each row of weights
+		std::vector<T> rowscales;
+		//the scale of the input, found by calibration
+		T inputscale;
+		//rowscales multiplied by inputscale, which turn the integer sums back into floating point
+		std::vector<T> outputscales;
+		//the biases and activation of a dense layer, which are applied after the weights
+		bool dense;
+		matrix biases;
+		math::accuracy mode;
+		//the layer used by unquantized steps, or null
+		std::shared_ptr<const layer> original;
+	};
+
+	//buffers used while evaluating, with a row per sample of a batch
+	//each thread keeps its own, and they only grow, so evaluating many times does not touch the heap
+	struct buffers {
+		//the outputs of the steps, in two halves that consecutive steps take turns writing to
+		std::vector<T> outputs;
+		//the samples of a batch, copied out of a dataset
+		std::vector<T> inputs;
+		//the quantized input of a step
+		std::vector<std::int8_t> input;
+		//the integer sums of a step
+		std::vector<std::int32_t> sums;
+		//the buffer handed to compare functions
+		std::vector<T> result;
+	};
+
+	std::vector<step> _steps;
+
+	//returns the buffers of the calling thread, sized to evaluate up to batchsize samples at once
+	buffers& prepare(size_type batchsize) const;
+	//returns the number of elements in the input of a sample
+	size_type inputsize() const;
+	//returns the shape of the output of a step
+	static size_type outputheight(const step& current);
+	static size_type outputwidth(const step& current);
+
+	//evaluates a batch of samples, and returns a view of the outputs held in the buffers
+	constview batchevaluate(constview inputs, buffers& buffer) const;
+	//evaluates a quantized step on a batch of samples
+	void batchevaluate(const step& current, constview inputs, view outputs, buffers& buffer) const;
+	//evaluates a dataset in fixed size chunks, split across threads, and calls visit with the output of every sample
+	//visit is called with the chunk the sample belongs to, the position of the sample, its output, and a buffer the shape of the output
+	void evaluatechunks(const data& input, std::function<void(size_type chunk, typename data::size_type sample, constview output, view buffer)> visit) const;
+};
+
+typedef basic_quantizationreport<math::num> quantizationreport;
+typedef basic_quantizednn<math::num> quantizednn;
+
+}
+
+#endif
@@ -0,0 +1,226 @@
+//Copyright 2017 Jakob Wyatt
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http ://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#include "random.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <atomic>
+#include <array>
+#include <random>
+#include <functional>
+
+#include "math.h"
+#include "threads.h"
+
+namespace math {
+
+namespace {
+
+//philox multipliers and key increments, from Salmon et al, "Parallel random numbers: as easy as 1, 2, 3"
+const std::uint32_t multiplier0 = 0xD2511F53;
+const std::uint32_t multiplier1 = 0xCD9E8D57;
+const std::uint32_t increment0 = 0x9E3779B9;
+const std::uint32_t increment1 = 0xBB67AE85;
+const int rounds = 10;
+
+//smallest number of elements handed to a thread by the fills, a multiple of the four numbers in a block
+const std::size_t fillgrain = 1 << 12;
+
+//splitmix64 finalizer, which spreads every input bit across the output
+std::uint64_t mix(std::uint64_t value) {
+	value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+	value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+	return value ^ (value >> 31);
+}
+
+//the library seed, and the number of seeds handed out since it was set
+//generation changes whenever the seed is set, so per thread generators know to reseed
+//this is a function local static so random numbers can safely be used during static initialization
+struct state {
+	std::atomic<std::uint64_t> seed;
+	std::atomic<std::uint64_t> count;
+	std::atomic<std::uint64_t> generation;
+
+	state() : seed(initialseed()), count(0), generation(0) {
+
+	}
+
+	//returns the seed asked for by the environment, or a random one
+	static std::uint64_t initialseed() {
+		const char* value = std::getenv("MATH_SEED");
+		if (value != nullptr) {
+			return std::strtoull(value, nullptr, 10);
+		}
+		std::random_device device;
+		return (static_cast<std::uint64_t>(device()) << 32) ^ device();
+	}
+};
+
+state& shared() {
+	static state* value = new state;
+	return *value;
+}
+
+//returns a uniform double in (0, 1], built from two numbers so it has the full 53 bits
+double uniform(std::uint32_t high, std::uint32_t low) {
+	std::uint64_t bits = ((static_cast<std::uint64_t>(high) << 32) | low) >> 11;
+	return (static_cast<double>(bits) + 1) * (1.0 / 9007199254740992.0);
+}
+
+//the generator used by standarddist and bernoullidist on this thread
+//it is seeded the first time it is used, and again whenever the library seed changes
+philox& threadengine() {
+	thread_local philox engine;
+	thread_local std::uint64_t generation = 0;
+	thread_local bool seeded = false;
+	std::uint64_t current = shared().generation.load();
+	if (!seeded || generation != current) {
+		engine = philox(nextseed());
+		generation = current;
+		seeded = true;
+	}
+	return engine;
+}
+
+}
+
+philox::philox(std::uint64_t seed, std::uint64_t stream) : _seed(seed), _stream(stream), _position(0), _block(), _index(4) {
+
+}
+
+philox::result_type philox::operator()() {
+	if (this->_index == 4) {
+		this->_block = block(this->_seed, this->_stream, this->_position);
+		++this->_position;
+		this->_index = 0;
+	}
+	return this->_block[this->_index++];
+}
+
+void philox::discard(std::uint64_t count) {
+	while (count != 0 && this->_index != 4) {
+		++this->_index;
+		--count;
+	}
+	this->_position += count / 4;
+	count %= 4;
+	if (count != 0) {
+		this->_block = block(this->_seed, this->_stream, this->_position);
+		++this->_position;
+		this->_index = count;
+	}
+}
+
+//the counter holds the position in its low half and the stream in its high half, and the key is the seed
+philox::block_type philox::block(std::uint64_t seed, std::uint64_t stream, std::uint64_t position) {
+	std::uint32_t counter[4] = { static_cast<std::uint32_t>(position), static_cast<std::uint32_t>(position >> 32),
+		static_cast<std::uint32_t>(stream), static_cast<std::uint32_t>(stream >> 32) };
+	std::uint32_t key[2] = { static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32) };
+
+	for (int i = 0; i != rounds; ++i) {
+		std::uint64_t product0 = static_cast<std::uint64_t>(multiplier0) * counter[0];
+		std::uint64_t product1 = static_cast<std::uint64_t>(multiplier1) * counter[2];
+		std::uint32_t next[4] = {
+			static_cast<std::uint32_t>(product1 >> 32) ^ counter[1] ^ key[0],
+			static_cast<std::uint32_t>(product1),
+			static_cast<std::uint32_t>(product0 >> 32) ^ counter[3] ^ key[1],
+			static_cast<std::uint32_t>(product0),
+		};
+		counter[0] = next[0];
+		counter[1] = next[1];
+		counter[2] = next[2];
+		counter[3] = next[3];
+		key[0] += increment0;
+		key[1] += increment1;
+	}
+
+	block_type result = { counter[0], counter[1], counter[2], counter[3] };
+	return result;
+}
+
+void seed(std::uint64_t value) {
+	state& current = shared();
+	current.seed.store(value);
+	current.count.store(0);
+	++current.generation;
+}
+
+std::uint64_t nextseed() {
+	state& current = shared();
+	std::uint64_t count = current.count.fetch_add(1);
+	return mix(current.seed.load() + mix(count));
+}
+
+//each block gives two uniform doubles, which the box-muller transform turns into two normal values
+template<typename T>
+void normalfill(basic_matrixview<T> out, T mean, T deviation, std::uint64_t seed) {
+	std::size_t width = out.width();
+	parallelfor(out.size(), fillgrain, [&](std::size_t begin, std::size_t end) {
+		const double tau = 6.283185307179586476925;
+		std::size_t i = begin;
+		while (i != end) {
+			philox::block_type bits = philox::block(seed, 0, i / 2);
+			double radius = std::sqrt(-2 * std::log(uniform(bits[0], bits[1])));
+			double angle = tau * uniform(bits[2], bits[3]);
+			double values[2] = { radius * std::cos(angle), radius * std::sin(angle) };
+			for (std::size_t j = i % 2; j != 2 && i != end; ++j, ++i) {
+				out.data()[(i / width) * out.stride() + i % width] = mean + deviation * static_cast<T>(values[j]);
+			}
+		}
+	});
+}
+
+template<typename T>
+void bernoullifill(basic_matrixview<T> out, T probability, std::uint64_t seed) {
+	std::size_t width = out.width();
+	double threshold = static_cast<double>(probability) * 4294967296.0;
+	parallelfor(out.size(), fillgrain, [&](std::size_t begin, std::size_t end) {
+		std::size_t i = begin;
+		while (i != end) {
+			philox::block_type bits = philox::block(seed, 0, i / 4);
+			for (std::size_t j = i % 4; j != 4 && i != end; ++j, ++i) {
+				out.data()[(i / width) * out.stride() + i % width] = static_cast<double>(bits[j]) < threshold ? 1 : 0;
+			}
+		}
+	});
+}
+
+std::default_random_engine default_random_engine() {
+	std::uint64_t value = nextseed();
+	std::seed_seq sequence = { static_cast<std::uint32_t>(value), static_cast<std::uint32_t>(value >> 32) };
+	std::default_random_engine re(sequence);
+	return re;
+}
+
+//not really a standard dist but this gives us better results for now
+num standarddist() {
+	std::normal_distribution<num> nd(0, 0.6);
+	return nd(threadengine());
+}
+
+bool bernoullidist() {
+	std::bernoulli_distribution bd(0.5);
+	return bd(threadengine());
+}
+
+//the library is built for both single and double precision
+template void normalfill(basic_matrixview<float> out, float mean, float deviation, std::uint64_t seed);
+template void normalfill(basic_matrixview<double> out, double mean, double deviation, std::uint64_t seed);
+template void bernoullifill(basic_matrixview<float> out, float probability, std::uint64_t seed);
+template void bernoullifill(basic_matrixview<double> out, double probability, std::uint64_t seed);
+
+}
@@ -0,0 +1,77 @@
+//Copyright 2017 Jakob Wyatt
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http ://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#ifndef GUARD_RANDOM_H
+#define GUARD_RANDOM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+
+#include "matrixview.h"
+
+//seedable random numbers that can be generated in parallel
+//the generator is counter based: the numbers at any position of a stream are found directly from the seed and the position,
+//so a matrix can be filled by many threads at once and still come out the same for any thread count
+//the library seed is random unless it is set with math::seed or the MATH_SEED environment variable
+namespace math {
+
+//philox 4x32-10 counter based random number generator
+//each seed gives 2^64 independent streams of 2^66 numbers
+//meets the requirements of UniformRandomBitGenerator, so it works with the standard distributions
+class philox {
+public:
+	typedef std::uint32_t result_type;
+	typedef std::array<std::uint32_t, 4> block_type;
+
+	//initializes a generator at the start of a stream
+	explicit philox(std::uint64_t seed = 0, std::uint64_t stream = 0);
+
+	static constexpr result_type min() { return 0; }
+	static constexpr result_type max() { return 0xffffffff; }
+	//returns the next number in the stream
+	result_type operator()();
+	//skips count numbers
+	void discard(std::uint64_t count);
+
+	//returns the four numbers of a stream at a block position, which are numbers 4 * position to 4 * position + 3
+	static block_type block(std::uint64_t seed, std::uint64_t stream, std::uint64_t position);
+
+private:
+	std::uint64_t _seed;
+	std::uint64_t _stream;
+	std::uint64_t _position;
+	block_type _block;
+	std::size_t _index;
+};
+
+//sets the library seed, and restarts the sequence of seeds handed out by nextseed
+void seed(std::uint64_t value);
+//returns a new seed derived from the library seed, different on every call
+//after math::seed, the same sequence of seeds is handed out again
+//is threadsafe
+std::uint64_t nextseed();
+
+//fills a view with normally distributed values
+//the elements are counted along the rows, and element i only depends on the seed and i,
+//so large views are filled in parallel and the result does not depend on the thread count
+template<typename T>
+void normalfill(basic_matrixview<T> out, T mean, T deviation, std::uint64_t seed);
+//fills a view with ones, each with the given probability, and zeros
+template<typename T>
+void bernoullifill(basic_matrixview<T> out, T probability, std::uint64_t seed);
+
+}
+
+#endif
@@ -0,0 +1,119 @@
+//Copyright 2017 Jakob Wyatt
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http ://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#include "session.h"
+
+#include <vector>
+#include <stdexcept>
+#include <algorithm>
+
+#include "math.h"
+#include "nn.h"
+
+//we will only error-check if the project is in debug mode
+//we use the _DEBUG macro to check for this
+namespace nn {
+
+template<typename T>
+basic_session<T>::basic_session(const nn& network, size_type batchsize) : _network(network), _batchsize(batchsize), _samplebuffers(), _batchbuffers() {
+#ifdef _DEBUG
+	if (batchsize == 0) {
+		throw std::invalid_argument("batchsize must be positive");
+	}
+#endif
+
+	size_type nnsize = network.size();
+	for (size_type i = 0; i != nnsize; ++i) {
+		_samplebuffers.push_back(matrix(network[i].outputheight(), network[i].outputwidth()));
+	}
+	for (size_type i = 0; i + 1 < nnsize; ++i) {
+		_batchbuffers.push_back(matrix(batchsize, network[i].outputheight() * network[i].outputwidth()));
+	}
+}
+
+template<typename T>
+typename basic_session<T>::size_type basic_session<T>::batchsize() const {
+	return this->_batchsize;
+}
+
+template<typename T>
+void basic_session<T>::evaluate(constview input, view output) {
+#ifdef _DEBUG
+	size_type nnsize = this->_network.size();
+	if (output.height() != this->_samplebuffers[nnsize - 1].height() || output.width() != this->_samplebuffers[nnsize - 1].width()) {
+		throw std::invalid_argument("output matrix is incompatible");
+	}
+#endif
+
+	matrix::copy(this->evaluate(input), output);
+}
+
+//a single sample is a matrix-vector product in each layer, which is faster than a batch of one
+template<typename T>
+typename basic_session<T>::constview basic_session<T>::evaluate(constview input) {
+	size_type nnsize = this->_network.size();
+
+#ifdef _DEBUG
+	if (input.height() != this->_network[0].inputheight() || input.width() != this->_network[0].inputwidth()) {
+		throw std::invalid_argument("input matrix is incompatible");
+	}
+#endif
+
+	this->_network[0].evaluate(input, this->_samplebuffers[0]);
+	for (size_type i = 1; i != nnsize; ++i) {
+		this->_network[i].evaluate(this->_samplebuffers[i - 1], this->_samplebuffers[i]);
+	}
+	return this->_samplebuffers[nnsize - 1];
+}
+
+//the inputs and outputs are walked a batch of rows at a time, and the last batch may be short
+template<typename T>
+void basic_session<T>::batchevaluate(constview inputs, view outputs) {
+	size_type nnsize = this->_network.size();
+	const basic_layer<T>& first = this->_network[0];
+	const basic_layer<T>& last = this->_network[nnsize - 1];
+
+#ifdef _DEBUG
+	if (inputs.width() != first.inputheight() * first.inputwidth()) {
+		throw std::invalid_argument("input matrix is incompatible");
+	}
+	if (outputs.width() != last.outputheight() * last.outputwidth() || outputs.height() != inputs.height()) {
+		throw std::invalid_argument("output matrix is incompatible");
+	}
+#endif
+
+	typename matrix::size_type samples = inputs.height();
+	for (typename matrix::size_type begin = 0; begin < samples; begin += this->_batchsize) {
+		typename matrix::size_type rows = std::min<typename matrix::size_type>(this->_batchsize, samples - begin);
+		constview input = inputs.block(begin, 0, rows, inputs.width());
+		view output = outputs.block(begin, 0, rows, outputs.width());
+		if (nnsize == 1) {
+			first.batchevaluate(input, output);
+			continue;
+		}
+
+		first.batchevaluate(input, view(this->_batchbuffers[0]).block(0, 0, rows, this->_batchbuffers[0].width()));
+		for (size_type i = 1; i + 1 < nnsize; ++i) {
+			this->_network[i].batchevaluate(constview(this->_batchbuffers[i - 1]).block(0, 0, rows, this->_batchbuffers[i - 1].width()),
+				view(this->_batchbuffers[i]).block(0, 0, rows, this->_batchbuffers[i].width()));
+		}
+		last.batchevaluate(constview(this->_batchbuffers[nnsize - 2]).block(0, 0, rows, this->_batchbuffers[nnsize - 2].width()), output);
+	}
+}
+
+//the library is built for both single and double precision
+template class basic_session<float>;
+template class basic_session<double>;
+
+}
@@ -0,0 +1,71 @@
+//Copyright 2017 Jakob Wyatt
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http ://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#ifndef GUARD_SESSION_H
+#define GUARD_SESSION_H
+
+#include <vector>
+
+#include "math.h"
+#include "nn.h"
+
+//reusable inference on trained neuralnets
+//a session holds the buffers passed between the layers, sized once when it is built,
+//so evaluating the same neuralnet many times does not touch the heap
+namespace nn {
+
+//evaluates a neuralnet one sample at a time, or many samples at a time with a sample per row
+//batches run through each layer as a single matrix-matrix product, and give the same output as evaluating each sample on its own
+//the neuralnet must outlive the session, and must not be trained or fused while the session is in use
+//a session is not threadsafe, so each thread should have its own
+template<typename T>
+class basic_session {
+public:
+	typedef math::basic_matrix<T> matrix;
+	typedef typename matrix::view view;
+	typedef typename matrix::constview constview;
+	typedef basic_nn<T> nn;
+	typedef typename nn::size_type size_type;
+
+	//allocates the buffers needed to evaluate a neuralnet up to batchsize samples at a time
+	basic_session(const nn& network, size_type batchsize);
+
+	//returns the largest number of samples evaluated at once
+	size_type batchsize() const;
+
+	//evaluates the output of the neuralnet for a single sample, and writes that output to a buffer
+	void evaluate(constview input, view output);
+	//evaluates the output of the neuralnet for a single sample
+	//the output is held in the session, and is overwritten by the next call
+	constview evaluate(constview input);
+	//evaluates the output of the neuralnet for many samples, and writes those outputs to a buffer
+	//each sample is a row of the inputs and outputs, holding the elements of the sample counted along its rows
+	//any number of samples can be passed, and they are evaluated batchsize at a time
+	void batchevaluate(constview inputs, view outputs);
+
+private:
+	const nn& _network;
+	size_type _batchsize;
+	//the output of every layer for a single sample
+	std::vector<matrix> _samplebuffers;
+	//the output of every layer but the last for a batch, with a row per sample
+	//the last layer writes straight into the outputs it is given
+	std::vector<matrix> _batchbuffers;
+};
+
+typedef basic_session<math::num> session;
+
+}
+
+#endif
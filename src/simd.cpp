@@ -0,0 +1,266 @@
+//Copyright 2017 Jakob Wyatt
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http ://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#include "simd.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+#include "simdkernels.h"
+
+namespace math {
+namespace simd {
+
+namespace {
+
+//moves the integer held in the low mantissa bits of value into the exponent field of 1.0
+double pow2bits(double value) {
+	std::uint64_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	bits = (bits << 52) + 0x3ff0000000000000ull;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+float pow2bits(float value) {
+	std::uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	bits = (bits << 23) + 0x3f800000u;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+//plain c++ stand-in for a vector register, used for the scalar fallback
+template<typename T>
+struct scalarvector {
+	typedef T scalar;
+	typedef T reg;
+	static constexpr std::size_t width = 1;
+
+	static reg load(const scalar* ptr) { return *ptr; }
+	static void store(scalar* ptr, reg value) { *ptr = value; }
+	static reg widen(const float* ptr) { return static_cast<scalar>(*ptr); }
+	static void narrow(float* ptr, reg value) { *ptr = static_cast<float>(value); }
+	static reg set1(scalar value) { return value; }
+	static reg add(reg lhs, reg rhs) { return lhs + rhs; }
+	static reg sub(reg lhs, reg rhs) { return lhs - rhs; }
+	static reg mul(reg lhs, reg rhs) { return lhs * rhs; }
+	static reg div(reg lhs, reg rhs) { return lhs / rhs; }
+	static reg sqrt(reg value) { return std::sqrt(value); }
+	static reg min(reg lhs, reg rhs) { return rhs < lhs ? rhs : lhs; }
+	static reg max(reg lhs, reg rhs) { return lhs < rhs ? rhs : lhs; }
+	static scalar sum(reg value) { return value; }
+	static reg pow2(reg value) { return pow2bits(value); }
+};
+
+//plain c++ stand-in for an integer vector register, used for the scalar fallback
+struct scalarinteger {
+	typedef std::int32_t reg;
+	static constexpr std::size_t width = 1;
+
+	static reg load(const std::int8_t* ptr) { return *ptr; }
+	static reg zero() { return 0; }
+	static reg madd(reg sum, reg lhs, reg rhs) { return sum + lhs * rhs; }
+	static std::int32_t sum(reg value) { return value; }
+};
+
+//returns the highest instruction set the cpu and operating system support, ignoring what was compiled
+isa cpusupport() {
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) {
+		return avx512;
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		return avx2;
+	}
+	if (__builtin_cpu_supports("sse2")) {
+		return sse2;
+	}
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	int info[4];
+	__cpuid(info, 0);
+	int maxleaf = info[0];
+	__cpuid(info, 1);
+	bool hassse2 = (info[3] & (1 << 26)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool hasavx = (info[2] & (1 << 28)) != 0;
+	unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+	if (maxleaf >= 7 && hasavx && (xcr0 & 0x6) == 0x6) {
+		__cpuidex(info, 7, 0);
+		if ((info[1] & (1 << 16)) != 0 && (xcr0 & 0xe6) == 0xe6) {
+			return avx512;
+		}
+		if ((info[1] & (1 << 5)) != 0) {
+			return avx2;
+		}
+	}
+	if (hassse2) {
+		return sse2;
+	}
+#endif
+	return scalar;
+}
+
+//returns true if the kernels for an instruction set were compiled into this build
+bool compiled(isa set) {
+	switch (set) {
+	case sse2:
+		return &sse2kernels<double>() != &scalarkernels<double>();
+	case avx2:
+		return &avx2kernels<double>() != &scalarkernels<double>();
+	case avx512:
+		return &avx512kernels<double>() != &scalarkernels<double>();
+	default:
+		return true;
+	}
+}
+
+template<typename T>
+const kernels<T>& table(isa set) {
+	switch (set) {
+	case sse2:
+		return sse2kernels<T>();
+	case avx2:
+		return avx2kernels<T>();
+	case avx512:
+		return avx512kernels<T>();
+	default:
+		return scalarkernels<T>();
+	}
+}
+
+const integerkernels& integertable(isa set) {
+	switch (set) {
+	case sse2:
+		return sse2integerkernels();
+	case avx2:
+		return avx2integerkernels();
+	case avx512:
+		return avx512integerkernels();
+	default:
+		return scalarintegerkernels();
+	}
+}
+
+//picks the instruction set used at startup, honouring the MATH_ISA environment variable
+isa initial() {
+	isa best = detect();
+	const char* name = std::getenv("MATH_ISA");
+	if (name == nullptr) {
+		return best;
+	}
+
+	isa requested = best;
+	if (std::strcmp(name, "scalar") == 0) {
+		requested = scalar;
+	} else if (std::strcmp(name, "sse2") == 0) {
+		requested = sse2;
+	} else if (std::strcmp(name, "avx2") == 0) {
+		requested = avx2;
+	} else if (std::strcmp(name, "avx512") == 0) {
+		requested = avx512;
+	}
+	//an unsupported request falls back to the best available set rather than crashing
+	return requested <= best ? requested : best;
+}
+
+//the selected instruction set and its tables
+//the table pointers are what the hot path reads, the set is only kept for current()
+//this is a function local static so kernels can safely be used during static initialization
+struct selection {
+	std::atomic<isa> set;
+	std::atomic<const kernels<float>*> floattable;
+	std::atomic<const kernels<double>*> doubletable;
+	std::atomic<const integerkernels*> integers;
+
+	selection() : set(initial()), floattable(&table<float>(set.load())), doubletable(&table<double>(set.load())), integers(&integertable(set.load())) {
+
+	}
+};
+
+selection& selected() {
+	static selection value;
+	return value;
+}
+
+std::atomic<const kernels<float>*>& tableptr(float) {
+	return selected().floattable;
+}
+
+std::atomic<const kernels<double>*>& tableptr(double) {
+	return selected().doubletable;
+}
+
+}
+
+template<typename T>
+const kernels<T>& active() {
+	return *tableptr(T()).load(std::memory_order_relaxed);
+}
+
+const integerkernels& activeinteger() {
+	return *selected().integers.load(std::memory_order_relaxed);
+}
+
+isa current() {
+	return selected().set.load(std::memory_order_relaxed);
+}
+
+isa detect() {
+	isa best = cpusupport();
+	while (best != scalar && !compiled(best)) {
+		best = static_cast<isa>(best - 1);
+	}
+	return best;
+}
+
+void force(isa set) {
+	if (set > detect()) {
+		throw std::invalid_argument("instruction set is not supported");
+	}
+	selected().set.store(set, std::memory_order_relaxed);
+	selected().floattable.store(&table<float>(set), std::memory_order_relaxed);
+	selected().doubletable.store(&table<double>(set), std::memory_order_relaxed);
+	selected().integers.store(&integertable(set), std::memory_order_relaxed);
+}
+
+template<typename T>
+const kernels<T>& scalarkernels() {
+	static const kernels<T> result = elementwise<scalarvector<T>>::table();
+	return result;
+}
+
+const integerkernels& scalarintegerkernels() {
+	static const integerkernels result = integertiled<scalarinteger>::table();
+	return result;
+}
+
+template const kernels<float>& active();
+template const kernels<double>& active();
+template const kernels<float>& scalarkernels();
+template const kernels<double>& scalarkernels();
+
+}
+}
@@ -0,0 +1,130 @@
+//Copyright 2017 Jakob Wyatt
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http ://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#ifndef GUARD_SIMD_H
+#define GUARD_SIMD_H
+
+#include <cstddef>
+#include <cstdint>
+
+//elementwise kernels are compiled once per instruction set, each in its own translation unit,
+//and the best set supported by the cpu is picked the first time a kernel is used
+namespace math {
+namespace simd {
+
+//instruction sets we have kernels for, in increasing order of preference
+enum isa {
+	scalar,
+	sse2,
+	avx2,
+	avx512,
+};
+
+//dimensions of the register tile of the blocked matrix multiply, in rows of c and columns of c
+//a tile is wider than gemmcolumns when a single register is, see kernels::gemmwidth
+const std::size_t gemmrows = 4;
+const std::size_t gemmcolumns = 8;
+//dimensions of the register tile of the int8 matrix multiply, in rows of c and columns of c
+const std::size_t int8rows = 4;
+const std::size_t int8columns = 2;
+
+//table of elementwise kernels for a single instruction set and scalar type
+//all pointers refer to contiguous arrays of size elements, and out may alias an input
+template<typename T>
+struct kernels {
+	//out = lhs + rhs
+	void (*add)(const T* lhs, const T* rhs, T* out, std::size_t size);
+	//out = lhs - rhs
+	void (*subtract)(const T* lhs, const T* rhs, T* out, std::size_t size);
+	//out = lhs * rhs, elementwise
+	void (*hadamard)(const T* lhs, const T* rhs, T* out, std::size_t size);
+	//out = lhs * scalar
+	void (*multiply)(const T* lhs, T scalar, T* out, std::size_t size);
+	//out += input * scalar
+	void (*multiplyadd)(const T* input, T scalar, T* out, std::size_t size);
+	//returns the sum of (lhs - rhs)^2
+	T (*squareddistance)(const T* lhs, const T* rhs, std::size_t size);
+	//out = sigmoid(input), using a polynomial approximation of exp
+	void (*sigmoid)(const T* input, T* out, std::size_t size);
+	//out = sigmoid'(input), using the same approximation
+	void (*sigmoidprime)(const T* input, T* out, std::size_t size);
+	//out = sigmoid(input + bias), using the same approximation
+	void (*biasedsigmoid)(const T* input, const T* bias, T* out, std::size_t size);
+	//out = errorin * sigmoid'(x), elementwise, given output = sigmoid(x)
+	void (*sigmoidgradient)(const T* errorin, const T* output, T* out, std::size_t size);
+	//the optimizer steps update parameters from their derivatives in place, then set the derivatives to zero, in a single pass
+	//if copy is not null, the new parameters are also rounded to single precision and written to it, in the same pass
+	//parameters += derivatives * -learningrate
+	void (*sgdstep)(T* parameters, float* copy, T* derivatives, T learningrate, std::size_t size);
+	//velocity = velocity * momentum + derivatives * -learningrate, then parameters += velocity
+	void (*momentumstep)(T* parameters, float* copy, T* derivatives, T* velocity, T learningrate, T momentum, std::size_t size);
+	//as momentumstep, but parameters += velocity * momentum + derivatives * -learningrate, using the new velocity
+	void (*nesterovstep)(T* parameters, float* copy, T* derivatives, T* velocity, T learningrate, T momentum, std::size_t size);
+	//first = first * beta1 + derivatives * (1 - beta1), second = second * beta2 + derivatives^2 * (1 - beta2),
+	//then parameters += first * -stepsize / (sqrt(second) + epsilon)
+	void (*adamstep)(T* parameters, float* copy, T* derivatives, T* first, T* second, T stepsize, T beta1, T beta2, T epsilon, std::size_t size);
+	//out = input * scale, widened from single precision, then input = 0, in a single pass
+	//returns false if any element of out is not finite
+	bool (*unscale)(float* input, T* out, T scale, std::size_t size);
+	//the number of columns of c in a register tile of the blocked matrix multiply, a multiple of gemmcolumns
+	std::size_t gemmwidth;
+	//c = a * b for one register tile of the blocked matrix multiply, see gemm.cpp
+	//a is a panel of gemmrows rows and b a panel of gemmwidth columns, both packed along k,
+	//and only the top left rows by columns corner of the tile is written to c
+	//every element is summed in ascending k order, starting from zero, or from c if accumulate is set
+	void (*gemmtile)(std::size_t kb, const T* a, const T* b, T* c, std::size_t ldc, std::size_t rows, std::size_t columns, bool accumulate);
+};
+
+//table of integer kernels for a single instruction set, used by quantized inference
+struct integerkernels {
+	//c = a * b transposed for one tile of the int8 matrix multiply, see gemm.cpp
+	//a holds rows and b holds columns arrays of k elements, lda and ldb apart, and c is rows by columns
+	//rows and columns are at most int8rows and int8columns
+	//the products are summed exactly in 32 bits, so every instruction set gives the same result
+	void (*int8tile)(std::size_t k, const std::int8_t* a, std::size_t lda, const std::int8_t* b, std::size_t ldb, std::int32_t* c, std::size_t ldc, std::size_t rows, std::size_t columns);
+};
+
+//returns the kernels for the instruction set currently in use
+template<typename T>
+const kernels<T>& active();
+//returns the integer kernels for the instruction set currently in use
+const integerkernels& activeinteger();
+//returns the instruction set currently in use
+isa current();
+//returns the best instruction set supported by this cpu and build
+isa detect();
+//forces the use of an instruction set, mainly for testing
+//the MATH_ISA environment variable (scalar, sse2, avx2 or avx512) does the same at startup
+//throws if the instruction set is not supported
+void force(isa set);
+
+//per instruction set kernel tables
+//sets that were not compiled into this build fall back to the scalar kernels
+template<typename T>
+const kernels<T>& scalarkernels();
+template<typename T>
+const kernels<T>& sse2kernels();
+template<typename T>
+const kernels<T>& avx2kernels();
+template<typename T>
+const kernels<T>& avx512kernels();
+const integerkernels& scalarintegerkernels();
+const integerkernels& sse2integerkernels();
+const integerkernels& avx2integerkernels();
+const integerkernels& avx512integerkernels();
+
+}
+}
+
+#endif
@@ -0,0 +1,155 @@
+//Copyright 2017 Jakob Wyatt
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http ://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#include "simd.h"
+
+//this file is compiled with avx2 enabled
+//it must not use inline functions from other headers, as the linker could pick our avx2 copy for everyone
+#if defined(__AVX2__)
+
+#include <cstddef>
+#include <cstdint>
+#include <immintrin.h>
+
+#include "simdkernels.h"
+
+namespace math {
+namespace simd {
+
+namespace {
+
+struct avx2double {
+	typedef double scalar;
+	typedef __m256d reg;
+	static constexpr std::size_t width = 4;
+
+	static reg load(const scalar* ptr) { return _mm256_loadu_pd(ptr); }
+	static void store(scalar* ptr, reg value) { _mm256_storeu_pd(ptr, value); }
+	static reg widen(const float* ptr) { return _mm256_cvtps_pd(_mm_loadu_ps(ptr)); }
+	static void narrow(float* ptr, reg value) { _mm_storeu_ps(ptr, _mm256_cvtpd_ps(value)); }
+	static reg set1(scalar value) { return _mm256_set1_pd(value); }
+	static reg add(reg lhs, reg rhs) { return _mm256_add_pd(lhs, rhs); }
+	static reg sub(reg lhs, reg rhs) { return _mm256_sub_pd(lhs, rhs); }
+	static reg mul(reg lhs, reg rhs) { return _mm256_mul_pd(lhs, rhs); }
+	static reg div(reg lhs, reg rhs) { return _mm256_div_pd(lhs, rhs); }
+	static reg sqrt(reg value) { return _mm256_sqrt_pd(value); }
+	static reg min(reg lhs, reg rhs) { return _mm256_min_pd(lhs, rhs); }
+	static reg max(reg lhs, reg rhs) { return _mm256_max_pd(lhs, rhs); }
+	static reg pow2(reg value) {
+		__m256i bits = _mm256_slli_epi64(_mm256_castpd_si256(value), 52);
+		return _mm256_castsi256_pd(_mm256_add_epi64(bits, _mm256_set1_epi64x(0x3ff0000000000000ll)));
+	}
+	static scalar sum(reg value) {
+		__m128d half = _mm_add_pd(_mm256_castpd256_pd128(value), _mm256_extractf128_pd(value, 1));
+		return _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+	}
+};
+
+struct avx2float {
+	typedef float scalar;
+	typedef __m256 reg;
+	static constexpr std::size_t width = 8;
+
+	static reg load(const scalar* ptr) { return _mm256_loadu_ps(ptr); }
+	static void store(scalar* ptr, reg value) { _mm256_storeu_ps(ptr, value); }
+	static reg widen(const float* ptr) { return _mm256_loadu_ps(ptr); }
+	static void narrow(float* ptr, reg value) { _mm256_storeu_ps(ptr, value); }
+	static reg set1(scalar value) { return _mm256_set1_ps(value); }
+	static reg add(reg lhs, reg rhs) { return _mm256_add_ps(lhs, rhs); }
+	static reg sub(reg lhs, reg rhs) { return _mm256_sub_ps(lhs, rhs); }
+	static reg mul(reg lhs, reg rhs) { return _mm256_mul_ps(lhs, rhs); }
+	static reg div(reg lhs, reg rhs) { return _mm256_div_ps(lhs, rhs); }
+	static reg sqrt(reg value) { return _mm256_sqrt_ps(value); }
+	static reg min(reg lhs, reg rhs) { return _mm256_min_ps(lhs, rhs); }
+	static reg max(reg lhs, reg rhs) { return _mm256_max_ps(lhs, rhs); }
+	static reg pow2(reg value) {
+		__m256i bits = _mm256_slli_epi32(_mm256_castps_si256(value), 23);
+		return _mm256_castsi256_ps(_mm256_add_epi32(bits, _mm256_set1_epi32(0x3f800000)));
+	}
+	static scalar sum(reg value) {
+		__m128 quarter = _mm_add_ps(_mm256_castps256_ps128(value), _mm256_extractf128_ps(value, 1));
+		quarter = _mm_add_ps(quarter, _mm_movehl_ps(quarter, quarter));
+		return _mm_cvtss_f32(_mm_add_ss(quarter, _mm_shuffle_ps(quarter, quarter, 1)));
+	}
+};
+
+struct avx2integer {
+	typedef __m256i reg;
+	static constexpr std::size_t width = 16;
+
+	static reg load(const std::int8_t* ptr) { return _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr))); }
+	static reg zero() { return _mm256_setzero_si256(); }
+	static reg madd(reg sum, reg lhs, reg rhs) { return _mm256_add_epi32(sum, _mm256_madd_epi16(lhs, rhs)); }
+	static std::int32_t sum(reg value) {
+		__m128i half = _mm_add_epi32(_mm256_castsi256_si128(value), _mm256_extracti128_si256(value, 1));
+		half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+		half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_cvtsi128_si32(half);
+	}
+};
+
+//maps a scalar type to its vector type
+template<typename T>
+struct vector;
+
+template<>
+struct vector<float> {
+	typedef avx2float type;
+};
+
+template<>
+struct vector<double> {
+	typedef avx2double type;
+};
+
+}
+
+template<typename T>
+const kernels<T>& avx2kernels() {
+	static const kernels<T> result = elementwise<typename vector<T>::type>::table();
+	return result;
+}
+
+template const kernels<float>& avx2kernels();
+template const kernels<double>& avx2kernels();
+
+const integerkernels& avx2integerkernels() {
+	static const integerkernels result = integertiled<avx2integer>::table();
+	return result;
+}
+
+}
+}
+
+#else
+
+namespace math {
+namespace simd {
+
+template<typename T>
+const kernels<T>& avx2kernels() {
+	return scalarkernels<T>();
+}
+
+template const kernels<float>& avx2kernels();
+template const kernels<double>& avx2kernels();
+
+const integerkernels& avx2integerkernels() {
+	return scalarintegerkernels();
+}
+
+}
+}
+
+#endif
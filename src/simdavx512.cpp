@@ -0,0 +1,149 @@
+//Copyright 2017 Jakob Wyatt
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http ://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#include "simd.h"
+
+//this file is compiled with avx-512 enabled
+//it must not use inline functions from other headers, as the linker could pick our avx-512 copy for everyone
+#if defined(__AVX512F__)
+
+#include <cstddef>
+#include <cstdint>
+#include <immintrin.h>
+
+#include "simdkernels.h"
+
+namespace math {
+namespace simd {
+
+namespace {
+
+struct avx512double {
+	typedef double scalar;
+	typedef __m512d reg;
+	static constexpr std::size_t width = 8;
+
+	static reg load(const scalar* ptr) { return _mm512_loadu_pd(ptr); }
+	static void store(scalar* ptr, reg value) { _mm512_storeu_pd(ptr, value); }
+	static reg widen(const float* ptr) { return _mm512_cvtps_pd(_mm256_loadu_ps(ptr)); }
+	static void narrow(float* ptr, reg value) { _mm256_storeu_ps(ptr, _mm512_cvtpd_ps(value)); }
+	static reg set1(scalar value) { return _mm512_set1_pd(value); }
+	static reg add(reg lhs, reg rhs) { return _mm512_add_pd(lhs, rhs); }
+	static reg sub(reg lhs, reg rhs) { return _mm512_sub_pd(lhs, rhs); }
+	static reg mul(reg lhs, reg rhs) { return _mm512_mul_pd(lhs, rhs); }
+	static reg div(reg lhs, reg rhs) { return _mm512_div_pd(lhs, rhs); }
+	static reg sqrt(reg value) { return _mm512_sqrt_pd(value); }
+	static reg min(reg lhs, reg rhs) { return _mm512_min_pd(lhs, rhs); }
+	static reg max(reg lhs, reg rhs) { return _mm512_max_pd(lhs, rhs); }
+	static reg pow2(reg value) {
+		__m512i bits = _mm512_slli_epi64(_mm512_castpd_si512(value), 52);
+		return _mm512_castsi512_pd(_mm512_add_epi64(bits, _mm512_set1_epi64(0x3ff0000000000000ll)));
+	}
+	static scalar sum(reg value) { return _mm512_reduce_add_pd(value); }
+};
+
+struct avx512float {
+	typedef float scalar;
+	typedef __m512 reg;
+	static constexpr std::size_t width = 16;
+
+	static reg load(const scalar* ptr) { return _mm512_loadu_ps(ptr); }
+	static void store(scalar* ptr, reg value) { _mm512_storeu_ps(ptr, value); }
+	static reg widen(const float* ptr) { return _mm512_loadu_ps(ptr); }
+	static void narrow(float* ptr, reg value) { _mm512_storeu_ps(ptr, value); }
+	static reg set1(scalar value) { return _mm512_set1_ps(value); }
+	static reg add(reg lhs, reg rhs) { return _mm512_add_ps(lhs, rhs); }
+	static reg sub(reg lhs, reg rhs) { return _mm512_sub_ps(lhs, rhs); }
+	static reg mul(reg lhs, reg rhs) { return _mm512_mul_ps(lhs, rhs); }
+	static reg div(reg lhs, reg rhs) { return _mm512_div_ps(lhs, rhs); }
+	static reg sqrt(reg value) { return _mm512_sqrt_ps(value); }
+	static reg min(reg lhs, reg rhs) { return _mm512_min_ps(lhs, rhs); }
+	static reg max(reg lhs, reg rhs) { return _mm512_max_ps(lhs, rhs); }
+	static reg pow2(reg value) {
+		__m512i bits = _mm512_slli_epi32(_mm512_castps_si512(value), 23);
+		return _mm512_castsi512_ps(_mm512_add_epi32(bits, _mm512_set1_epi32(0x3f800000)));
+	}
+	static scalar sum(reg value) { return _mm512_reduce_add_ps(value); }
+};
+
+//avx-512f has no 16 bit integer instructions on 512 bit registers, so the int8 tile uses 256 bit registers
+struct avx256integer {
+	typedef __m256i reg;
+	static constexpr std::size_t width = 16;
+
+	static reg load(const std::int8_t* ptr) { return _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr))); }
+	static reg zero() { return _mm256_setzero_si256(); }
+	static reg madd(reg sum, reg lhs, reg rhs) { return _mm256_add_epi32(sum, _mm256_madd_epi16(lhs, rhs)); }
+	static std::int32_t sum(reg value) {
+		__m128i half = _mm_add_epi32(_mm256_castsi256_si128(value), _mm256_extracti128_si256(value, 1));
+		half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+		half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_cvtsi128_si32(half);
+	}
+};
+
+//maps a scalar type to its vector type
+template<typename T>
+struct vector;
+
+template<>
+struct vector<float> {
+	typedef avx512float type;
+};
+
+template<>
+struct vector<double> {
+	typedef avx512double type;
+};
+
+}
+
+template<typename T>
+const kernels<T>& avx512kernels() {
+	static const kernels<T> result = elementwise<typename vector<T>::type>::table();
+	return result;
+}
+
+template const kernels<float>& avx512kernels();
+template const kernels<double>& avx512kernels();
+
+const integerkernels& avx512integerkernels() {
+	static const integerkernels result = integertiled<avx256integer>::table();
+	return result;
+}
+
+}
+}
+
+#else
+
+namespace math {
+namespace simd {
+
+template<typename T>
+const kernels<T>& avx512kernels() {
+	return scalarkernels<T>();
+}
+
+template const kernels<float>& avx512kernels();
+template const kernels<double>& avx512kernels();
+
+const integerkernels& avx512integerkernels() {
+	return scalarintegerkernels();
+}
+
+}
+}
+
+#endif
@@ -0,0 +1,492 @@
+//Copyright 2017 Jakob Wyatt
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http ://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#ifndef GUARD_SIMDKERNELS_H
+#define GUARD_SIMDKERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "simd.h"
+
+//generic elementwise kernels and the matrix multiply tile, written once against a vector type V
+//each instruction set translation unit supplies its own V and instantiates these
+//V provides:
+//	scalar, the element type, and reg, the register type
+//	width, the number of elements per register
+//	load, store, set1, add, sub, mul, div, sqrt, min, max and sum (horizontal add)
+//	pow2, which returns 2^n given a register holding n + expconstants<scalar>::magic
+//	widen, which reads width single precision elements into a register, and narrow, which rounds a register to single precision and writes it
+//the tile only needs scalar, reg, width, load, store, set1, add and mul
+//the int8 tile is written against an integer vector type W instead, which provides:
+//	reg, the register type, and width, the number of int8 elements read at once
+//	load, which reads width int8 elements and widens them to 16 bits, zero, madd and sum (horizontal add)
+//	madd multiplies the 16 bit elements of two registers and adds neighbouring pairs of products to 32 bit lanes
+//this header must only be included by the simd translation units
+namespace math {
+namespace simd {
+
+//constants for the approximate exp
+//adding magic to a value in range rounds it to an integer held in the low mantissa bits
+//ln2 is split into a high part, exact in a few bits, and a low part, so the range reduction loses little precision
+template<typename T>
+struct expconstants;
+
+template<>
+struct expconstants<double> {
+	static constexpr double magic = 6755399441055744.0;
+	static constexpr double log2e = 1.44269504088896340736;
+	static constexpr double ln2hi = 6.93147180369123816490e-01;
+	static constexpr double ln2lo = 1.90821492927058770002e-10;
+};
+
+template<>
+struct expconstants<float> {
+	static constexpr float magic = 12582912.0f;
+	static constexpr float log2e = 1.44269504088896340736f;
+	static constexpr float ln2hi = 0.693359375f;
+	static constexpr float ln2lo = -2.12194440e-4f;
+};
+
+//the register tile of the blocked matrix multiply, see kernels::gemmtile
+//each row of the tile is held in gemmcolumns / V::width registers, or in a single register when that is wider,
+//and the products are added without fusing, so every instruction set gives the same result as the scalar code
+template<typename V>
+struct tiled {
+	typedef typename V::scalar scalar;
+	typedef typename V::reg reg;
+	static constexpr std::size_t count = V::width < gemmcolumns ? gemmcolumns / V::width : 1;
+	//the number of columns of c in a tile
+	static constexpr std::size_t width = count * V::width;
+	static_assert(width % gemmcolumns == 0, "a tile must be a whole number of registers, and a multiple of gemmcolumns wide");
+
+	static void gemmtile(std::size_t kb, const scalar* a, const scalar* b, scalar* c, std::size_t ldc, std::size_t rows, std::size_t columns, bool accumulate) {
+		//partial tiles at the edges of c go through a full size buffer
+		bool full = rows == gemmrows && columns == width;
+		scalar edge[gemmrows][width] = {};
+		scalar* out = full ? c : &edge[0][0];
+		std::size_t ldout = full ? ldc : width;
+		if (accumulate && !full) {
+			for (std::size_t i = 0; i != rows; ++i) {
+				for (std::size_t j = 0; j != columns; ++j) {
+					edge[i][j] = c[i * ldc + j];
+				}
+			}
+		}
+
+		reg tile[gemmrows][count];
+		for (std::size_t i = 0; i != gemmrows; ++i) {
+			for (std::size_t r = 0; r != count; ++r) {
+				tile[i][r] = accumulate ? V::load(out + i * ldout + r * V::width) : V::set1(0);
+			}
+		}
+
+		for (std::size_t p = 0; p != kb; ++p) {
+			reg row[count];
+			for (std::size_t r = 0; r != count; ++r) {
+				row[r] = V::load(b + r * V::width);
+			}
+			for (std::size_t i = 0; i != gemmrows; ++i) {
+				reg ai = V::set1(a[i]);
+				for (std::size_t r = 0; r != count; ++r) {
+					tile[i][r] = V::add(tile[i][r], V::mul(ai, row[r]));
+				}
+			}
+			a += gemmrows;
+			b += width;
+		}
+
+		for (std::size_t i = 0; i != gemmrows; ++i) {
+			for (std::size_t r = 0; r != count; ++r) {
+				V::store(out + i * ldout + r * V::width, tile[i][r]);
+			}
+		}
+		if (!full) {
+			for (std::size_t i = 0; i != rows; ++i) {
+				for (std::size_t j = 0; j != columns; ++j) {
+					c[i * ldc + j] = edge[i][j];
+				}
+			}
+		}
+	}
+};
+
+//the register tile of the int8 matrix multiply, see integerkernels::int8tile
+//each element of c is summed across the lanes of its own register, and the products of int8 values
+//cannot overflow the 32 bit lanes for any k gemm accepts, so the order of the sums does not matter
+template<typename W>
+struct integertiled {
+	typedef typename W::reg reg;
+
+	//a block of c with a fixed size, so the sums stay in registers and each load is used by every row or column of the block
+	template<std::size_t R, std::size_t C>
+	static void block(std::size_t k, const std::int8_t* a, std::size_t lda, const std::int8_t* b, std::size_t ldb, std::int32_t* c, std::size_t ldc) {
+		reg sums[R][C];
+		for (std::size_t i = 0; i != R; ++i) {
+			for (std::size_t j = 0; j != C; ++j) {
+				sums[i][j] = W::zero();
+			}
+		}
+
+		std::size_t p = 0;
+		for (; p + W::width <= k; p += W::width) {
+			reg rows[R];
+			for (std::size_t i = 0; i != R; ++i) {
+				rows[i] = W::load(a + i * lda + p);
+			}
+			for (std::size_t j = 0; j != C; ++j) {
+				reg column = W::load(b + j * ldb + p);
+				for (std::size_t i = 0; i != R; ++i) {
+					sums[i][j] = W::madd(sums[i][j], rows[i], column);
+				}
+			}
+		}
+
+		for (std::size_t i = 0; i != R; ++i) {
+			for (std::size_t j = 0; j != C; ++j) {
+				std::int32_t sum = W::sum(sums[i][j]);
+				for (std::size_t q = p; q != k; ++q) {
+					sum += static_cast<std::int32_t>(a[i * lda + q]) * static_cast<std::int32_t>(b[j * ldb + q]);
+				}
+				c[i * ldc + j] = sum;
+			}
+		}
+	}
+
+	//partial tiles at the edges of c are made of narrower blocks
+	static void int8tile(std::size_t k, const std::int8_t* a, std::size_t lda, const std::int8_t* b, std::size_t ldb, std::int32_t* c, std::size_t ldc, std::size_t rows, std::size_t columns) {
+		if (rows == int8rows && columns == int8columns) {
+			block<int8rows, int8columns>(k, a, lda, b, ldb, c, ldc);
+		} else if (rows == int8rows) {
+			for (std::size_t j = 0; j != columns; ++j) {
+				block<int8rows, 1>(k, a, lda, b + j * ldb, ldb, c + j, ldc);
+			}
+		} else {
+			for (std::size_t i = 0; i != rows; ++i) {
+				for (std::size_t j = 0; j != columns; ++j) {
+					block<1, 1>(k, a + i * lda, lda, b + j * ldb, ldb, c + i * ldc + j, ldc);
+				}
+			}
+		}
+	}
+
+	//builds the integer kernel table for this vector type
+	static integerkernels table() {
+		integerkernels result = { &int8tile };
+		return result;
+	}
+};
+
+template<typename V>
+struct elementwise {
+	typedef typename V::scalar scalar;
+	typedef typename V::reg reg;
+
+	static void add(const scalar* lhs, const scalar* rhs, scalar* out, std::size_t size) {
+		std::size_t i = 0;
+		for (; i + V::width <= size; i += V::width) {
+			V::store(out + i, V::add(V::load(lhs + i), V::load(rhs + i)));
+		}
+		for (; i != size; ++i) {
+			out[i] = lhs[i] + rhs[i];
+		}
+	}
+
+	static void subtract(const scalar* lhs, const scalar* rhs, scalar* out, std::size_t size) {
+		std::size_t i = 0;
+		for (; i + V::width <= size; i += V::width) {
+			V::store(out + i, V::sub(V::load(lhs + i), V::load(rhs + i)));
+		}
+		for (; i != size; ++i) {
+			out[i] = lhs[i] - rhs[i];
+		}
+	}
+
+	static void hadamard(const scalar* lhs, const scalar* rhs, scalar* out, std::size_t size) {
+		std::size_t i = 0;
+		for (; i + V::width <= size; i += V::width) {
+			V::store(out + i, V::mul(V::load(lhs + i), V::load(rhs + i)));
+		}
+		for (; i != size; ++i) {
+			out[i] = lhs[i] * rhs[i];
+		}
+	}
+
+	static void multiply(const scalar* lhs, scalar value, scalar* out, std::size_t size) {
+		reg factor = V::set1(value);
+		std::size_t i = 0;
+		for (; i + V::width <= size; i += V::width) {
+			V::store(out + i, V::mul(V::load(lhs + i), factor));
+		}
+		for (; i != size; ++i) {
+			out[i] = lhs[i] * value;
+		}
+	}
+
+	static void multiplyadd(const scalar* input, scalar value, scalar* out, std::size_t size) {
+		reg factor = V::set1(value);
+		std::size_t i = 0;
+		for (; i + V::width <= size; i += V::width) {
+			V::store(out + i, V::add(V::load(out + i), V::mul(V::load(input + i), factor)));
+		}
+		for (; i != size; ++i) {
+			out[i] += input[i] * value;
+		}
+	}
+
+	//two accumulators hide the latency of the dependent adds
+	static scalar squareddistance(const scalar* lhs, const scalar* rhs, std::size_t size) {
+		reg first = V::set1(0);
+		reg second = V::set1(0);
+		std::size_t i = 0;
+		for (; i + 2 * V::width <= size; i += 2 * V::width) {
+			reg d0 = V::sub(V::load(lhs + i), V::load(rhs + i));
+			reg d1 = V::sub(V::load(lhs + i + V::width), V::load(rhs + i + V::width));
+			first = V::add(first, V::mul(d0, d0));
+			second = V::add(second, V::mul(d1, d1));
+		}
+		scalar sum = V::sum(V::add(first, second));
+		for (; i != size; ++i) {
+			scalar difference = lhs[i] - rhs[i];
+			sum += difference * difference;
+		}
+		return sum;
+	}
+
+	//approximate exp
+	//the input is clamped to [-80, 80], which keeps 2^n a normal number for both float and double,
+	//then split into n ln2 + r with |r| <= ln2/2, and exp(r) is found with a degree 6 taylor polynomial
+	static reg exp(reg x) {
+		typedef expconstants<scalar> constants;
+		x = V::min(V::max(x, V::set1(-80)), V::set1(80));
+		reg t = V::add(V::mul(x, V::set1(constants::log2e)), V::set1(constants::magic));
+		reg n = V::sub(t, V::set1(constants::magic));
+		reg r = V::sub(V::sub(x, V::mul(n, V::set1(constants::ln2hi))), V::mul(n, V::set1(constants::ln2lo)));
+
+		reg p = V::set1(static_cast<scalar>(1.0 / 720));
+		p = V::add(V::mul(p, r), V::set1(static_cast<scalar>(1.0 / 120)));
+		p = V::add(V::mul(p, r), V::set1(static_cast<scalar>(1.0 / 24)));
+		p = V::add(V::mul(p, r), V::set1(static_cast<scalar>(1.0 / 6)));
+		p = V::add(V::mul(p, r), V::set1(static_cast<scalar>(0.5)));
+		p = V::add(V::mul(p, r), V::set1(1));
+		p = V::add(V::mul(p, r), V::set1(1));
+		return V::mul(p, V::pow2(t));
+	}
+
+	static reg sigmoid(reg x) {
+		reg one = V::set1(1);
+		return V::div(one, V::add(one, exp(V::sub(V::set1(0), x))));
+	}
+
+	//the tail is copied into a full register, so every element sees the same approximation
+	template<typename F>
+	static void apply(F func, const scalar* input, scalar* out, std::size_t size) {
+		std::size_t i = 0;
+		for (; i + V::width <= size; i += V::width) {
+			V::store(out + i, func(V::load(input + i)));
+		}
+		std::size_t remaining = size - i;
+		if (remaining != 0 && remaining < V::width) {
+			scalar tail[V::width] = {};
+			for (std::size_t j = 0; j != remaining; ++j) {
+				tail[j] = input[i + j];
+			}
+			V::store(tail, func(V::load(tail)));
+			for (std::size_t j = 0; j != remaining; ++j) {
+				out[i + j] = tail[j];
+			}
+		}
+	}
+
+	//two input version of apply, used by the fused kernels
+	template<typename F>
+	static void apply(F func, const scalar* lhs, const scalar* rhs, scalar* out, std::size_t size) {
+		std::size_t i = 0;
+		for (; i + V::width <= size; i += V::width) {
+			V::store(out + i, func(V::load(lhs + i), V::load(rhs + i)));
+		}
+		std::size_t remaining = size - i;
+		if (remaining != 0 && remaining < V::width) {
+			scalar lhstail[V::width] = {};
+			scalar rhstail[V::width] = {};
+			for (std::size_t j = 0; j != remaining; ++j) {
+				lhstail[j] = lhs[i + j];
+				rhstail[j] = rhs[i + j];
+			}
+			V::store(lhstail, func(V::load(lhstail), V::load(rhstail)));
+			for (std::size_t j = 0; j != remaining; ++j) {
+				out[i + j] = lhstail[j];
+			}
+		}
+	}
+
+	static void sigmoid(const scalar* input, scalar* out, std::size_t size) {
+		apply([](reg x) { return sigmoid(x); }, input, out, size);
+	}
+
+	//exp is only evaluated once, as sigmoid'(x) = sigmoid(x) * (1 - sigmoid(x))
+	static void sigmoidprime(const scalar* input, scalar* out, std::size_t size) {
+		apply([](reg x) {
+			reg s = sigmoid(x);
+			return V::mul(s, V::sub(V::set1(1), s));
+		}, input, out, size);
+	}
+
+	//the bias is added exactly as add does, so this matches add followed by sigmoid
+	static void biasedsigmoid(const scalar* input, const scalar* bias, scalar* out, std::size_t size) {
+		apply([](reg x, reg b) { return sigmoid(V::add(x, b)); }, input, bias, out, size);
+	}
+
+	//output already holds sigmoid(x), so sigmoid'(x) is found without another exp
+	//this is exact, and matches hadamard(errorin, sigmoidprime(x)) for either accuracy
+	static void sigmoidgradient(const scalar* errorin, const scalar* output, scalar* out, std::size_t size) {
+		reg one = V::set1(1);
+		std::size_t i = 0;
+		for (; i + V::width <= size; i += V::width) {
+			reg s = V::load(output + i);
+			V::store(out + i, V::mul(V::load(errorin + i), V::mul(s, V::sub(one, s))));
+		}
+		for (; i != size; ++i) {
+			out[i] = errorin[i] * (output[i] * (1 - output[i]));
+		}
+	}
+
+	//runs func on whole registers of several arrays, which it updates in place
+	//if copy is not null, the first array is also rounded to single precision and written to it, while it is still in registers
+	//the tail is copied into full registers, as in apply, so no scalar maths is needed
+	template<std::size_t N, typename F>
+	static void inplace(F func, scalar* const (&arrays)[N], float* copy, std::size_t size) {
+		reg values[N];
+		std::size_t i = 0;
+		for (; i + V::width <= size; i += V::width) {
+			for (std::size_t j = 0; j != N; ++j) {
+				values[j] = V::load(arrays[j] + i);
+			}
+			func(values);
+			for (std::size_t j = 0; j != N; ++j) {
+				V::store(arrays[j] + i, values[j]);
+			}
+			if (copy != nullptr) {
+				V::narrow(copy + i, values[0]);
+			}
+		}
+		std::size_t remaining = size - i;
+		if (remaining != 0 && remaining < V::width) {
+			scalar tail[N][V::width] = {};
+			for (std::size_t j = 0; j != N; ++j) {
+				for (std::size_t k = 0; k != remaining; ++k) {
+					tail[j][k] = arrays[j][i + k];
+				}
+				values[j] = V::load(tail[j]);
+			}
+			func(values);
+			for (std::size_t j = 0; j != N; ++j) {
+				V::store(tail[j], values[j]);
+				for (std::size_t k = 0; k != remaining; ++k) {
+					arrays[j][i + k] = tail[j][k];
+				}
+			}
+			if (copy != nullptr) {
+				float narrowed[V::width];
+				V::narrow(narrowed, values[0]);
+				for (std::size_t k = 0; k != remaining; ++k) {
+					copy[i + k] = narrowed[k];
+				}
+			}
+		}
+	}
+
+	//the derivatives are scaled, then added, exactly as multiply followed by add
+	static void sgdstep(scalar* parameters, float* copy, scalar* derivatives, scalar learningrate, std::size_t size) {
+		reg rate = V::set1(-learningrate);
+		scalar* const arrays[2] = { parameters, derivatives };
+		inplace([&](reg (&values)[2]) {
+			values[0] = V::add(values[0], V::mul(values[1], rate));
+			values[1] = V::set1(0);
+		}, arrays, copy, size);
+	}
+
+	static void momentumstep(scalar* parameters, float* copy, scalar* derivatives, scalar* velocity, scalar learningrate, scalar momentum, std::size_t size) {
+		reg rate = V::set1(-learningrate);
+		reg decay = V::set1(momentum);
+		scalar* const arrays[3] = { parameters, derivatives, velocity };
+		inplace([&](reg (&values)[3]) {
+			values[2] = V::add(V::mul(values[2], decay), V::mul(values[1], rate));
+			values[0] = V::add(values[0], values[2]);
+			values[1] = V::set1(0);
+		}, arrays, copy, size);
+	}
+
+	static void nesterovstep(scalar* parameters, float* copy, scalar* derivatives, scalar* velocity, scalar learningrate, scalar momentum, std::size_t size) {
+		reg rate = V::set1(-learningrate);
+		reg decay = V::set1(momentum);
+		scalar* const arrays[3] = { parameters, derivatives, velocity };
+		inplace([&](reg (&values)[3]) {
+			reg gradient = V::mul(values[1], rate);
+			values[2] = V::add(V::mul(values[2], decay), gradient);
+			values[0] = V::add(values[0], V::add(V::mul(values[2], decay), gradient));
+			values[1] = V::set1(0);
+		}, arrays, copy, size);
+	}
+
+	static void adamstep(scalar* parameters, float* copy, scalar* derivatives, scalar* first, scalar* second, scalar stepsize, scalar beta1, scalar beta2, scalar epsilon, std::size_t size) {
+		reg rate = V::set1(-stepsize);
+		reg decay1 = V::set1(beta1);
+		reg decay2 = V::set1(beta2);
+		reg scale1 = V::set1(1 - beta1);
+		reg scale2 = V::set1(1 - beta2);
+		reg offset = V::set1(epsilon);
+		scalar* const arrays[4] = { parameters, derivatives, first, second };
+		inplace([&](reg (&values)[4]) {
+			reg gradient = values[1];
+			values[2] = V::add(V::mul(values[2], decay1), V::mul(gradient, scale1));
+			values[3] = V::add(V::mul(values[3], decay2), V::mul(V::mul(gradient, gradient), scale2));
+			values[0] = V::add(values[0], V::div(V::mul(values[2], rate), V::add(V::sqrt(values[3]), offset)));
+			values[1] = V::set1(0);
+		}, arrays, copy, size);
+	}
+
+	//x - x is zero for every finite x, and nan otherwise, so the sum of them is zero only if every element is finite
+	//this needs no compare instructions, and so works the same for every vector type
+	static bool unscale(float* input, scalar* out, scalar scale, std::size_t size) {
+		reg factor = V::set1(scale);
+		reg zero = V::set1(0);
+		reg check = zero;
+		std::size_t i = 0;
+		for (; i + V::width <= size; i += V::width) {
+			reg value = V::mul(V::widen(input + i), factor);
+			V::store(out + i, value);
+			check = V::add(check, V::sub(value, value));
+			V::narrow(input + i, zero);
+		}
+		scalar sum = V::sum(check);
+		for (; i != size; ++i) {
+			out[i] = static_cast<scalar>(input[i]) * scale;
+			sum += out[i] - out[i];
+			input[i] = 0;
+		}
+		return sum == 0;
+	}
+
+	//builds the kernel table for this vector type
+	static kernels<scalar> table() {
+		kernels<scalar> result = { &add, &subtract, &hadamard, &multiply, &multiplyadd, &squareddistance, &sigmoid, &sigmoidprime, &biasedsigmoid, &sigmoidgradient, &sgdstep, &momentumstep, &nesterovstep, &adamstep, &unscale, tiled<V>::width, &tiled<V>::gemmtile };
+		return result;
+	}
+};
+
+}
+}
+
+#endif
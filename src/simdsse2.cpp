@@ -0,0 +1,154 @@
+//Copyright 2017 Jakob Wyatt
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http ://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#include "simd.h"
+
+//this file is compiled with sse2 enabled
+//it must not use inline functions from other headers, as the linker could pick our sse2 copy for everyone
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+#include <cstddef>
+#include <cstdint>
+#include <emmintrin.h>
+
+#include "simdkernels.h"
+
+namespace math {
+namespace simd {
+
+namespace {
+
+struct sse2double {
+	typedef double scalar;
+	typedef __m128d reg;
+	static constexpr std::size_t width = 2;
+
+	static reg load(const scalar* ptr) { return _mm_loadu_pd(ptr); }
+	static void store(scalar* ptr, reg value) { _mm_storeu_pd(ptr, value); }
+	static reg widen(const float* ptr) { return _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(ptr)))); }
+	static void narrow(float* ptr, reg value) { _mm_storel_epi64(reinterpret_cast<__m128i*>(ptr), _mm_castps_si128(_mm_cvtpd_ps(value))); }
+	static reg set1(scalar value) { return _mm_set1_pd(value); }
+	static reg add(reg lhs, reg rhs) { return _mm_add_pd(lhs, rhs); }
+	static reg sub(reg lhs, reg rhs) { return _mm_sub_pd(lhs, rhs); }
+	static reg mul(reg lhs, reg rhs) { return _mm_mul_pd(lhs, rhs); }
+	static reg div(reg lhs, reg rhs) { return _mm_div_pd(lhs, rhs); }
+	static reg sqrt(reg value) { return _mm_sqrt_pd(value); }
+	static reg min(reg lhs, reg rhs) { return _mm_min_pd(lhs, rhs); }
+	static reg max(reg lhs, reg rhs) { return _mm_max_pd(lhs, rhs); }
+	static reg pow2(reg value) {
+		__m128i bits = _mm_slli_epi64(_mm_castpd_si128(value), 52);
+		return _mm_castsi128_pd(_mm_add_epi64(bits, _mm_set1_epi64x(0x3ff0000000000000ll)));
+	}
+	static scalar sum(reg value) { return _mm_cvtsd_f64(_mm_add_sd(value, _mm_unpackhi_pd(value, value))); }
+};
+
+struct sse2float {
+	typedef float scalar;
+	typedef __m128 reg;
+	static constexpr std::size_t width = 4;
+
+	static reg load(const scalar* ptr) { return _mm_loadu_ps(ptr); }
+	static void store(scalar* ptr, reg value) { _mm_storeu_ps(ptr, value); }
+	static reg widen(const float* ptr) { return _mm_loadu_ps(ptr); }
+	static void narrow(float* ptr, reg value) { _mm_storeu_ps(ptr, value); }
+	static reg set1(scalar value) { return _mm_set1_ps(value); }
+	static reg add(reg lhs, reg rhs) { return _mm_add_ps(lhs, rhs); }
+	static reg sub(reg lhs, reg rhs) { return _mm_sub_ps(lhs, rhs); }
+	static reg mul(reg lhs, reg rhs) { return _mm_mul_ps(lhs, rhs); }
+	static reg div(reg lhs, reg rhs) { return _mm_div_ps(lhs, rhs); }
+	static reg sqrt(reg value) { return _mm_sqrt_ps(value); }
+	static reg min(reg lhs, reg rhs) { return _mm_min_ps(lhs, rhs); }
+	static reg max(reg lhs, reg rhs) { return _mm_max_ps(lhs, rhs); }
+	static reg pow2(reg value) {
+		__m128i bits = _mm_slli_epi32(_mm_castps_si128(value), 23);
+		return _mm_castsi128_ps(_mm_add_epi32(bits, _mm_set1_epi32(0x3f800000)));
+	}
+	static scalar sum(reg value) {
+		__m128 half = _mm_add_ps(value, _mm_movehl_ps(value, value));
+		return _mm_cvtss_f32(_mm_add_ss(half, _mm_shuffle_ps(half, half, 1)));
+	}
+};
+
+struct sse2integer {
+	typedef __m128i reg;
+	static constexpr std::size_t width = 8;
+
+	//each byte is paired with itself and shifted down, which sign extends it without sse4.1
+	static reg load(const std::int8_t* ptr) {
+		__m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(ptr));
+		return _mm_srai_epi16(_mm_unpacklo_epi8(bytes, bytes), 8);
+	}
+	static reg zero() { return _mm_setzero_si128(); }
+	static reg madd(reg sum, reg lhs, reg rhs) { return _mm_add_epi32(sum, _mm_madd_epi16(lhs, rhs)); }
+	static std::int32_t sum(reg value) {
+		value = _mm_add_epi32(value, _mm_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2)));
+		value = _mm_add_epi32(value, _mm_shuffle_epi32(value, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_cvtsi128_si32(value);
+	}
+};
+
+//maps a scalar type to its vector type
+template<typename T>
+struct vector;
+
+template<>
+struct vector<float> {
+	typedef sse2float type;
+};
+
+template<>
+struct vector<double> {
+	typedef sse2double type;
+};
+
+}
+
+template<typename T>
+const kernels<T>& sse2kernels() {
+	static const kernels<T> result = elementwise<typename vector<T>::type>::table();
+	return result;
+}
+
+template const kernels<float>& sse2kernels();
+template const kernels<double>& sse2kernels();
+
+const integerkernels& sse2integerkernels() {
+	static const integerkernels result = integertiled<sse2integer>::table();
+	return result;
+}
+
+}
+}
+
+#else
+
+namespace math {
+namespace simd {
+
+template<typename T>
+const kernels<T>& sse2kernels() {
+	return scalarkernels<T>();
+}
+
+template const kernels<float>& sse2kernels();
+template const kernels<double>& sse2kernels();
+
+const integerkernels& sse2integerkernels() {
+	return scalarintegerkernels();
+}
+
+}
+}
+
+#endif
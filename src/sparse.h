@@ -0,0 +1,137 @@
+//Copyright 2017 Jakob Wyatt
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http ://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#ifndef GUARD_SPARSE_H
+#define GUARD_SPARSE_H
+
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include "matrixview.h"
+
+//sparse matricies only store their nonzero elements
+//they are used for inputs that are mostly zero, such as mnist images, so the layers can skip the zeros
+namespace math {
+
+//non-owning view of a sparse vector, held as its nonzero values and their positions
+//positions are in ascending order
+//a view is only valid while the memory it points to is
+template<typename T>
+class basic_sparsevector {
+public:
+	typedef T value_type;
+	typedef std::size_t size_type;
+
+	//initializes an empty vector
+	basic_sparsevector() : _values(nullptr), _indices(nullptr), _nonzeros(0), _size(0) {
+
+	}
+	//initializes a vector of size elements, with nonzeros elements stored at the given positions
+	basic_sparsevector(const T* values, const size_type* indices, size_type nonzeros, size_type size) : _values(values), _indices(indices), _nonzeros(nonzeros), _size(size) {
+
+	}
+
+	//returns the number of elements in the vector, including zeros
+	size_type size() const { return this->_size; }
+	//returns the number of stored elements
+	size_type nonzeros() const { return this->_nonzeros; }
+	//returns a pointer to the stored elements
+	const T* values() const { return this->_values; }
+	//returns a pointer to the positions of the stored elements
+	const size_type* indices() const { return this->_indices; }
+
+	//writes the vector into a dense view, counting along its rows
+	void expand(basic_matrixview<T> out) const {
+#ifdef _DEBUG
+		if (out.size() != this->_size) {
+			throw std::invalid_argument("buffer matrix has incompatible size");
+		}
+#endif
+		for (size_type i = 0; i != out.height(); ++i) {
+			T* row = out.data() + i * out.stride();
+			for (size_type j = 0; j != out.width(); ++j) {
+				row[j] = 0;
+			}
+		}
+		for (size_type i = 0; i != this->_nonzeros; ++i) {
+			size_type index = this->_indices[i];
+			out(index / out.width(), index % out.width()) = this->_values[i];
+		}
+	}
+
+private:
+	const T* _values;
+	const size_type* _indices;
+	size_type _nonzeros;
+	size_type _size;
+};
+
+//sparse matrix in compressed sparse row form
+//the nonzero elements are stored row by row, along with their columns, and where each row starts
+//this class uses zero-indexing unless otherwise stated
+template<typename T>
+class basic_sparsematrix {
+public:
+	typedef T value_type;
+	typedef std::size_t size_type;
+	typedef basic_sparsevector<T> sparsevector;
+
+	//initializes an empty matrix
+	basic_sparsematrix() : _values(), _columns(), _rowstarts(1, 0), _width(0) {
+
+	}
+	//initializes a sparse matrix holding the nonzero elements of a dense matrix
+	explicit basic_sparsematrix(basic_matrixview<const T> dense) : _values(), _columns(), _rowstarts(1, 0), _width(dense.width()) {
+		this->_rowstarts.reserve(dense.height() + 1);
+		for (size_type i = 0; i != dense.height(); ++i) {
+			const T* row = dense.data() + i * dense.stride();
+			for (size_type j = 0; j != dense.width(); ++j) {
+				if (row[j] != 0) {
+					this->_values.push_back(row[j]);
+					this->_columns.push_back(j);
+				}
+			}
+			this->_rowstarts.push_back(this->_values.size());
+		}
+	}
+
+	//returns a view of a single row, as a sparse vector of width elements
+	sparsevector row(size_type row) const {
+#ifdef _DEBUG
+		if (row >= this->height()) {
+			throw std::out_of_range("out of range");
+		}
+#endif
+		size_type start = this->_rowstarts[row];
+		return sparsevector(this->_values.data() + start, this->_columns.data() + start, this->_rowstarts[row + 1] - start, this->_width);
+	}
+
+	//returns the height of the matrix
+	size_type height() const { return this->_rowstarts.size() - 1; }
+	//returns the width of the matrix
+	size_type width() const { return this->_width; }
+	//returns the number of stored elements
+	size_type nonzeros() const { return this->_values.size(); }
+
+private:
+	std::vector<T> _values;
+	std::vector<size_type> _columns;
+	std::vector<size_type> _rowstarts;
+	size_type _width;
+};
+
+}
+
+#endif
@@ -0,0 +1,210 @@
+//Copyright 2017 Jakob Wyatt
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http ://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#include "threads.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+namespace math {
+
+namespace {
+
+//set while a thread is running part of a parallelfor, so nested calls run serially
+thread_local bool inparallel = false;
+
+//fixed set of worker threads that run the chunks of one job at a time
+//the thread that submits a job works on it too, so a pool of size n only starts n - 1 threads
+class threadpool {
+public:
+	threadpool(std::size_t size) : _task(nullptr), _chunks(0), _next(0), _active(0), _generation(0), _stop(false) {
+		for (std::size_t i = 1; i < size; ++i) {
+			_threads.push_back(std::thread(&threadpool::work, this));
+		}
+	}
+
+	~threadpool() {
+		{
+			std::lock_guard<std::mutex> guard(_lock);
+			_stop = true;
+		}
+		_start.notify_all();
+		for (std::thread& thread : _threads) {
+			thread.join();
+		}
+	}
+
+	std::size_t size() const {
+		return _threads.size() + 1;
+	}
+
+	//runs task(i) for every i in [0, chunks), and returns once they are all done
+	void run(std::size_t chunks, const std::function<void(std::size_t)>& task) {
+		{
+			std::unique_lock<std::mutex> guard(_lock);
+			//a worker that woke late for the previous job must leave before the counters are reset
+			_done.wait(guard, [this] { return _active == 0; });
+			_task = &task;
+			_chunks = chunks;
+			_next.store(0);
+			++_generation;
+		}
+		_start.notify_all();
+
+		runchunks(task, chunks);
+
+		std::unique_lock<std::mutex> guard(_lock);
+		_done.wait(guard, [this] { return _active == 0; });
+		_task = nullptr;
+	}
+
+private:
+	std::vector<std::thread> _threads;
+	std::mutex _lock;
+	std::condition_variable _start;
+	std::condition_variable _done;
+	const std::function<void(std::size_t)>* _task;
+	std::size_t _chunks;
+	std::atomic<std::size_t> _next;
+	std::size_t _active;
+	std::size_t _generation;
+	bool _stop;
+
+	//claims and runs chunks until none are left
+	void runchunks(const std::function<void(std::size_t)>& task, std::size_t chunks) {
+		for (std::size_t i = _next.fetch_add(1); i < chunks; i = _next.fetch_add(1)) {
+			task(i);
+		}
+	}
+
+	void work() {
+		inparallel = true;
+		std::size_t seen = 0;
+		std::unique_lock<std::mutex> guard(_lock);
+		while (true) {
+			_start.wait(guard, [this, seen] { return _stop || _generation != seen; });
+			if (_stop) {
+				return;
+			}
+			seen = _generation;
+			if (_task == nullptr) {
+				continue;
+			}
+			const std::function<void(std::size_t)>& task = *_task;
+			std::size_t chunks = _chunks;
+			++_active;
+			guard.unlock();
+
+			runchunks(task, chunks);
+
+			guard.lock();
+			if (--_active == 0) {
+				_done.notify_all();
+			}
+		}
+	}
+};
+
+//returns the thread count asked for by the environment, or one per hardware thread
+std::size_t initialthreads() {
+	const char* value = std::getenv("MATH_THREADS");
+	if (value != nullptr) {
+		long count = std::strtol(value, nullptr, 10);
+		if (count > 0) {
+			return static_cast<std::size_t>(count);
+		}
+	}
+	return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+//the pool and the lock that gives one caller at a time access to it
+//this is a function local static so kernels can safely be used during static initialization
+//it is never destroyed, as its threads cannot be joined safely during static destruction
+struct state {
+	std::mutex lock;
+	std::unique_ptr<threadpool> pool;
+
+	state() : pool(new threadpool(initialthreads())) {
+
+	}
+};
+
+state& shared() {
+	static state* value = new state;
+	return *value;
+}
+
+}
+
+void setthreads(std::size_t count) {
+	if (count == 0) {
+		count = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+
+	state& current = shared();
+	std::lock_guard<std::mutex> guard(current.lock);
+	if (current.pool->size() != count) {
+		current.pool.reset();
+		current.pool.reset(new threadpool(count));
+	}
+}
+
+std::size_t threads() {
+	state& current = shared();
+	std::lock_guard<std::mutex> guard(current.lock);
+	return current.pool->size();
+}
+
+void parallelfor(std::size_t count, std::size_t grain, const std::function<void(std::size_t begin, std::size_t end)>& func) {
+	if (count == 0) {
+		return;
+	}
+	grain = std::max(grain, static_cast<std::size_t>(1));
+	if (inparallel || count < 2 * grain) {
+		func(0, count);
+		return;
+	}
+
+	state& current = shared();
+	std::unique_lock<std::mutex> guard(current.lock, std::try_to_lock);
+	if (!guard.owns_lock() || current.pool->size() == 1) {
+		func(0, count);
+		return;
+	}
+
+	//one range per thread, rounded up to a whole number of grains
+	std::size_t chunks = std::min(current.pool->size(), count / grain);
+	std::size_t size = (count + chunks - 1) / chunks;
+	size = (size + grain - 1) / grain * grain;
+	chunks = (count + size - 1) / size;
+
+	inparallel = true;
+	auto task = [&](std::size_t i) {
+		std::size_t begin = i * size;
+		std::size_t end = std::min(count, begin + size);
+		func(begin, end);
+	};
+	current.pool->run(chunks, std::cref(task));
+	inparallel = false;
+}
+
+}
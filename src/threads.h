@@ -0,0 +1,46 @@
+//Copyright 2017 Jakob Wyatt
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http ://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#ifndef GUARD_THREADS_H
+#define GUARD_THREADS_H
+
+#include <cstddef>
+#include <functional>
+
+//large kernels split their work across a pool of worker threads
+//the pool starts with the number of threads given by the MATH_THREADS environment variable,
+//or one per hardware thread if it is not set
+namespace math {
+
+//sets the number of threads used by the kernels, including the calling thread
+//zero picks one per hardware thread, and one turns threading off
+void setthreads(std::size_t count);
+//returns the number of threads used by the kernels
+std::size_t threads();
+
+//calls func(begin, end) on disjoint ranges that together cover [0, count), possibly from several threads at once
+//every range except the last holds a multiple of grain elements, and no range is split smaller than grain
+//the calling thread takes part, and the call returns once every range is done
+//calls made from inside a range, or while another thread is using the pool, run serially on the calling thread
+//func must not throw
+void parallelfor(std::size_t count, std::size_t grain, const std::function<void(std::size_t begin, std::size_t end)>& func);
+//takes any callable, and wraps a reference to it, so a lambda with many captures is not copied to the heap on every call
+template<typename F>
+void parallelfor(std::size_t count, std::size_t grain, const F& func) {
+	parallelfor(count, grain, std::function<void(std::size_t begin, std::size_t end)>(std::cref(func)));
+}
+
+}
+
+#endif
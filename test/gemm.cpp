@@ -0,0 +1,211 @@
+//Copyright 2017 Jakob Wyatt
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http ://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+//checks the blocked matrix multiply against the naive reference multiply, bit for bit,
+//for every instruction set this cpu supports, both scalar types, all four transpose combinations, and with and without accumulate
+//the int8 multiply is checked the same way against exact integer sums
+//exits with a nonzero status if any product differs
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <random>
+#include <iostream>
+
+#include "../src/gemm.h"
+#include "../src/simd.h"
+#include "../src/random.h"
+
+namespace {
+
+//a product to check, in the dimensions of c and the inner dimension
+struct shape {
+	std::size_t m;
+	std::size_t n;
+	std::size_t k;
+};
+
+//rows of every operand are padded by this much, so the leading dimensions differ from the widths
+const std::size_t padding = 3;
+
+const char* isaname(math::simd::isa set) {
+	switch (set) {
+	case math::simd::sse2:
+		return "sse2";
+	case math::simd::avx2:
+		return "avx2";
+	case math::simd::avx512:
+		return "avx512";
+	default:
+		return "scalar";
+	}
+}
+
+//multiplies random operands with gemm and referencegemm, and returns true if the results are identical
+template<typename T>
+bool check(bool transa, bool transb, bool accumulate, shape size, math::philox& engine) {
+	std::normal_distribution<T> distribution;
+
+	//stored shapes of the operands, before op is applied
+	std::size_t aheight = transa ? size.k : size.m;
+	std::size_t awidth = transa ? size.m : size.k;
+	std::size_t bheight = transb ? size.n : size.k;
+	std::size_t bwidth = transb ? size.k : size.n;
+	std::size_t lda = awidth + padding;
+	std::size_t ldb = bwidth + padding;
+	std::size_t ldc = size.n + padding;
+
+	std::vector<T> a(aheight * lda);
+	std::vector<T> b(bheight * ldb);
+	for (T& element : a) {
+		element = distribution(engine);
+	}
+	for (T& element : b) {
+		element = distribution(engine);
+	}
+	//c starts out as garbage, so a kernel that accumulates instead of overwriting is caught
+	//when accumulating, c starts out random instead, so every element has its own starting value
+	std::vector<T> result(size.m * ldc, T(7));
+	if (accumulate) {
+		for (T& element : result) {
+			element = distribution(engine);
+		}
+	}
+	std::vector<T> reference(result);
+
+	math::gemm(transa, transb, size.m, size.n, size.k, a.data(), lda, b.data(), ldb, result.data(), ldc, accumulate);
+	math::referencegemm(transa, transb, size.m, size.n, size.k, a.data(), lda, b.data(), ldb, reference.data(), ldc, accumulate);
+
+	for (std::size_t i = 0; i != size.m; ++i) {
+		for (std::size_t j = 0; j != size.n; ++j) {
+			if (result[i * ldc + j] != reference[i * ldc + j]) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+//checks every shape in both transpose flags, with and without accumulate, and returns the number of failures
+template<typename T>
+std::size_t checkall(const std::vector<shape>& shapes, const char* type, math::philox& engine) {
+	std::size_t failures = 0;
+	for (const shape& size : shapes) {
+		for (int flags = 0; flags != 8; ++flags) {
+			bool transa = (flags & 1) != 0;
+			bool transb = (flags & 2) != 0;
+			bool accumulate = (flags & 4) != 0;
+			if (!check<T>(transa, transb, accumulate, size, engine)) {
+				std::cout << "FAIL " << isaname(math::simd::current()) << " " << type
+					<< " m=" << size.m << " n=" << size.n << " k=" << size.k
+					<< " transa=" << transa << " transb=" << transb << " accumulate=" << accumulate << std::endl;
+				++failures;
+			}
+		}
+	}
+	return failures;
+}
+
+//multiplies random int8 operands with gemm and a naive loop, and returns true if the results are identical
+bool checkinteger(bool transb, shape size, math::philox& engine) {
+	std::uniform_int_distribution<int> distribution(-127, 127);
+
+	std::size_t bheight = transb ? size.n : size.k;
+	std::size_t bwidth = transb ? size.k : size.n;
+	std::size_t lda = size.k + padding;
+	std::size_t ldb = bwidth + padding;
+	std::size_t ldc = size.n + padding;
+
+	std::vector<std::int8_t> a(size.m * lda);
+	std::vector<std::int8_t> b(bheight * ldb);
+	for (std::int8_t& element : a) {
+		element = static_cast<std::int8_t>(distribution(engine));
+	}
+	for (std::int8_t& element : b) {
+		element = static_cast<std::int8_t>(distribution(engine));
+	}
+	std::vector<std::int32_t> result(size.m * ldc, 7);
+
+	math::gemm(transb, size.m, size.n, size.k, a.data(), lda, b.data(), ldb, result.data(), ldc);
+
+	for (std::size_t i = 0; i != size.m; ++i) {
+		for (std::size_t j = 0; j != size.n; ++j) {
+			std::int32_t sum = 0;
+			for (std::size_t p = 0; p != size.k; ++p) {
+				sum += static_cast<std::int32_t>(a[i * lda + p]) * static_cast<std::int32_t>(transb ? b[j * ldb + p] : b[p * ldb + j]);
+			}
+			if (result[i * ldc + j] != sum) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+//checks every shape of the int8 multiply in both transpose flags, and returns the number of failures
+std::size_t checkintegers(const std::vector<shape>& shapes, math::philox& engine) {
+	std::size_t failures = 0;
+	for (const shape& size : shapes) {
+		for (int transb = 0; transb != 2; ++transb) {
+			if (!checkinteger(transb != 0, size, engine)) {
+				std::cout << "FAIL " << isaname(math::simd::current()) << " int8"
+					<< " m=" << size.m << " n=" << size.n << " k=" << size.k
+					<< " transb=" << transb << std::endl;
+				++failures;
+			}
+		}
+	}
+	return failures;
+}
+
+}
+
+int main() {
+	std::vector<shape> shapes;
+	//every combination of small sizes, around the 4 by 8 register tile and the small problem cutoff
+	std::vector<std::size_t> small = { 1, 2, 3, 4, 5, 7, 8, 9, 12, 15, 16, 17 };
+	for (std::size_t m : small) {
+		for (std::size_t n : small) {
+			for (std::size_t k : small) {
+				shapes.push_back({ m, n, k });
+			}
+		}
+	}
+	//sizes that are not multiples of the tile, and that cross the kc, mc and nc cache blocks
+	shapes.push_back({ 37, 29, 41 });
+	shapes.push_back({ 96, 1024, 256 });
+	shapes.push_back({ 97, 33, 257 });
+	shapes.push_back({ 193, 19, 70 });
+	shapes.push_back({ 13, 1025, 23 });
+	shapes.push_back({ 9, 1031, 520 });
+	shapes.push_back({ 101, 70, 513 });
+	//products big enough to be split across the thread pool, by rows and by columns
+	shapes.push_back({ 130, 66, 70 });
+	shapes.push_back({ 66, 130, 70 });
+
+	math::philox engine(2017);
+	std::size_t failures = 0;
+	std::size_t checked = 0;
+	for (int set = math::simd::scalar; set <= math::simd::detect(); ++set) {
+		math::simd::force(static_cast<math::simd::isa>(set));
+		failures += checkall<float>(shapes, "float", engine);
+		failures += checkall<double>(shapes, "double", engine);
+		failures += checkintegers(shapes, engine);
+		checked += 2 * 8 * shapes.size() + 2 * shapes.size();
+		std::cout << isaname(math::simd::current()) << " checked" << std::endl;
+	}
+
+	std::cout << checked - failures << " of " << checked << " products match the reference" << std::endl;
+	return failures == 0 ? 0 : 1;
+}